@@ -0,0 +1,165 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Memory resource interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Somewhere containers get memory from. Resources are passed around by
+    // pointer and have to outlive everything allocated from them; heap()
+    // is the global heap and serves wherever no resource is given.
+    //
+    class memory_resource {
+    public:
+        enum { MEMORY_Alignment = 16 };
+
+        virtual ~memory_resource() {}
+        virtual void* allocate(size_t bytes, size_t alignment = MEMORY_Alignment) = 0;
+        virtual void deallocate(void* pointer, size_t bytes, size_t alignment = MEMORY_Alignment) = 0;
+        static memory_resource* heap();
+    };
+
+    //
+    // Hands out memory by bumping a pointer through chunks taken from an
+    // upstream resource. Nothing is given back until the arena is released
+    // or destroyed, which returns every chunk at once. Not synchronized,
+    // an arena belongs to one writer.
+    //
+    class arena : public memory_resource {
+    public:
+        enum { ARENA_Chunk = 64 * 1024 };
+
+        arena(memory_resource* upstream = NULL, size_t chunk = ARENA_Chunk);
+        virtual ~arena();
+        void* allocate(size_t bytes, size_t alignment = MEMORY_Alignment);
+        void deallocate(void*, size_t, size_t = MEMORY_Alignment) {}
+        void release();
+        size_t used() const { return _used; }
+
+    private:
+        struct chunk {
+            chunk* next;
+            size_t size;
+        };
+
+        memory_resource* _upstream;
+        size_t _chunk;
+        chunk* _chunks;
+        char* _next;
+        char* _end;
+        size_t _used;
+    };
+
+    //
+    // Keeps freed memory on lists by power of two size class and refills
+    // them a slab at a time, so memory is reused without going back to the
+    // global heap. Larger requests go upstream directly. Everything taken
+    // upstream counts against an optional limit and is returned at once
+    // when the pool is destroyed. Safe to share between threads, which are
+    // spread over stripes of lists with a lock each so they rarely meet.
+    //
+    class pool : public memory_resource {
+    public:
+        enum { POOL_Smallest = 16, POOL_Classes = 9, POOL_Slab = 64 * 1024, POOL_Stripes = 8 };
+
+        pool(size_t limit = 0, memory_resource* upstream = NULL);
+        virtual ~pool();
+        void* allocate(size_t bytes, size_t alignment = MEMORY_Alignment);
+        void deallocate(void* pointer, size_t bytes, size_t alignment = MEMORY_Alignment);
+        size_t used();
+
+    private:
+        struct node {
+            node* next;
+        };
+
+        struct stripe {
+            node* free[POOL_Classes];
+            std::vector<void*> slabs;
+            lock guard;
+            char padding[64];   // Keeps stripes off each other's cache lines
+        };
+
+        struct large {
+            large* previous;
+            large* next;
+            size_t bytes;
+            size_t padding;   // Keeps what follows aligned
+        };
+
+        static int _class(size_t bytes);
+        void _reserve(size_t bytes);
+        stripe& _stripe();
+
+        memory_resource* _upstream;
+        size_t _limit;
+        std::atomic<size_t> _used;
+        stripe _stripes[POOL_Stripes];
+        large* _large;
+        lock _lock;
+    };
+
+    //
+    // Standard allocator drawing from a memory resource. Copies of a
+    // container go back to the heap, so they never outlive the resource
+    // their original came from.
+    //
+    template <class T>
+    class allocator {
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+        template <class U> struct rebind { typedef allocator<U> other; };
+
+        allocator(memory_resource* resource = NULL)
+            : _resource(resource ? resource : memory_resource::heap()) {}
+        template <class U> allocator(const allocator<U>& other)
+            : _resource(other.resource()) {}
+
+        T* allocate(size_t count, const void* = NULL) {
+            return static_cast<T*>(_resource->allocate(count * sizeof(T), __alignof(T)));
+        }
+        void deallocate(T* pointer, size_t count) {
+            _resource->deallocate(pointer, count * sizeof(T), __alignof(T));
+        }
+        allocator select_on_container_copy_construction() const { return allocator(); }
+
+        T* address(T& value) const { return &value; }
+        const T* address(const T& value) const { return &value; }
+        size_t max_size() const { return static_cast<size_t>(-1) / sizeof(T); }
+        memory_resource* resource() const { return _resource; }
+
+    private:
+        memory_resource* _resource;
+    };
+
+    template <class T, class U>
+    bool operator==(const allocator<T>& left, const allocator<U>& right) { return left.resource() == right.resource(); }
+    template <class T, class U>
+    bool operator!=(const allocator<T>& left, const allocator<U>& right) { return left.resource() != right.resource(); }
+}
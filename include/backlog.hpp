@@ -0,0 +1,54 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output backlog detection interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Decides when output arrives faster than it can be drawn. The console
+    // falls behind once the queue has stayed deep for a while and draining
+    // it at the measured cost of drawing a message would take too long;
+    // while behind, messages are only stored and the screen just shows the
+    // newest lines. It catches up once the queue is shallow again and the
+    // messages arriving would keep drawing busy for under half the time.
+    //
+    class backlog {
+    public:
+        backlog();
+        void capacity(size_t mailboxes);
+        bool handled(size_t waiting, timestamp::tick now);
+        bool check(size_t waiting, timestamp::tick now);
+        void rendered(timestamp::tick elapsed);
+        bool behind() const { return _behind; }
+
+    private:
+        bool _evaluate(size_t waiting, timestamp::tick now);
+
+        size_t _high, _low;          // Queue depths counting as deep and shallow
+        double _cost;                // Average ticks spent drawing a message
+        size_t _strikes;             // Messages in a row handled with a deep queue
+        size_t _arrived;             // Messages handled since the window started
+        timestamp::tick _window;     // When the current window started
+        bool _behind;
+    };
+}
@@ -0,0 +1,99 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input fan-out interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    class broadcast;
+
+    //
+    // A reader of a broadcast, cheap to copy. Copies share the same cursor,
+    // so threads reading through copies take turns at the lines. Once
+    // cancelled, every copy finds the subscription closed, even after its
+    // slot went to a new subscriber.
+    //
+    class subscription {
+    public:
+        subscription() : _owner(NULL), _slot(0), _generation(0) {}
+        result read(std::wstring& buffer, unsigned long timeout);
+        void cancel();
+        bool valid() const { return _owner != NULL; }
+
+    private:
+        friend class broadcast;
+        subscription(broadcast* owner, size_t slot, unsigned generation)
+            : _owner(owner), _slot(slot), _generation(generation) {}
+
+        broadcast* _owner;
+        size_t _slot;
+        unsigned _generation;
+    };
+
+    //
+    // Input handed to every subscriber. Frames are kept once in a ring and
+    // each subscriber has a cursor into it, taking only the lines that start
+    // with its prefix and came by one of its routes. A frame stays until
+    // every subscriber has moved past it, so the slowest subscriber holds
+    // up publishing rather than missing input. Publishers never take a
+    // subscriber's lock, they only look at the cursors.
+    //
+    class broadcast {
+    public:
+        enum route { ROUTE_Typed = 1, ROUTE_Injected = 2, ROUTE_All = 0xFFFFFFFF };
+        enum { SUBSCRIBER_Count = 32 };
+
+        broadcast(int frames, memory_resource* memory = NULL); virtual ~broadcast();
+        subscription subscribe(const std::wstring& prefix = std::wstring(), unsigned routes = ROUTE_All);
+        result publish(const std::wstring& text, unsigned route, unsigned long timeout);
+        void close();
+
+    private:
+        friend class subscription;
+        typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, allocator<wchar_t> > frame;
+        typedef unsigned long long sequence;
+
+        struct reader {
+            std::atomic<sequence> cursor;   // Next frame to look at
+            std::atomic<bool> active;
+            unsigned generation;            // Subscriptions the slot has had
+            std::wstring prefix;
+            unsigned routes;
+            HANDLE event;                   // Set whenever a frame is published, cleared before waiting
+            lock guard;                     // Taken by readers sharing the cursor and to change the slot
+        };
+
+        result _read(size_t slot, unsigned generation, std::wstring& buffer, unsigned long timeout);
+        void _cancel(size_t slot, unsigned generation);
+        bool _take(reader& self, std::wstring& buffer);
+        sequence _oldest();
+
+        std::vector<frame> _frames;
+        std::vector<unsigned> _routes;
+        std::atomic<sequence> _published;
+        std::atomic<int> _waiting;          // Publishers waiting for room
+        std::atomic<bool> _closed;
+        reader _readers[SUBSCRIBER_Count];
+        HANDLE _event_space;
+        lock _lock;                         // Serializes publishers and subscribing
+    };
+}
@@ -0,0 +1,48 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input chunking interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Cuts an input too large for one message into frames of at most a
+    // chunk. Frames end on a line break unless a single line fills the
+    // chunk, so readers never see a line split between frames. The text is
+    // fetched a range at a time, so it is never held in one piece.
+    //
+    class chunker {
+    public:
+        typedef std::function<void(size_t from, size_t to, std::wstring& text)> source;
+
+        chunker(size_t chunk);
+        void start(size_t length);
+        void next(const source& fetch, std::wstring& frame);
+        bool done() const { return _position >= _length; }
+        size_t chunk() const { return _chunk; }
+
+    private:
+        size_t _chunk;
+        size_t _position;
+        size_t _length;
+    };
+}
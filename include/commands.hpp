@@ -0,0 +1,65 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Command registry interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Named command handlers run on an executor. Invocations beyond a
+    // command's concurrency limit wait in a per-command queue and are
+    // submitted as earlier invocations of the same command finish.
+    //
+    class commands {
+    public:
+        typedef std::vector<std::wstring> arguments;
+        typedef std::function<std::wstring(const arguments&)> handler;
+        typedef std::function<void(const std::wstring&)> output;
+
+        commands(); virtual ~commands();
+        void add(const std::wstring& name, const handler& function, int concurrency);
+        bool dispatch(const std::wstring& line, const output& reply);
+        bool exists(const std::wstring& name);
+        bool empty();
+        void stop();
+        static void tokenize(const std::wstring& line, arguments& tokens);
+
+    private:
+        struct invocation {
+            arguments args;
+            output reply;
+        };
+
+        struct command {
+            handler function;
+            int limit;
+            int running;
+            std::deque<invocation> waiting;
+        };
+
+        void _run(command* target, const invocation& call);
+
+        std::map<std::wstring, command*> _commands;
+        executor* _executor;
+        lock _lock;
+    };
+}
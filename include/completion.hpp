@@ -0,0 +1,80 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Completion interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Word completion from a static radix index plus pluggable providers.
+    // Providers run on a worker thread; every new request or cancellation
+    // bumps a generation counter which makes older requests stale, so a
+    // provider only has to poll query::cancelled() to give up early.
+    //
+    class completion {
+    public:
+        struct query {
+            std::wstring prefix;
+            LONG id;
+            const std::atomic<LONG>* generation;
+            bool cancelled() const { return generation->load(std::memory_order_acquire) != id; }
+        };
+
+        class provider {
+        public:
+            virtual ~provider() {}
+            virtual void complete(const query& request, std::vector<std::wstring>& candidates) = 0;
+        };
+
+        completion(); virtual ~completion();
+        void add(const std::wstring& word);
+        void remove(const std::wstring& word);
+        void attach(provider* source);
+        void lookup(const std::wstring& prefix, std::vector<std::wstring>& candidates);
+        LONG request(const std::wstring& prefix, HWND notify, UINT message);
+        bool results(LONG id, std::vector<std::wstring>& candidates);
+        void cancel();
+
+    private:
+        static DWORD CALLBACK _callback_threadproc(void* self);
+        void _thread_run();
+
+        radix _words;
+        std::vector<provider*> _providers;
+        std::atomic<LONG> _generation;
+
+        // Request handed to the worker
+        query _pending;
+        bool _pending_valid;
+        HWND _pending_notify;
+        UINT _pending_message;
+
+        // Results handed back
+        std::vector<std::wstring> _results;
+        LONG _results_id;
+
+        HANDLE _thread;
+        HANDLE _event_request;
+        bool _quit;
+        lock _lock;
+    };
+}
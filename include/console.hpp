@@ -22,13 +22,8 @@
 
 #pragma once
 
-// STL
-#include <vector>
-#include <string>
-#include <exception>
-
-// Windows
-#include <Windows.h>
+// Core
+#include "core.hpp"
 
 #ifdef CONSOLE_DYNAMIC
 #ifdef CONSOLE_EXPORTS
@@ -40,10 +35,9 @@
 #define CONSOLE_API
 #endif
 
-// Project
-#include "lock.hpp"
-#include "exceptions.hpp"
-#include "mail.hpp"
+// Windows
+#include "reactor.hpp"
+#include "streamer.hpp"
 
 namespace db
 {
@@ -57,13 +51,17 @@ namespace db
         };
 
        /**
-        * Construct a new console
+        * Construct a new console. The window is created in the background,
+        * calls made before it exists are buffered and applied afterwards
         *
         * @param title the window title for the console
         * @param background the rgb colour to use for the background
         * @param buffers the number of buffers to reserve for storing i/o
+        * @param shared the reactor to run on instead of a thread of its own
+        * @param memory where messages and scrollback text are kept, which must
+        *        outlive the console. By default the console has a pool of its own
         */
-        console(int buffers);
+        console(int buffers, reactor* shared = NULL, memory_resource* memory = NULL);
         
        /**
         * Destroys internal resources used by the console
@@ -111,6 +109,149 @@ namespace db
         */
         console& resize(int width, int height);
 
+       /**
+        * Persists input history to a file, loading any previous entries
+        *
+        * @param path the file used to store the input history
+        */
+        console& history(const wchar_t* path);
+
+       /**
+        * Adds a word offered when completing input with tab
+        *
+        * @param word the word to offer
+        */
+        console& completion(const std::wstring& word);
+
+       /**
+        * Adds a provider queried off the UI thread when completing input
+        *
+        * @param source the provider to query, which must outlive the console
+        */
+        console& completion(db::completion::provider* source);
+
+       /**
+        * Registers a command run on the console's thread pool. Input lines
+        * starting with the command name go to the handler instead of read
+        *
+        * @param name the name that invokes the command
+        * @param function the handler, its result is written to the console
+        * @param concurrency how many invocations may run at once, 0 for no limit
+        */
+        console& command(const std::wstring& name, const commands::handler& function, int concurrency = 0);
+
+       /**
+        * Highlights the input as it is typed. By default command names,
+        * options, numbers and strings are highlighted, and names of commands
+        * that were never added stand out
+        *
+        * @param rules the tokenizer to use, which must outlive the console, or NULL for plain input
+        */
+        console& syntax(db::tokenizer* rules);
+
+       /**
+        * Looks up the identifier of an output category, creating it if needed.
+        * Only 64 categories exist, later names all share the last one
+        *
+        * @param name the name of the category
+        * @return the identifier to pass to write
+        */
+        int category(const std::wstring& name);
+
+       /**
+        * Shows only output matching a filter, rebuilding what is on screen
+        * from the scrollback
+        *
+        * @param which the levels and categories to show
+        */
+        console& filter(const db::scrollback::filter& which);
+
+       /**
+        * Collapses messages repeating within a window of recent messages into
+        * the first one, followed by a live repeat counter
+        *
+        * @param window how many distinct recent messages to compare against, 0 to disable
+        */
+        console& dedupe(size_t window);
+
+       /**
+        * Shows the time each message was written in front of it. Messages are
+        * always stamped, this only controls whether the stamps are shown
+        *
+        * @param visible whether or not timestamps are shown
+        */
+        console& timestamps(bool visible = true);
+
+       /**
+        * Returns how long messages took from being written to being shown
+        */
+        db::latency::summary latency();
+
+       /**
+        * Sets how long the window may take over a single message before it
+        * counts as stalled
+        *
+        * @param threshold the longest acceptable time, in seconds
+        */
+        console& stalls(double threshold);
+
+       /**
+        * Returns how often the window stalled and the slowest messages it
+        * handled, including one still being handled
+        */
+        db::watchdog::summary stalls();
+
+       /**
+        * Colours plain text output matching a pattern. All rules are applied
+        * together in a single pass over each message
+        *
+        * @param pattern the text to look for
+        * @param colour the colour to give matching text
+        * @param extent whether to colour the match, its token or its whole line
+        * @param bold whether matching text is also made bold
+        */
+        console& highlight(const std::wstring& pattern, rgb colour, highlighter::scope extent = highlighter::SCOPE_Match, bool bold = false);
+
+       /**
+        * Writes everything in the scrollback to a file, formatting it on all
+        * cores. Output written meanwhile carries on and is not included. Lines
+        * are stamped when the console shows timestamps
+        *
+        * @param path the file to create
+        * @param kind whether to write plain text, HTML or RTF
+        */
+        console& export_to(const wchar_t* path, exporter::format kind);
+
+       /**
+        * Serves output to local viewers connecting to a Unix domain socket.
+        * Viewers get the recent scrollback followed by everything written
+        *
+        * @param path where to create the socket
+        */
+        console& serve(const wchar_t* path);
+
+       /**
+        * Records writes, control calls and input to a file for replay.
+        * Recording a new file ends the previous recording
+        *
+        * @param path the file to record to, NULL to stop recording
+        */
+        console& record(const wchar_t* path);
+
+       /**
+        * Returns everything written to the console, for building further views
+        */
+        db::scrollback& scrollback();
+
+       /**
+        * Opens a status line shown below the output. Updating it replaces its
+        * text in place, at most once per frame however often it is updated,
+        * and nothing is added to the scrollback
+        *
+        * @return the status line, valid until it is closed or the console is destroyed
+        */
+        db::status_line status_line();
+
        /**
         * Returns the whether or not the console is visible
         */
@@ -126,7 +267,20 @@ namespace db
         bool write(const std::wstring& richtext, unsigned long timeout);
 
        /**
-        * Read text sent from the console
+        * Write tagged rich text to the console
+        *
+        * @param richtext the rich text to write to the console
+        * @param timeout how long to wait, in milliseconds, for a successful write
+        * @param level the severity of the text
+        * @param category the category identifier returned by category
+        * @return whether or not the write succeeded
+        */
+        bool write(const std::wstring& richtext, unsigned long timeout, db::scrollback::level level, int category = 0);
+
+       /**
+        * Read text sent from the console. Large inputs arrive over several
+        * reads, each holding whole lines unless a single line is too long.
+        * Reading starts with the input sent after the first read
         *
         * @param buffer a buffer to hold the text
         * @param timeout how long to wait, in milliseconds, for a successful read
@@ -134,17 +288,99 @@ namespace db
         */
         bool read(std::wstring& buffer, unsigned long timeout);
 
+       /**
+        * Hands text to commands and readers as if it had been typed in
+        *
+        * @param text the text to send
+        * @param timeout how long to wait, in milliseconds, for readers to take it
+        * @return whether or not the text was taken
+        */
+        bool input(const std::wstring& text, unsigned long timeout);
+
+       /**
+        * Write tagged rich text to the console without throwing
+        *
+        * @param richtext the rich text to write to the console
+        * @param timeout how long to wait, in milliseconds, for a successful write
+        * @param level the severity of the text
+        * @param category the category identifier returned by category
+        * @return whether the write succeeded, timed out, found the console full or closed, or failed
+        */
+        result try_write(const std::wstring& richtext, unsigned long timeout,
+                         db::scrollback::level level = db::scrollback::LEVEL_Info, int category = 0);
+
+       /**
+        * Read text sent from the console without throwing
+        *
+        * @param buffer a buffer to hold the text
+        * @param timeout how long to wait, in milliseconds, for a successful read
+        * @return whether the read succeeded, timed out, found the console closed, or failed
+        */
+        result try_read(std::wstring& buffer, unsigned long timeout);
+
+       /**
+        * Hands text to commands and readers as if it had been typed in, without throwing
+        *
+        * @param text the text to send
+        * @param timeout how long to wait, in milliseconds, for readers to take it
+        * @return whether the text was taken, timed out, found readers full or closed, or failed
+        */
+        result try_input(const std::wstring& text, unsigned long timeout);
+
+       /**
+        * Subscribes to input. Every subscriber gets each line it asks for,
+        * however many others read, and has to keep reading for input to flow
+        *
+        * @param prefix only lines starting with this are taken, empty for all
+        * @param routes which of typed and injected input is taken
+        * @return the subscription to read from, valid until the console is destroyed
+        */
+        db::subscription subscribe(const std::wstring& prefix = std::wstring(), unsigned routes = broadcast::ROUTE_All);
+
     private:
+        friend class reactor;
+        friend class db::status_line;
 
         //
         // Internal thread context
         //
         bool _thread_initialize();
         bool _thread_messagepump();
-        void _thread_handler_mail(mail::string& mail);
+        bool _thread_drain(int quantum);
+        void _thread_handler_mail(mail::string& mail, const mail::header& info);
+        void _thread_append(const mail::string& mail);
+        LONG _thread_place(const mail::string& mail, LONG at);
+        LONG _thread_marker();
+        void _thread_repeat(db::dedupe::entry& tracked);
+        void _thread_stamp(mail::string& text, timestamp::tick stamp);
+        void _thread_highlight(const mail::string& text, LONG start, const std::vector<highlighter::run>& runs);
+        void _thread_refilter();
+        void _thread_rebuild(const db::scrollback::snapshot& contents, const std::vector<size_t>& lines);
+        LONG _thread_insert(const db::scrollback::snapshot& contents, const std::vector<size_t>& lines, LONG at);
+        void _thread_follow(bool behind);
+        void _thread_catchup();
+        size_t _thread_tail();
         LRESULT _thread_handler_message(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
         LRESULT _thread_handler_input(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+        void _thread_stream_pump();
+        void _thread_stream_fetch(mail::string& chunk);
+        LRESULT _thread_history_recall(bool older);
+        LRESULT _thread_history_search();
+        void _thread_history_reset();
+        LRESULT _thread_complete();
+        void _thread_complete_results(LONG id);
+        void _thread_complete_apply(std::vector<std::wstring>& candidates);
+        void _thread_input_get(std::wstring& text);
+        void _thread_input_set(const std::wstring& text);
+        void _thread_syntax(db::tokenizer* rules);
+        void _thread_lex();
+        void _thread_lex_apply(size_t from, size_t to);
         void _thread_resize(DWORD width, DWORD height);
+        void _thread_measure();
+        void _thread_reflow();
+        size_t _thread_rows();
+        void _thread_wrap(bool fixed);
+        void _thread_status(bool timer);
         bool _thread_finalize();
 
         //
@@ -169,19 +405,161 @@ namespace db
         HWND _hwnd_console;
         HWND _hwnd_console_input;
         HWND _hwnd_console_output;
+        HWND _hwnd_console_status;
+
+        //
+        // Memory
+        //
+        pool _pool;
+        memory_resource* _memory;
 
         //
         // Message passing
         //
-        mail _mail_input;
+        broadcast _input_log;
+        subscription _input_reader;
+        std::atomic<bool> _input_subscribed;
+        lock _input_lock;
+        result _output(const std::wstring& richtext, unsigned long timeout, db::scrollback::level level, int category);
         mail _mail_output;
 
+        //
+        // Shared reactor
+        //
+        reactor* _reactor;
+        size_t _reactor_slot;
+
+        //
+        // Settings made before the window exists
+        //
+        struct settings {
+            settings() : visible(false), icon(NULL), background(0), width(0), height(0), dedupe(0), timestamps(false), syntax(NULL),
+                         has_title(false), has_icon(false), has_background(false), has_size(false), has_dedupe(false), has_syntax(false) {}
+            bool visible;
+            std::wstring title;
+            HICON icon;
+            COLORREF background;
+            int width, height;
+            size_t dedupe;
+            bool timestamps;
+            db::tokenizer* syntax;
+            bool has_title, has_icon, has_background, has_size, has_dedupe, has_syntax;
+        };
+        bool _pending_acquire();
+        void _pending_release();
+        settings _pending;
+        lock _pending_lock;
+        std::atomic<bool> _ready;
+
+        //
+        // Input hand over
+        //
+        chunker _stream_chunker;
+        mail::string _stream_pending;
+        bool _stream_queued;
+        bool _stream_active;
+
+        //
+        // Input history
+        //
+        db::history _history;
+        std::wstring _history_draft;
+        bool _history_active;
+
+        //
+        // Input completion
+        //
+        db::completion _completion;
+
+        //
+        // Command dispatch
+        //
+        commands _commands;
+
+        //
+        // Input highlighting
+        //
+        db::command_tokenizer _lex_commands;
+        db::lexer _lexer;
+        std::wstring _lex_text;
+        bool _lex_posted;
+
+        //
+        // Output filtering
+        //
+        db::scrollback _scrollback;
+        db::scrollback::filter _filter;
+        db::scrollback::filter _filter_next;
+
+        //
+        // Layout
+        //
+        db::layout _layout;
+        LONG _cell_width, _cell_height;
+        bool _sizing;
+        HDC _wrap_fixed;
+
+        //
+        // Status lines
+        //
+        void _status_update(size_t slot, unsigned generation, const std::wstring& text);
+        void _status_close(size_t slot, unsigned generation);
+        void _status_post(bool schedule);
+        status_board _status;
+        size_t _status_lines;
+        DWORD _status_drawn;
+        bool _status_waiting;
+
+        //
+        // Output highlighting
+        //
+        highlighter _highlighter;
+
+        //
+        // Repeated output
+        //
+        db::dedupe _dedupe;
+
+        //
+        // Timestamps
+        //
+        bool _timestamps;
+        db::latency _latency;
+
+        //
+        // Overload
+        //
+        db::backlog _backlog;
+        size_t _catchup;    // Lines before this are still to be shown after catching up
+
+        //
+        // Stall detection
+        //
+        db::watchdog _watchdog;
+
+        //
+        // Export
+        //
+        exporter _exporter;
+
+        //
+        // Streaming
+        //
+        streamer _streamer;
+
+        //
+        // Recording
+        //
+        recorder _recorder;
+
         //
         // Reference counting
         //
         static void _ref_acquire();
+        static void _ref_initialize();
         static void _ref_release();
         static lock _ref_lock;
         static int _ref_count;
+        static std::atomic<bool> _ref_initialized;
     };
 }
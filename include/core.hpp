@@ -0,0 +1,71 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Portable core interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+// STL
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <functional>
+#include <set>
+#include <algorithm>
+#include <iterator>
+#include <exception>
+#include <regex>
+#include <memory>
+#include <atomic>
+#include <cstring>
+#include <cwctype>
+
+// Platform
+#include "platform.hpp"
+
+// Project
+#include "lock.hpp"
+#include "exceptions.hpp"
+#include "result.hpp"
+#include "arena.hpp"
+#include "mail.hpp"
+#include "broadcast.hpp"
+#include "chunker.hpp"
+#include "radix.hpp"
+#include "history.hpp"
+#include "completion.hpp"
+#include "executor.hpp"
+#include "commands.hpp"
+#include "scheduler.hpp"
+#include "scrollback.hpp"
+#include "styles.hpp"
+#include "highlight.hpp"
+#include "tokenizer.hpp"
+#include "markup.hpp"
+#include "timestamp.hpp"
+#include "watchdog.hpp"
+#include "backlog.hpp"
+#include "dedupe.hpp"
+#include "exporter.hpp"
+#include "recorder.hpp"
+#include "layout.hpp"
+#include "status.hpp"
@@ -0,0 +1,62 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Repeated output suppression interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Recognizes messages repeating within a window of the most recent
+    // distinct messages. Messages are hashed once and looked up in a hash
+    // table over a ring of entries, so every message costs constant time.
+    // Entries carry where the message lives so its repeat counter can be
+    // updated in place.
+    //
+    class dedupe {
+    public:
+        struct entry {
+            unsigned long long hash;
+            std::wstring text;
+            int level;
+            int category;
+            size_t count;   // Times seen, including the first
+            size_t line;    // Scrollback line holding the message
+            LONG marker;    // Where the counter starts in the output, -1 when not shown
+            LONG length;    // Length of the counter shown
+        };
+
+        dedupe(); virtual ~dedupe();
+        void window(size_t size);
+        entry* track(const std::wstring& text, int level, int category, bool& repeated);
+        void shift(LONG after, LONG delta);
+        void clear();
+        bool enabled() const { return !_entries.empty(); }
+        static std::wstring label(size_t count);
+
+    private:
+        static unsigned long long _hash(const std::wstring& text, int level, int category);
+
+        std::vector<entry> _entries;
+        std::unordered_map<unsigned long long, size_t> _slots;
+        size_t _next;
+    };
+}
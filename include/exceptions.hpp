@@ -27,9 +27,19 @@ namespace db
     class win_exception : public std::exception {
     public:
         win_exception(DWORD error_code)
-            : _error_code(error_code)
-        {
-            // Format the error message
+            : _error_code(error_code) {}
+
+        virtual const char* what() const throw() {
+            // Only format the error message once someone asks for it
+            if (_error_string.empty()) _error_string = format(_error_code);
+            return _error_string.c_str();
+        }
+
+        DWORD code() const {
+            return _error_code;
+        }
+
+        static std::string format(DWORD error_code) {
             char* buffer = NULL;
             FormatMessageA(
                 FORMAT_MESSAGE_ALLOCATE_BUFFER |
@@ -44,11 +54,12 @@ namespace db
                 );
 
             // Check result and store in string
-            if (buffer) _error_string.assign(buffer);
-        }
-
-        virtual const char* what() const {
-            return _error_string.c_str();
+            std::string text;
+            if (buffer) {
+                text.assign(buffer);
+                LocalFree(buffer);
+            }
+            return text;
         }
 
         static void check_last_error() {
@@ -63,6 +74,6 @@ namespace db
 
     private:
         DWORD _error_code;
-        std::string _error_string;
+        mutable std::string _error_string;
     };
 }
@@ -0,0 +1,60 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Executor interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Work-stealing thread pool. Each worker owns a deque: work submitted from
+    // a worker goes to the back of its own deque and is taken back LIFO, work
+    // submitted from outside is spread round robin, and idle workers steal
+    // from the front of the others. A single semaphore counts queued tasks.
+    //
+    class executor {
+    public:
+        typedef std::function<void()> task;
+
+        executor(int threads = 0); virtual ~executor();
+        void submit(const task& work);
+        int threads() const { return static_cast<int>(_workers.size()); }
+
+    private:
+        struct worker {
+            executor* owner;
+            size_t index;
+            std::deque<task> queue;
+            lock guard;
+            HANDLE thread;
+        };
+
+        static DWORD CALLBACK _callback_threadproc(void* self);
+        void _thread_run(worker& self);
+        bool _take(size_t index, task& work);
+
+        std::vector<worker*> _workers;
+        HANDLE _sem_work;
+        DWORD _tls_worker;
+        volatile LONG _next;
+        volatile LONG _quit;
+    };
+}
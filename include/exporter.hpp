@@ -0,0 +1,61 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Scrollback export interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Writes a scrollback snapshot to a file as plain text, HTML or RTF.
+    // The snapshot is cut into ranges of lines formatted in parallel on an
+    // executor; the calling thread writes finished ranges in order through
+    // a large buffer, keeping a bounded number of ranges in flight. Since a
+    // snapshot is exported, writers are never held up. Lines carry their
+    // stamp only when the console shows timestamps.
+    //
+    class exporter {
+    public:
+        enum format { FORMAT_Plain, FORMAT_Html, FORMAT_Rtf };
+
+        exporter(); virtual ~exporter();
+        void write(const scrollback::snapshot& contents, const wchar_t* path, format kind, bool stamps);
+        static void render(const scrollback::line& entry, format kind, bool stamps, std::string& out);
+        static void text(const std::wstring& rtf, std::wstring& out);
+        static void utf8(const std::wstring& text, std::string& out);
+
+    private:
+        struct range {
+            size_t from, to;
+            std::string data;
+            bool failed;
+            HANDLE done;
+        };
+
+        static void _header(format kind, std::string& out);
+        static void _footer(format kind, std::string& out);
+        static DWORD _flush(HANDLE file, std::string& buffer);
+        executor& _pool();
+
+        executor* _executor;
+        lock _lock;
+    };
+}
@@ -0,0 +1,69 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output highlighting interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Keyword highlighting for plain text output. All rules are compiled
+    // together into one Aho-Corasick automaton with a full transition table
+    // over character classes, so a message is styled in a single pass no
+    // matter how many rules exist. A match can colour just itself, the
+    // whitespace delimited token around it or its whole line. Runs refer to
+    // interned styles, and adjacent runs of the same style are merged.
+    //
+    class highlighter {
+    public:
+        enum scope { SCOPE_Match, SCOPE_Token, SCOPE_Line };
+
+        typedef db::style style;
+
+        struct run {
+            size_t start;
+            size_t length;
+            style_table::id format;
+        };
+
+        highlighter();
+        void add(const std::wstring& pattern, const style& format, scope extent = SCOPE_Match);
+        void apply(const std::wstring& text, std::vector<run>& runs);
+        bool empty();
+
+    private:
+        struct rule {
+            std::wstring pattern;
+            style_table::id format;
+            scope extent;
+        };
+
+        void _compile();
+
+        std::vector<rule> _rules;
+        std::vector<unsigned short> _classes;
+        std::vector<int> _transitions;
+        std::vector<int> _outputs;
+        int _width;
+        bool _compiled;
+        lock _lock;
+    };
+}
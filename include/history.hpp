@@ -0,0 +1,83 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input history interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Input history with prefix recall through a radix index and substring
+    // recall through a trigram index: every trigram maps to the ranks of the
+    // entries holding it, and a search only looks at the entries listed for
+    // the rarest trigram of the text. Ranks of entries that moved or went
+    // away stay listed until they outnumber the live ones, then the index is
+    // rebuilt. Text too short for a trigram is matched against per-entry
+    // character signatures. Entries are unique, a repeated line moves to the
+    // front. When a file is attached every entry is appended to it as a
+    // length prefixed record and the file is rewritten once it accumulates
+    // too many stale records.
+    //
+    class history {
+    public:
+        history(size_t capacity); virtual ~history();
+        void open(const wchar_t* path);
+        void add(const std::wstring& line);
+        bool previous(const std::wstring& prefix, std::wstring& line);
+        bool next(const std::wstring& prefix, std::wstring& line);
+        bool search(const std::wstring& text, std::wstring& line);
+        void reset();
+        size_t size();
+
+    private:
+        typedef unsigned long long signature;
+        typedef unsigned long long trigram;
+
+        struct entry {
+            std::wstring line;
+            signature mask;
+            size_t trigrams;   // Distinct trigrams listed for the entry
+        };
+
+        static signature _signature(const std::wstring& text);
+        static void _trigrams(const std::wstring& text, std::vector<trigram>& grams);
+        void _insert(const std::wstring& line);
+        void _post(radix::rank rank, entry& fresh);
+        void _repost();
+        void _persist(const std::wstring& line);
+        void _compact();
+        void _close();
+
+        radix _index;
+        std::map<radix::rank, entry> _entries;
+        std::unordered_map<trigram, std::vector<radix::rank> > _postings;   // Oldest rank first
+        size_t _posted;    // Ranks listed, stale ones included
+        size_t _live;      // Ranks listed for entries still around
+        std::vector<radix::rank> _trail;
+        radix::rank _rank;
+        radix::rank _cursor;
+        size_t _capacity;
+        size_t _records;
+        std::wstring _path;
+        HANDLE _file;
+        lock _lock;
+    };
+}
@@ -0,0 +1,65 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Line layout interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Word wrapping of scrollback lines into rows of a fixed number of
+    // cells. Characters take zero, one or two cells, East Asian wide and
+    // fullwidth forms taking two; widths come from range tables once per
+    // character and are cached after that.
+    //
+    // Each line's row count is kept until the width changes. Questions
+    // about the end of the scrollback, such as which lines fill the screen,
+    // only lay out the lines they need; the rest is laid out a budget at a
+    // time by step(), newest lines first. fit() answers the same question
+    // for a filtered set of lines.
+    //
+    class layout {
+    public:
+        enum { LAYOUT_Tab = 8 };
+
+        layout(scrollback& source);
+        void width(size_t columns);
+        size_t width() const { return _columns; }
+        size_t rows(size_t index);
+        size_t tail(size_t rows);
+        size_t fit(const std::vector<size_t>& lines, size_t rows);
+        bool step(size_t budget);
+        int glyph(unsigned long c);
+        size_t wrap(const std::wstring& text, size_t columns, std::vector<size_t>* breaks = NULL);
+
+    private:
+        static int _measure(unsigned long c);
+        scrollback::snapshot _sync();
+        size_t& _rows(size_t index) { return _counts[index - _first]; }
+
+        scrollback& _source;
+        std::vector<unsigned char> _widths;   // Cells per character, 0xFF until measured
+        std::deque<size_t> _counts;           // Rows per line, 0 until laid out
+        size_t _first;
+        size_t _cursor;                       // Where step() carries on, counting down
+        size_t _columns;
+    };
+}
@@ -28,25 +28,45 @@ namespace db
     public:
         typedef std::wstring string;
         enum type { MESSAGE_Mail, MESSAGE_Windows, MESSAGE_Quit };
+
+        struct header {
+            header() : level(0), category(0), tick(0) {}
+            unsigned char level;
+            unsigned char category;
+            unsigned long long tick;
+        };
         
         struct message {
-            type type;
+            enum type type;
             string mail;
+            header info;
             MSG windows;
             DWORD status;
         };
 
-        mail(int mailboxes); virtual ~mail();
+        mail(int mailboxes, memory_resource* memory = NULL); virtual ~mail();
         bool send(const string& mail, unsigned long timeout);
+        bool send(const string& mail, const header& info, unsigned long timeout);
         bool recv(string& buffer, unsigned long timeout);
+        bool recv(string& buffer, header& info, unsigned long timeout);
         bool recv(message& message, unsigned long timeout);
+        result put(const string& mail, const header& info, unsigned long timeout);
+        result take(string& buffer, header& info, unsigned long timeout);
+        void close();
+        size_t waiting() const { return _waiting.load(); }
+        size_t capacity() const { return _boxes.size(); }
 
     private:
-        std::vector<string> _boxes;
+        typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, allocator<wchar_t> > box;
+
+        std::vector<box> _boxes;
+        std::vector<header> _headers;
         int _next_filled;
         int _next_empty;
+        std::atomic<size_t> _waiting;  // Filled mailboxes, for gauging the backlog
         HANDLE _sem_empty;
         HANDLE _sem_filled;
+        HANDLE _event_closed;
         lock _lock;
     };
 }
@@ -0,0 +1,87 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Markup template interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Output templates with inline styles, such as "[<red>ERR</red>] {}: {}".
+    // Tags name a colour, <b> for bold or <#RRGGBB>, and close in order;
+    // each {} takes the next argument, and << {{ }} stand for themselves.
+    //
+    // A template is parsed once, when it is made, into pieces of ready made
+    // rich text between argument slots, so formatting only converts and
+    // escapes the arguments and joins the pieces. Templates without tags
+    // produce plain text. Malformed templates throw when they are made,
+    // so keeping them as statics catches mistakes at startup.
+    //
+    class markup {
+    public:
+        markup(const std::wstring& layout);
+
+        template <class... Args>
+        std::wstring operator()(const Args&... args) const {
+            if (sizeof...(Args) != _pieces.size() - 1) throw win_exception(ERROR_INVALID_PARAMETER);
+            std::wstring out;
+            out.reserve(_size + 16 * sizeof...(Args));
+            out.append(_header);
+            _fill(out, 0, args...);
+            out.append(_footer);
+            return out;
+        }
+
+        size_t arguments() const { return _pieces.size() - 1; }
+        const std::vector<style_table::id>& styles() const { return _styles; }
+
+    private:
+        template <class T, class... Rest>
+        void _fill(std::wstring& out, size_t index, const T& value, const Rest&... rest) const {
+            out.append(_pieces[index]);
+            size_t start = out.size();
+            _put(out, value);
+            if (_rich) _escape(out, start);
+            _fill(out, index + 1, rest...);
+        }
+        void _fill(std::wstring& out, size_t index) const { out.append(_pieces[index]); }
+
+        static void _put(std::wstring& out, const std::wstring& value) { out.append(value); }
+        static void _put(std::wstring& out, const wchar_t* value) { out.append(value); }
+        static void _put(std::wstring& out, wchar_t value) { out.push_back(value); }
+        static void _put(std::wstring& out, int value) { out.append(std::to_wstring(static_cast<long long>(value))); }
+        static void _put(std::wstring& out, long value) { out.append(std::to_wstring(static_cast<long long>(value))); }
+        static void _put(std::wstring& out, long long value) { out.append(std::to_wstring(value)); }
+        static void _put(std::wstring& out, unsigned value) { out.append(std::to_wstring(static_cast<unsigned long long>(value))); }
+        static void _put(std::wstring& out, unsigned long value) { out.append(std::to_wstring(static_cast<unsigned long long>(value))); }
+        static void _put(std::wstring& out, unsigned long long value) { out.append(std::to_wstring(value)); }
+        static void _put(std::wstring& out, double value) { out.append(std::to_wstring(static_cast<long double>(value))); }
+        static void _escape(std::wstring& out, size_t start);
+        static bool _colour(const std::wstring& name, COLORREF& colour);
+
+        std::vector<std::wstring> _pieces;     // Literal text around each argument
+        std::vector<style_table::id> _styles;  // Styles the template uses
+        std::wstring _header;
+        std::wstring _footer;
+        size_t _size;
+        bool _rich;
+    };
+}
@@ -0,0 +1,236 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Platform interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+#ifdef _WIN32
+
+// Windows
+#include <Windows.h>
+#include <intrin.h>
+
+#else
+
+//
+// The part of the Windows API the cores use, implemented over POSIX so
+// they can be tested and benchmarked on Linux. Handles are waitable the
+// way kernel objects are, files keep their Windows open semantics and
+// errors are reported through GetLastError. There are no windows, so a
+// thread's message queue is always empty and posting to a window fails.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <pthread.h>
+
+#define WINAPI
+#define CALLBACK
+
+typedef unsigned int DWORD;
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int UINT;
+typedef int LONG;
+typedef long long LONGLONG;
+typedef intptr_t LONG_PTR;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef ULONG_PTR DWORD_PTR;
+typedef UINT_PTR WPARAM;
+typedef LONG_PTR LPARAM;
+typedef void* HANDLE;
+typedef struct HWND__* HWND;
+typedef char* LPSTR;
+typedef const char* LPCSTR;
+typedef wchar_t* LPWSTR;
+typedef const wchar_t* LPCWSTR;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef DWORD COLORREF;
+
+typedef union { struct { DWORD LowPart; LONG HighPart; }; LONGLONG QuadPart; } LARGE_INTEGER;
+typedef struct { DWORD dwLowDateTime, dwHighDateTime; } FILETIME;
+typedef struct { WORD wYear, wMonth, wDayOfWeek, wDay, wHour, wMinute, wSecond, wMilliseconds; } SYSTEMTIME;
+typedef struct { LONG x, y; } POINT;
+typedef struct { HWND hwnd; UINT message; WPARAM wParam; LPARAM lParam; DWORD time; POINT pt; } MSG;
+typedef struct { DWORD dwPageSize; DWORD dwNumberOfProcessors; } SYSTEM_INFO;
+typedef struct { pthread_mutex_t mutex; } CRITICAL_SECTION;
+typedef struct { void* Ptr; } INIT_ONCE;
+
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(void* parameter);
+typedef BOOL (CALLBACK *PINIT_ONCE_FN)(INIT_ONCE* once, void* parameter, void** context);
+
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFF
+#define MAXLONG 0x7FFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WAIT_FAILED 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<LONG_PTR>(-1)))
+#define INVALID_SET_FILE_POINTER (static_cast<DWORD>(-1))
+#define INIT_ONCE_STATIC_INIT { 0 }
+#define TLS_OUT_OF_INDEXES (static_cast<DWORD>(0xFFFFFFFF))
+
+#define ERROR_SUCCESS 0
+#define ERROR_FILE_NOT_FOUND 2
+#define ERROR_PATH_NOT_FOUND 3
+#define ERROR_TOO_MANY_OPEN_FILES 4
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_INVALID_HANDLE 6
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_BAD_FORMAT 11
+#define ERROR_WRITE_FAULT 29
+#define ERROR_READ_FAULT 30
+#define ERROR_HANDLE_EOF 38
+#define ERROR_FILE_EXISTS 80
+#define ERROR_INVALID_PARAMETER 87
+#define ERROR_DISK_FULL 112
+#define ERROR_BUSY 170
+#define ERROR_ALREADY_EXISTS 183
+#define ERROR_NO_MORE_ITEMS 259
+#define ERROR_INVALID_WINDOW_HANDLE 1400
+#define ERROR_TIMEOUT 1460
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define TRUNCATE_EXISTING 5
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define MOVEFILE_REPLACE_EXISTING 0x1
+
+#define FORMAT_MESSAGE_ALLOCATE_BUFFER 0x100
+#define FORMAT_MESSAGE_IGNORE_INSERTS 0x200
+#define FORMAT_MESSAGE_FROM_SYSTEM 0x1000
+#define LANG_NEUTRAL 0
+#define SUBLANG_DEFAULT 1
+#define MAKELANGID(primary, sub) ((static_cast<WORD>(sub) << 10) | static_cast<WORD>(primary))
+
+#define WM_QUIT 0x0012
+#define WM_USER 0x0400
+#define WM_APP 0x8000
+#define PM_NOREMOVE 0x0
+#define PM_REMOVE 0x1
+#define QS_ALLINPUT 0x04FF
+#define MWMO_INPUTAVAILABLE 0x4
+#define CP_UTF8 65001
+
+#define RGB(r, g, b) (static_cast<COLORREF>(static_cast<BYTE>(r) | (static_cast<WORD>(static_cast<BYTE>(g)) << 8) | (static_cast<DWORD>(static_cast<BYTE>(b)) << 16)))
+#define GetRValue(rgb) (static_cast<BYTE>(rgb))
+#define GetGValue(rgb) (static_cast<BYTE>(static_cast<WORD>(rgb) >> 8))
+#define GetBValue(rgb) (static_cast<BYTE>((rgb) >> 16))
+#define LOWORD(l) (static_cast<WORD>(static_cast<DWORD_PTR>(l) & 0xFFFF))
+#define HIWORD(l) (static_cast<WORD>((static_cast<DWORD_PTR>(l) >> 16) & 0xFFFF))
+
+// Errors
+DWORD GetLastError();
+void SetLastError(DWORD error);
+DWORD FormatMessageA(DWORD flags, LPCVOID source, DWORD error, DWORD language, LPSTR buffer, DWORD size, void* arguments);
+void* LocalFree(void* memory);
+
+// Critical sections
+void InitializeCriticalSection(CRITICAL_SECTION* section);
+void DeleteCriticalSection(CRITICAL_SECTION* section);
+void EnterCriticalSection(CRITICAL_SECTION* section);
+BOOL TryEnterCriticalSection(CRITICAL_SECTION* section);
+void LeaveCriticalSection(CRITICAL_SECTION* section);
+BOOL InitOnceExecuteOnce(INIT_ONCE* once, PINIT_ONCE_FN function, void* parameter, void** context);
+
+// Waitable handles
+HANDLE CreateEvent(void* attributes, BOOL manual, BOOL initial, LPCWSTR name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+HANDLE CreateSemaphore(void* attributes, LONG initial, LONG maximum, LPCWSTR name);
+BOOL ReleaseSemaphore(HANDLE semaphore, LONG count, LONG* previous);
+DWORD WaitForSingleObject(HANDLE handle, DWORD timeout);
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL all, DWORD timeout);
+BOOL CloseHandle(HANDLE handle);
+
+// Threads
+HANDLE CreateThread(void* attributes, size_t stack, LPTHREAD_START_ROUTINE start, void* parameter, DWORD flags, DWORD* id);
+DWORD GetCurrentThreadId();
+void Sleep(DWORD milliseconds);
+BOOL SwitchToThread();
+void GetSystemInfo(SYSTEM_INFO* info);
+DWORD TlsAlloc();
+BOOL TlsFree(DWORD index);
+void* TlsGetValue(DWORD index);
+BOOL TlsSetValue(DWORD index, void* value);
+
+// Message queues, always empty
+BOOL PeekMessage(MSG* message, HWND window, UINT first, UINT last, UINT remove);
+BOOL PostMessage(HWND window, UINT message, WPARAM wparam, LPARAM lparam);
+DWORD MsgWaitForMultipleObjectsEx(DWORD count, const HANDLE* handles, DWORD timeout, DWORD mask, DWORD flags);
+
+// Files
+HANDLE CreateFile(LPCWSTR path, DWORD access, DWORD share, void* security, DWORD disposition, DWORD flags, HANDLE model);
+BOOL ReadFile(HANDLE file, void* buffer, DWORD size, DWORD* read, void* overlapped);
+BOOL WriteFile(HANDLE file, const void* buffer, DWORD size, DWORD* written, void* overlapped);
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size);
+BOOL SetFilePointerEx(HANDLE file, LARGE_INTEGER distance, LARGE_INTEGER* position, DWORD method);
+DWORD SetFilePointer(HANDLE file, LONG distance, LONG* high, DWORD method);
+BOOL SetEndOfFile(HANDLE file);
+BOOL FlushFileBuffers(HANDLE file);
+BOOL DeleteFile(LPCWSTR path);
+BOOL MoveFileEx(LPCWSTR from, LPCWSTR to, DWORD flags);
+
+// Time
+DWORD GetTickCount();
+BOOL QueryPerformanceCounter(LARGE_INTEGER* count);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency);
+void GetSystemTimeAsFileTime(FILETIME* time);
+BOOL FileTimeToSystemTime(const FILETIME* time, SYSTEMTIME* system);
+BOOL SystemTimeToTzSpecificLocalTime(void* zone, const SYSTEMTIME* universal, SYSTEMTIME* local);
+
+// Text
+int MultiByteToWideChar(UINT page, DWORD flags, LPCSTR text, int length, LPWSTR out, int size);
+int WideCharToMultiByte(UINT page, DWORD flags, LPCWSTR text, int length, LPSTR out, int size, LPCSTR fallback, BOOL* used);
+
+// Interlocked operations and intrinsics
+inline LONG InterlockedIncrement(LONG volatile* target) { return __sync_add_and_fetch(target, 1); }
+inline LONG InterlockedDecrement(LONG volatile* target) { return __sync_sub_and_fetch(target, 1); }
+inline LONG InterlockedExchangeAdd(LONG volatile* target, LONG value) { return __sync_fetch_and_add(target, value); }
+inline LONG InterlockedExchange(LONG volatile* target, LONG value) { return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedCompareExchange(LONG volatile* target, LONG value, LONG comparand) { return __sync_val_compare_and_swap(target, comparand, value); }
+inline LONGLONG InterlockedExchange64(LONGLONG volatile* target, LONGLONG value) { return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST); }
+inline LONGLONG InterlockedCompareExchange64(LONGLONG volatile* target, LONGLONG value, LONGLONG comparand) { return __sync_val_compare_and_swap(target, comparand, value); }
+inline unsigned char _BitScanForward(unsigned long* index, unsigned long mask) {
+    if (!mask) return 0;
+    *index = static_cast<unsigned long>(__builtin_ctzl(mask));
+    return 1;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Radix tree interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Compressed prefix tree mapping keys to a rank. Every node tracks the
+    // highest rank found in its subtree so that "most recent key with this
+    // prefix" style queries only descend into subtrees that can answer them.
+    //
+    class radix {
+    public:
+        typedef unsigned long rank;
+
+        radix(); virtual ~radix();
+        void insert(const std::wstring& key, rank value);
+        bool erase(const std::wstring& key);
+        bool find(const std::wstring& key, rank& value) const;
+        bool previous(const std::wstring& prefix, rank below, std::wstring& key, rank& value) const;
+        size_t complete(const std::wstring& prefix, std::vector<std::wstring>& keys, size_t limit) const;
+        size_t size() const { return _size; }
+        void clear();
+
+    private:
+        enum { NODE_None = 0xFFFFFFFF };
+
+        struct node {
+            std::wstring label;
+            std::vector<unsigned> children;
+            unsigned parent;
+            rank value; // Zero when no key ends at this node
+            rank best;  // Highest rank in the subtree
+        };
+
+        unsigned _allocate(const std::wstring& label, unsigned parent);
+        void _free(unsigned index);
+        size_t _slot(unsigned index, wchar_t first) const;
+        unsigned _child(unsigned index, wchar_t first) const;
+        unsigned _locate(const std::wstring& prefix, std::wstring& path) const;
+        unsigned _exact(const std::wstring& key) const;
+        unsigned _search(unsigned index, rank below) const;
+        unsigned _descend(unsigned index) const;
+        void _collect(unsigned index, std::wstring& path, std::vector<std::wstring>& keys, size_t limit) const;
+        void _refresh(unsigned index);
+        std::wstring _key(unsigned index) const;
+
+        std::vector<node> _nodes;
+        std::vector<unsigned> _unused;
+        size_t _size;
+    };
+}
@@ -0,0 +1,78 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Shared UI reactor interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    class console;
+
+    //
+    // A fixed set of UI threads shared by any number of consoles. Each
+    // console is pinned to the least loaded thread when it is created and
+    // consoles with pending output take turns draining a bounded number of
+    // messages, so a noisy console cannot starve its neighbours. Requests
+    // reach a thread through a message-only window of its own, so they are
+    // still served while a modal loop, such as a window being dragged, owns
+    // the thread.
+    //
+    class CONSOLE_API reactor {
+    public:
+       /**
+        * Start the shared UI threads
+        *
+        * @param threads the number of UI threads to run
+        */
+        reactor(int threads = 1);
+
+       /**
+        * Stops the UI threads, every attached console must be destroyed first
+        */
+        virtual ~reactor();
+
+    private:
+        friend class console;
+
+        struct loop {
+            reactor* owner;
+            HANDLE thread;
+            HANDLE event_started;
+            HWND window;                // Receives attach and drain requests
+            DWORD error;                // Why the window could not be created
+            std::atomic<bool> posted;   // A drain request is on its way
+            scheduler<console> queue;
+            size_t attached;
+        };
+
+        size_t _attach(console* target);
+        void _detach(console* target, size_t slot);
+        void _signal(console* target, size_t slot);
+
+        static DWORD CALLBACK _callback_threadproc(void* self);
+        static LRESULT CALLBACK _callback_winproc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+        void _thread_run(loop& self);
+        bool _thread_round(loop& self);
+
+        std::vector<loop*> _loops;
+        lock _lock;
+    };
+}
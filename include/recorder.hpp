@@ -0,0 +1,98 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Session recording interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    class console;
+
+    //
+    // Records everything fed into a console: writes, control calls and
+    // input lines, each with the time since recording started and the
+    // thread it came from. Records are variable length integers and UTF-8
+    // text gathered in a buffer, so recording a burst costs little more
+    // than a copy. A torn record at the end of a file is ignored.
+    //
+    class recorder {
+    public:
+        enum kind { EVENT_Write = 1, EVENT_Input, EVENT_Control };
+        enum option {
+            OPTION_Show = 1, OPTION_Title, OPTION_Background, OPTION_Resize, OPTION_Category,
+            OPTION_Filter, OPTION_Dedupe, OPTION_Timestamps, OPTION_Highlight
+        };
+
+        struct event {
+            kind type;
+            timestamp::tick offset;        // Ticks since recording started
+            unsigned long producer;        // Thread identifier
+            option setting;                // Control calls only
+            unsigned char level;           // Writes only
+            unsigned char category;        // Writes only
+            unsigned long timeout;         // Writes only
+            unsigned long long first;      // Control call arguments
+            unsigned long long second;
+            std::wstring text;
+        };
+
+        recorder(); virtual ~recorder();
+        void open(const wchar_t* path);
+        void close();
+        void write(const std::wstring& text, unsigned long timeout, int level, int category);
+        void input(const std::wstring& text);
+        void control(option setting, unsigned long long first = 0, unsigned long long second = 0, const std::wstring& text = std::wstring());
+
+    private:
+        void _begin(kind type);
+        void _end();
+        static void _number(std::string& out, unsigned long long value);
+
+        HANDLE _file;
+        timestamp::tick _origin;
+        timestamp::tick _frequency;
+        std::string _buffer;
+        volatile bool _active;
+        lock _lock;
+    };
+
+    //
+    // Plays a recording back, keeping the recorded pacing scaled by a rate
+    // or as fast as possible. Events go to any handler, so the same file
+    // drives a console or a headless consumer counting what arrives.
+    //
+    class replayer {
+    public:
+        typedef std::function<void(const recorder::event&)> handler;
+
+        replayer(const wchar_t* path);
+        size_t play(const handler& target, double rate = 1.0);
+        size_t play(console& target, double rate = 1.0);
+
+    private:
+        bool _next(size_t& offset, recorder::event& result) const;
+        bool _number(size_t& offset, unsigned long long& value) const;
+        bool _text(size_t& offset, std::wstring& value) const;
+
+        std::string _contents;
+        timestamp::tick _frequency;
+    };
+}
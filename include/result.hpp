@@ -0,0 +1,84 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Operation result interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Outcome of an operation that may fail in the normal course of things,
+    // returned instead of thrown so busy producers can react to a full or
+    // closed console without unwinding or allocating. Only the system error
+    // code is kept, its text is formatted when asked for.
+    //
+    // Configuration calls on a console are rare and keep throwing, returning
+    // the console so they chain; capture() turns one into a result where a
+    // caller would rather not catch.
+    //
+    class result {
+    public:
+        enum code { RESULT_Ok, RESULT_Timeout, RESULT_Full, RESULT_Closed, RESULT_Backend };
+
+        result(code kind = RESULT_Ok, DWORD error = ERROR_SUCCESS)
+            : _kind(kind), _error(error) {}
+
+        explicit operator bool() const { return _kind == RESULT_Ok; }
+        code kind() const { return _kind; }
+        DWORD error() const { return _error; }
+
+        const char* name() const {
+            static const char* names[] = { "ok", "timed out", "full", "closed", "backend error" };
+            return names[_kind];
+        }
+
+        std::string message() const {
+            return (_kind == RESULT_Backend) ? win_exception::format(_error) : std::string(name());
+        }
+
+        void check() const {
+            switch (_kind) {
+            case RESULT_Ok: break;
+            case RESULT_Timeout: throw win_exception(WAIT_TIMEOUT);
+            case RESULT_Full: throw win_exception(ERROR_BUSY);
+            case RESULT_Closed: throw win_exception(ERROR_INVALID_HANDLE);
+            default: throw win_exception(_error);
+            }
+        }
+
+        // Runs a call reporting failure by throwing, for the less frequent calls
+        template <typename F>
+        static result capture(const F& call) {
+            try {
+                call();
+                return result();
+            } catch (const win_exception& error) {
+                return result(RESULT_Backend, error.code());
+            } catch (const std::bad_alloc&) {
+                return result(RESULT_Backend, ERROR_NOT_ENOUGH_MEMORY);
+            }
+        }
+
+    private:
+        code _kind;
+        DWORD _error;
+    };
+}
@@ -0,0 +1,76 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Fair scheduler
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Round robin run queue. A task is queued at most once no matter how
+    // often it is marked ready, and a task that still has work after its
+    // turn goes to the back, so every ready task is served once per round.
+    //
+    template <typename T>
+    class scheduler {
+    public:
+        // Queue a task, returns whether it was idle until now
+        bool ready(T* task) {
+            _lock.acquire();
+            bool idle = _queued.insert(task).second;
+            if (idle) _queue.push_back(task);
+            _lock.release();
+            return idle;
+        }
+
+        // Take the task whose turn it is
+        bool next(T*& task) {
+            _lock.acquire();
+            bool found = !_queue.empty();
+            if (found) {
+                task = _queue.front();
+                _queue.pop_front();
+                _queued.erase(task);
+            }
+            _lock.release();
+            return found;
+        }
+
+        void remove(T* task) {
+            _lock.acquire();
+            if (_queued.erase(task))
+                _queue.erase(std::find(_queue.begin(), _queue.end(), task));
+            _lock.release();
+        }
+
+        size_t size() {
+            _lock.acquire();
+            size_t result = _queue.size();
+            _lock.release();
+            return result;
+        }
+
+    private:
+        std::deque<T*> _queue;
+        std::set<T*> _queued;
+        lock _lock;
+    };
+}
@@ -0,0 +1,181 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Scrollback interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Everything written to a console, tagged with a level and a category.
+    // Lines are stored in fixed size blocks, each carrying one bitmap per
+    // level and per category present plus summary masks, so selecting lines
+    // skips whole blocks and then walks only the set bits of matching words.
+    // Lines are numbered from the start of the console and evicted a block
+    // at a time once the capacity is exceeded.
+    //
+    // Every block also has a bloom filter of the trigrams it contains, each
+    // setting three bits, so searches only scan blocks that may hold all
+    // trigrams of the text, or of the longest literal run of a regular
+    // expression.
+    //
+    // Blocks are reference counted and a line's text never changes once its
+    // number is published, so a snapshot is just the current block directory
+    // and line count. Appends come from a single thread and take no locks, any
+    // other thread reads through snapshots while writing continues. Words of
+    // the bitmaps, masks and filter that a reader may look at while the writer
+    // marks later lines in them are atomic, as are repeat counters.
+    //
+    // Each block carries an arena for the text of its lines, so evicting a
+    // block frees all of its text in one step. Arenas draw from the memory
+    // resource the scrollback was given.
+    //
+    class scrollback {
+    public:
+        enum level { LEVEL_Debug, LEVEL_Info, LEVEL_Warning, LEVEL_Error, LEVEL_Count };
+        enum { BLOCK_Lines = 1024, CATEGORY_Count = 64 };
+        typedef unsigned long long mask;
+        typedef std::function<bool(size_t index)> match;
+        typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, allocator<wchar_t> > string;
+
+        struct line {
+            line(const allocator<wchar_t>& memory = allocator<wchar_t>())
+                : text(memory), level(0), category(0), repeats(0), stamp(0) {}
+            line(const line& other)
+                : text(other.text), level(other.level), category(other.category), repeats(other.repeats.load()), stamp(other.stamp) {}
+            line& operator=(const line& other) {
+                text = other.text;
+                level = other.level;
+                category = other.category;
+                repeats = other.repeats.load();
+                stamp = other.stamp;
+                return *this;
+            }
+            string text;
+            unsigned char level;
+            unsigned char category;
+            std::atomic<size_t> repeats;  // Counted up while readers look
+            unsigned long long stamp;
+        };
+
+        struct filter {
+            filter(unsigned levels = ~0u, mask categories = ~0ull)
+                : levels(levels), categories(categories) {}
+            bool matches(int level, int category) const {
+                return ((levels >> level) & 1) && ((categories >> category) & 1);
+            }
+            unsigned levels;  // Bit per scrollback::level
+            mask categories;  // Bit per category identifier
+        };
+
+    private:
+        enum { BLOOM_Bits = 1 << 17, BLOOM_Hashes = 3 };
+
+        struct bitmap {
+            bitmap() { for (size_t i = 0; i < BLOCK_Lines / 64; i++) words[i].store(0, std::memory_order_relaxed); }
+            std::atomic<mask> words[BLOCK_Lines / 64];
+        };
+
+        struct block {
+            block(memory_resource* upstream);
+            arena memory;   // Outlives the lines using it
+            size_t base;
+            std::vector<line> lines;
+            bitmap levels[LEVEL_Count];
+            std::atomic<bitmap*> categories[CATEGORY_Count];  // In the arena, only for categories present
+            std::atomic<unsigned> level_mask;
+            std::atomic<mask> category_mask;
+            std::atomic<mask> trigrams[BLOOM_Bits / 64];
+        };
+
+        struct directory {
+            std::vector<std::shared_ptr<block> > blocks;
+            size_t first;
+        };
+
+    public:
+        class snapshot {
+        public:
+            snapshot() : _end(0) {}
+            size_t first() const { return _directory ? (std::min)(_directory->first, _end) : 0; }
+            size_t end() const { return _end; }
+            const line& at(size_t index) const;
+            bool get(size_t index, line& result) const;
+            size_t select(const filter& which, size_t from, std::vector<size_t>& lines, size_t until = static_cast<size_t>(-1)) const;
+            size_t search(const std::wstring& pattern, bool expression, const match& found) const;
+
+        private:
+            friend class scrollback;
+            size_t _count(const block& current) const;
+
+            std::shared_ptr<const directory> _directory;
+            size_t _end;
+        };
+
+        scrollback(size_t capacity, memory_resource* memory = NULL); virtual ~scrollback();
+        int category(const std::wstring& name);
+        size_t append(const std::wstring& text, int level, int category, unsigned long long stamp = 0);
+        bool repeat(size_t index);
+        snapshot take() const;
+
+        // Shorthands reading through a fresh snapshot
+        size_t select(const filter& which, size_t from, std::vector<size_t>& lines, size_t until = static_cast<size_t>(-1)) const;
+        bool get(size_t index, line& result) const;
+        size_t search(const std::wstring& pattern, bool expression, const match& found) const;
+        size_t first() const;
+        size_t end() const;
+
+    private:
+        static unsigned long _lowest(mask bits);
+        static unsigned long long _trigram(const wchar_t* text);
+        static void _bloom(unsigned long long trigram, size_t positions[BLOOM_Hashes]);
+        static void _mark(std::atomic<mask>& word, mask bits);
+        static std::wstring _literal(const std::wstring& expression);
+        void _extend();
+
+        std::shared_ptr<const directory> _directory;
+        std::shared_ptr<block> _current;
+        std::atomic<size_t> _end;
+        size_t _capacity;
+        memory_resource* _memory;
+        std::vector<std::wstring> _categories;
+        lock _lock;
+    };
+
+    //
+    // Lines of a scrollback matching a filter, kept up to date incrementally.
+    // Any number of views can share the same scrollback.
+    //
+    class view {
+    public:
+        view(scrollback& store, const scrollback::filter& which = scrollback::filter());
+        void refresh();
+        size_t size() const { return _lines.size(); }
+        size_t index(size_t position) const { return _lines[position]; }
+        const scrollback::filter& which() const { return _filter; }
+
+    private:
+        scrollback& _store;
+        scrollback::filter _filter;
+        std::deque<size_t> _lines;
+        size_t _next;
+    };
+}
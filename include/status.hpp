@@ -0,0 +1,78 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Status line interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    class console;
+
+    //
+    // The latest text of every status line. Updates only overwrite a slot,
+    // and only the first update after a frame asks for another, so any
+    // number of updates between two frames costs one redraw showing the
+    // latest text of each line, and nothing reaches the scrollback. Slots
+    // count the lines they have held, so a handle to a closed line cannot
+    // touch the line that got its slot next.
+    //
+    class status_board {
+    public:
+        status_board();
+        size_t open(unsigned& generation);
+        bool close(size_t slot, unsigned generation);
+        bool update(size_t slot, unsigned generation, const std::wstring& text);
+        bool collect(std::vector<std::wstring>& lines);
+
+    private:
+        struct slot {
+            slot() : generation(0), open(false) {}
+            std::wstring text;
+            unsigned generation;   // Lines the slot has held
+            bool open;
+        };
+
+        std::vector<slot> _slots;
+        bool _changed;     // Something changed since the last frame
+        bool _scheduled;   // A frame was asked for and has not been drawn yet
+        lock _lock;
+    };
+
+    //
+    // Handle to a status line of a console, cheap to copy. The line stays
+    // until it is closed or the console goes away, after which every copy
+    // of the handle does nothing.
+    //
+    class status_line {
+    public:
+        status_line& update(const std::wstring& text);
+        void close();
+
+    private:
+        friend class console;
+        status_line(console* owner, size_t slot, unsigned generation)
+            : _owner(owner), _slot(slot), _generation(generation) {}
+
+        console* _owner;
+        size_t _slot;
+        unsigned _generation;
+    };
+}
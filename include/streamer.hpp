@@ -0,0 +1,88 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output streaming interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Serves console output to local viewers over a Unix domain socket.
+    // Every frame is a little endian 32-bit length, a type byte and a
+    // payload. A text frame carries the line number, level, category, tick,
+    // style runs and UTF-8 text; a new viewer first gets the tail of the
+    // scrollback, then a FRAME_Live marker, then lines as they are written.
+    //
+    // Frames are encoded once and shared by all viewers. Each viewer has
+    // its own bounded queue drained by a single server thread; a viewer
+    // that falls behind skips ahead to the newest frames and is told how
+    // many it missed, so the console never waits on a slow reader.
+    //
+    class streamer {
+    public:
+        enum frame { FRAME_Text = 1, FRAME_Repeat, FRAME_Skipped, FRAME_Live };
+
+        streamer(scrollback& source, highlighter& styles);
+        virtual ~streamer();
+        void listen(const wchar_t* path);
+        void publish(size_t index);
+        void repeat(size_t index, size_t count);
+
+    private:
+        typedef std::shared_ptr<const std::string> packet;
+
+        // Winsock stays out of this header, sockets and events are kept as their underlying types
+        typedef UINT_PTR socket_handle;
+
+        struct client {
+            socket_handle socket;
+            HANDLE event;
+            std::deque<packet> queue;
+            size_t queued;   // Bytes waiting
+            size_t offset;   // Bytes of the front packet already sent
+            size_t start;    // First line not covered by the tail
+        };
+
+        static BOOL CALLBACK _callback_startup(INIT_ONCE* once, void* parameter, void** context);
+        static DWORD CALLBACK _callback_threadproc(void* self);
+        void _thread_run();
+        void _thread_accept();
+        bool _thread_flush(client& target);
+        void _encode(size_t index, const scrollback::line& entry, std::string& out);
+        static void _frame(frame type, const std::string& payload, std::string& out);
+        void _enqueue(client& target, const packet& data);
+        static void _put(std::string& out, unsigned long long value, int bytes);
+        static void _close(client* target);
+
+        static INIT_ONCE _startup;
+
+        scrollback& _source;
+        highlighter& _styles;
+        std::vector<client*> _clients;
+        std::wstring _path;
+        socket_handle _listener;
+        HANDLE _event_listener;
+        HANDLE _event_wake;
+        HANDLE _thread;
+        volatile bool _quit;
+        lock _lock;
+    };
+}
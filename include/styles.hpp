@@ -0,0 +1,69 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Text style interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    struct style {
+        style(COLORREF colour = 0, bool bold = false)
+            : colour(colour), bold(bold) {}
+        bool operator==(const style& other) const { return colour == other.colour && bold == other.bold; }
+        COLORREF colour;
+        bool bold;
+    };
+
+    //
+    // Every distinct style in use, stored once and referred to by a small
+    // identifier. Runs of styled text carry identifiers, so comparing and
+    // merging runs is an integer compare and a renderer can cache whatever
+    // it builds for a style by identifier. Styles are never removed and
+    // never move once stored, so looking one up takes no lock. The table is
+    // built on first use, so styles can be interned while other files are
+    // still running their static initializers.
+    //
+    class style_table {
+    public:
+        typedef unsigned short id;
+        enum { STYLE_Plain = 0, STYLE_Count = 0x10000, STYLE_Chunk = 256 };
+
+        static id intern(const style& format);
+        static const style& lookup(id which);
+        static size_t size();
+
+    private:
+        struct storage {
+            storage() : size(0) { memset(chunks, 0, sizeof(chunks)); }
+            std::unordered_map<unsigned long long, id> ids;
+            style* chunks[STYLE_Count / STYLE_Chunk];
+            std::atomic<size_t> size;
+            lock guard;
+        };
+
+        static BOOL CALLBACK _callback_initialize(INIT_ONCE* once, void* parameter, void** context);
+        static storage& _storage();
+        static unsigned long long _key(const style& format);
+
+        static INIT_ONCE _once;
+        static storage* _table;
+    };
+}
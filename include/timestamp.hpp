@@ -0,0 +1,80 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Timestamp interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Cheap monotonic ticks from the performance counter. The counter is
+    // paired with the system clock once, the first time a tick has to be
+    // shown, and ticks are only turned into wall clock time and text when
+    // they are rendered or exported.
+    //
+    class timestamp {
+    public:
+        typedef unsigned long long tick;
+
+        struct calibration {
+            tick origin;                 // Counter value at the reference point
+            unsigned long long wall;     // System time at the same point, in 100ns units
+            tick frequency;              // Counter ticks per second
+        };
+
+        static tick now();
+        static const calibration& calibrated();
+        static unsigned long long wall(tick stamp, const calibration& base);
+        static std::wstring text(tick stamp);
+        static double seconds(tick elapsed);
+
+    private:
+        static BOOL CALLBACK _callback_calibrate(INIT_ONCE* once, void* parameter, void** context);
+
+        static calibration _calibration;
+        static INIT_ONCE _once;
+    };
+
+    //
+    // Distribution of delays measured in ticks, kept as power of two
+    // buckets of microseconds so recording costs a handful of instructions.
+    //
+    class latency {
+    public:
+        struct summary {
+            unsigned long long count;
+            double mean, p50, p99, max;  // Seconds
+        };
+
+        latency();
+        void record(timestamp::tick elapsed);
+        summary snapshot();
+
+    private:
+        enum { BUCKET_Count = 40 };
+
+        unsigned long long _buckets[BUCKET_Count];
+        unsigned long long _count;
+        timestamp::tick _total;
+        timestamp::tick _max;
+        lock _lock;
+    };
+}
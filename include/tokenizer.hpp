@@ -0,0 +1,92 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input tokenizer interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Splits text into styled tokens one at a time. A tokenizer keeps no
+    // position of its own, all it needs to carry on from a token boundary
+    // is the state it returned there, so lexing can start over from any
+    // boundary that was remembered.
+    //
+    class tokenizer {
+    public:
+        typedef unsigned state;
+
+        virtual ~tokenizer() {}
+        virtual state initial() { return 0; }
+        virtual size_t next(const std::wstring& text, size_t position, state& current, style_table::id& format) = 0;
+    };
+
+    //
+    // Tokens of command lines: the command name, options, numbers and quoted
+    // strings. Given the registered commands, once there are any, names that
+    // are not among them stand out as mistakes.
+    //
+    class command_tokenizer : public tokenizer {
+    public:
+        command_tokenizer(commands* known = NULL);
+        virtual size_t next(const std::wstring& text, size_t position, state& current, style_table::id& format);
+
+    private:
+        enum { STATE_Command, STATE_Arguments, STATE_String, TOKEN_Longest = 256 };
+
+        commands* _known;
+        style_table::id _command, _unknown, _option, _number, _string;
+    };
+
+    //
+    // Keeps the tokens of edited text up to date. After an edit, lexing
+    // starts again from the last token boundary before it and stops at the
+    // first remembered boundary past every edit that is reached in the same
+    // state as before, since all that follows is unchanged but for where it
+    // is. An update lexes at most a budget of characters, the next update
+    // carries on where it stopped.
+    //
+    class lexer {
+    public:
+        struct token {
+            size_t start;
+            size_t length;
+            tokenizer::state entry;   // State the token was lexed from
+            style_table::id format;
+        };
+
+        lexer();
+        void rules(tokenizer* rules);
+        void edit(size_t position, size_t removed, size_t inserted);
+        bool update(const std::wstring& text, size_t budget, size_t& from, size_t& to);
+        const std::vector<token>& tokens() const { return _tokens; }
+
+    private:
+        tokenizer* _rules;
+        std::vector<token> _tokens;   // Lexed tokens, up to where lexing resumes
+        std::vector<token> _tail;     // Tokens after the edits, kept to converge on
+        std::vector<token> _scratch;
+        size_t _resume;               // Where lexing carries on
+        tokenizer::state _state;      // State lexing carries on in
+        size_t _dirty;                // End of the edits, in current positions
+        size_t _length;               // Length of the text, kept up with the edits
+    };
+}
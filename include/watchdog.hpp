@@ -0,0 +1,73 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   UI thread stall detection interface
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+namespace db
+{
+    //
+    // Times every turn of a UI thread and keeps the slowest ones seen, with
+    // what was being handled, so a frozen console can be traced to the
+    // message that froze it. Turns longer than a threshold count as stalls,
+    // and a turn still running shows up in a snapshot taken meanwhile.
+    // Entering a turn is a single store, leaving one a short locked update.
+    // The start of the running turn is atomic so that a snapshot from
+    // another thread never sees half of it on 32-bit builds.
+    //
+    class watchdog {
+    public:
+        enum source { SOURCE_Mail, SOURCE_Windows };
+        enum { SLOWEST_Count = 16 };
+
+        struct sample {
+            source kind;
+            unsigned message;        // Windows message, 0 for mail
+            size_t payload;          // Characters of mail handled
+            timestamp::tick stamp;   // When the turn began
+            double seconds;
+        };
+
+        struct summary {
+            unsigned long long count, stalls;
+            double busy;                  // Seconds spent in turns
+            double current;               // Seconds the turn running now has taken, 0 when idle
+            std::vector<sample> slowest;  // Longest first
+        };
+
+        watchdog();
+        void threshold(double seconds);
+        void enter() { _entered.store(timestamp::now(), std::memory_order_relaxed); }
+        void leave(source kind, unsigned message, size_t payload);
+        summary snapshot();
+
+    private:
+        sample _slowest[SLOWEST_Count];
+        size_t _slowest_count;
+        timestamp::tick _floor;      // Shortest turn worth keeping
+        timestamp::tick _limit;      // Turns at least this long are stalls
+        std::atomic<timestamp::tick> _entered;
+        unsigned long long _count;
+        unsigned long long _stalls;
+        timestamp::tick _busy;
+        lock _lock;
+    };
+}
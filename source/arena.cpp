@@ -0,0 +1,205 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Memory resource implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    //
+    // Global heap
+    //
+    class heap_resource : public memory_resource {
+    public:
+        void* allocate(size_t bytes, size_t) { return ::operator new(bytes); }
+        void deallocate(void* pointer, size_t, size_t) { ::operator delete(pointer); }
+    };
+
+    static heap_resource MEMORY_Heap;
+
+    memory_resource* memory_resource::heap() {
+        return &MEMORY_Heap;
+    }
+
+    //
+    // Monotonic arena
+    //
+    arena::arena(memory_resource* upstream, size_t chunk)
+        : _upstream(upstream ? upstream : memory_resource::heap()), _chunk(chunk),
+          _chunks(NULL), _next(NULL), _end(NULL), _used(0) {}
+
+    arena::~arena() {
+        release();
+    }
+
+    void* arena::allocate(size_t bytes, size_t alignment) {
+        size_t skip = (alignment - reinterpret_cast<size_t>(_next) % alignment) % alignment;
+        if (!_next || skip + bytes > static_cast<size_t>(_end - _next)) {
+            // Start a new chunk, big requests get one of their own
+            size_t header = (sizeof(chunk) + MEMORY_Alignment - 1) / MEMORY_Alignment * MEMORY_Alignment;
+            size_t size = header + (std::max)(_chunk, bytes + alignment);
+            chunk* fresh = static_cast<chunk*>(_upstream->allocate(size));
+            fresh->next = _chunks;
+            fresh->size = size;
+            _chunks = fresh;
+            _used += size;
+            _next = reinterpret_cast<char*>(fresh) + header;
+            _end = reinterpret_cast<char*>(fresh) + size;
+            skip = (alignment - reinterpret_cast<size_t>(_next) % alignment) % alignment;
+        }
+
+        void* result = _next + skip;
+        _next += skip + bytes;
+        return result;
+    }
+
+    void arena::release() {
+        while (_chunks) {
+            chunk* next = _chunks->next;
+            _upstream->deallocate(_chunks, _chunks->size);
+            _chunks = next;
+        }
+        _next = _end = NULL;
+        _used = 0;
+    }
+
+    //
+    // Size class pool
+    //
+    pool::pool(size_t limit, memory_resource* upstream)
+        : _upstream(upstream ? upstream : memory_resource::heap()), _limit(limit), _used(0), _large(NULL) {
+        for (size_t i = 0; i < POOL_Stripes; i++)
+            memset(_stripes[i].free, 0, sizeof(_stripes[i].free));
+    }
+
+    pool::~pool() {
+        for (size_t i = 0; i < POOL_Stripes; i++)
+            for (size_t j = 0; j < _stripes[i].slabs.size(); j++)
+                _upstream->deallocate(_stripes[i].slabs[j], POOL_Slab);
+        while (_large) {
+            large* next = _large->next;
+            _upstream->deallocate(_large, sizeof(large) + _large->bytes);
+            _large = next;
+        }
+    }
+
+    void* pool::allocate(size_t bytes, size_t alignment) {
+        int index = _class((std::max)(bytes, alignment));
+        if (index < 0) {
+            // Kept on a list of its own so destroying the pool finds it
+            _reserve(sizeof(large) + bytes);
+            large* block;
+            try {
+                block = static_cast<large*>(_upstream->allocate(sizeof(large) + bytes));
+            } catch (...) {
+                _used -= sizeof(large) + bytes;
+                throw;
+            }
+            block->previous = NULL;
+            block->bytes = bytes;
+            _lock.acquire();
+            block->next = _large;
+            if (_large) _large->previous = block;
+            _large = block;
+            _lock.release();
+            return block + 1;
+        }
+
+        stripe& current = _stripe();
+        current.guard.acquire();
+        if (!current.free[index]) {
+            // Cut a fresh slab into blocks of this class
+            char* slab = NULL;
+            try {
+                _reserve(POOL_Slab);
+                try {
+                    slab = static_cast<char*>(_upstream->allocate(POOL_Slab));
+                    current.slabs.push_back(slab);
+                } catch (...) {
+                    if (slab) _upstream->deallocate(slab, POOL_Slab);
+                    _used -= POOL_Slab;
+                    throw;
+                }
+            } catch (...) {
+                current.guard.release();
+                throw;
+            }
+            size_t size = static_cast<size_t>(POOL_Smallest) << index;
+            for (size_t offset = 0; offset + size <= POOL_Slab; offset += size) {
+                node* fresh = reinterpret_cast<node*>(slab + offset);
+                fresh->next = current.free[index];
+                current.free[index] = fresh;
+            }
+        }
+
+        node* result = current.free[index];
+        current.free[index] = result->next;
+        current.guard.release();
+        return result;
+    }
+
+    void pool::deallocate(void* pointer, size_t bytes, size_t alignment) {
+        if (!pointer) return;
+        int index = _class((std::max)(bytes, alignment));
+        if (index < 0) {
+            large* block = static_cast<large*>(pointer) - 1;
+            _lock.acquire();
+            if (block->previous) block->previous->next = block->next;
+            else _large = block->next;
+            if (block->next) block->next->previous = block->previous;
+            _lock.release();
+            _used -= sizeof(large) + block->bytes;
+            _upstream->deallocate(block, sizeof(large) + block->bytes);
+            return;
+        }
+
+        // Blocks of a class are interchangeable, they go to the freeing thread's stripe
+        stripe& current = _stripe();
+        current.guard.acquire();
+        node* freed = static_cast<node*>(pointer);
+        freed->next = current.free[index];
+        current.free[index] = freed;
+        current.guard.release();
+    }
+
+    size_t pool::used() {
+        return _used.load();
+    }
+
+    int pool::_class(size_t bytes) {
+        int index = 0;
+        for (size_t size = POOL_Smallest; size < bytes; size <<= 1)
+            if (++index >= POOL_Classes) return -1;
+        return index;
+    }
+
+    void pool::_reserve(size_t bytes) {
+        if (_used.fetch_add(bytes) + bytes > _limit && _limit) {
+            _used -= bytes;
+            throw std::bad_alloc();
+        }
+    }
+
+    pool::stripe& pool::_stripe() {
+        // Thread identifiers are multiples of four
+        return _stripes[(GetCurrentThreadId() >> 2) % POOL_Stripes];
+    }
+}
@@ -0,0 +1,88 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output backlog detection implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Messages in a row the queue has to stay deep before falling behind
+    static const size_t BACKLOG_SUSTAIN = 64;
+
+    // Seconds of drawing the queue has to hold before falling behind
+    static const double BACKLOG_ENTER = 0.25;
+
+    // Seconds over which the arrival rate is measured while behind
+    static const double BACKLOG_WINDOW = 0.25;
+
+    // Share of the time drawing may take before catching up is worth it
+    static const double BACKLOG_RESUME = 0.5;
+
+    // Weight of the newest drawing time in the average
+    static const double BACKLOG_SMOOTHING = 1.0 / 32;
+
+    backlog::backlog()
+        : _high(1), _low(0), _cost(0), _strikes(0), _arrived(0), _window(0), _behind(false) {}
+
+    void backlog::capacity(size_t mailboxes) {
+        _high = (std::max)(static_cast<size_t>(1), mailboxes / 2);
+        _low = mailboxes / 8;
+    }
+
+    bool backlog::handled(size_t waiting, timestamp::tick now) {
+        _arrived++;
+        return _evaluate(waiting, now);
+    }
+
+    bool backlog::check(size_t waiting, timestamp::tick now) {
+        return _evaluate(waiting, now);
+    }
+
+    void backlog::rendered(timestamp::tick elapsed) {
+        double ticks = static_cast<double>(static_cast<long long>(elapsed));
+        _cost = _cost ? _cost + (ticks - _cost) * BACKLOG_SMOOTHING : ticks;
+    }
+
+    bool backlog::_evaluate(size_t waiting, timestamp::tick now) {
+        double frequency = static_cast<double>(static_cast<long long>(timestamp::calibrated().frequency));
+        if (!_behind) {
+            // Fall behind on a queue that stays deep and would take long to draw
+            bool deep = waiting >= _high && waiting * _cost >= BACKLOG_ENTER * frequency;
+            _strikes = deep ? _strikes + 1 : 0;
+            if (_strikes >= BACKLOG_SUSTAIN) {
+                _behind = true;
+                _strikes = 0;
+                _arrived = 0;
+                _window = now;
+            }
+            return _behind;
+        }
+
+        // Judge the arrival rate over whole windows
+        double elapsed = static_cast<double>(static_cast<long long>(now - _window));
+        if (elapsed < BACKLOG_WINDOW * frequency) return true;
+        double load = _arrived * _cost / elapsed;
+        if (waiting <= _low && load < BACKLOG_RESUME) _behind = false;
+        _arrived = 0;
+        _window = now;
+        return _behind;
+    }
+}
@@ -0,0 +1,225 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input fan-out implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    result subscription::read(std::wstring& buffer, unsigned long timeout) {
+        return _owner ? _owner->_read(_slot, _generation, buffer, timeout) : result(result::RESULT_Closed);
+    }
+
+    void subscription::cancel() {
+        if (_owner) _owner->_cancel(_slot, _generation);
+    }
+
+    broadcast::broadcast(int frames, memory_resource* memory) {
+        // Copies of a frame fall back to the heap, so every frame is made in place
+        _frames.reserve(frames);
+        for (int i = 0; i < frames; i++) _frames.push_back(frame(allocator<wchar_t>(memory)));
+        _routes.assign(frames, 0);
+        _published = 0;
+        _waiting = 0;
+        _closed = false;
+        for (size_t i = 0; i < SUBSCRIBER_Count; i++) {
+            _readers[i].cursor = 0;
+            _readers[i].active = false;
+            _readers[i].generation = 0;
+            _readers[i].routes = 0;
+            _readers[i].event = CreateEvent(NULL, TRUE, FALSE, NULL);
+        }
+        _event_space = CreateEvent(NULL, FALSE, FALSE, NULL);
+    }
+
+    broadcast::~broadcast() {
+        for (size_t i = 0; i < SUBSCRIBER_Count; i++)
+            CloseHandle(_readers[i].event);
+        CloseHandle(_event_space);
+    }
+
+    subscription broadcast::subscribe(const std::wstring& prefix, unsigned routes) {
+        _lock.acquire();
+        size_t slot = 0;
+        while (slot < SUBSCRIBER_Count && _readers[slot].active) slot++;
+        if (slot == SUBSCRIBER_Count) {
+            _lock.release();
+            throw win_exception(ERROR_NO_MORE_ITEMS);
+        }
+
+        // New subscribers start with whatever is published next. Copies of an
+        // earlier subscription of the slot may still be reading, they give up
+        // once they find the generation changed
+        reader& self = _readers[slot];
+        self.guard.acquire();
+        unsigned generation = ++self.generation;
+        self.prefix = prefix;
+        self.routes = routes;
+        self.cursor = _published.load();
+        self.active = true;
+        self.guard.release();
+        _lock.release();
+        return subscription(this, slot, generation);
+    }
+
+    result broadcast::publish(const std::wstring& text, unsigned route, unsigned long timeout) {
+        // Wait for the slowest subscriber to move past the oldest frame
+        DWORD start = GetTickCount();
+        _waiting++;
+        for (;;) {
+            _lock.acquire();
+            if (_closed) {
+                _lock.release();
+                _waiting--;
+                return result(result::RESULT_Closed);
+            }
+            if (_published - _oldest() < _frames.size()) break;
+            _lock.release();
+
+            DWORD elapsed = GetTickCount() - start;
+            if (timeout != INFINITE && elapsed >= timeout) {
+                _waiting--;
+                return result(timeout ? result::RESULT_Timeout : result::RESULT_Full);
+            }
+            if (WaitForSingleObject(_event_space, timeout == INFINITE ? INFINITE : timeout - elapsed) == WAIT_FAILED) {
+                _waiting--;
+                return result(result::RESULT_Backend, GetLastError());
+            }
+        }
+        _waiting--;
+
+        // Nobody looks at the frame until it is published
+        size_t index = static_cast<size_t>(_published % _frames.size());
+        try {
+            _frames[index].assign(text.data(), text.size());
+        } catch (const std::bad_alloc&) {
+            _lock.release();
+            return result(result::RESULT_Backend, ERROR_NOT_ENOUGH_MEMORY);
+        }
+        _routes[index] = route;
+        _published++;
+        _lock.release();
+
+        // Wake the subscribers, and the next publisher in case there is room for it too
+        for (size_t i = 0; i < SUBSCRIBER_Count; i++)
+            if (_readers[i].active) SetEvent(_readers[i].event);
+        if (_waiting) SetEvent(_event_space);
+        return result();
+    }
+
+    void broadcast::close() {
+        // Everyone waiting, and everyone after, gives up
+        _closed = true;
+        for (size_t i = 0; i < SUBSCRIBER_Count; i++)
+            SetEvent(_readers[i].event);
+        SetEvent(_event_space);
+    }
+
+    result broadcast::_read(size_t slot, unsigned generation, std::wstring& buffer, unsigned long timeout) {
+        reader& self = _readers[slot];
+        DWORD start = GetTickCount();
+        for (bool armed = false;;) {
+            // Readers sharing a cursor take turns, but never wait while holding it
+            self.guard.acquire();
+            if (!self.active || self.generation != generation) {
+                self.guard.release();
+                // The event may have been cleared for whoever has the slot now
+                SetEvent(self.event);
+                return result(result::RESULT_Closed);
+            }
+            bool taken = _take(self, buffer);
+            bool more = self.cursor < _published;
+            self.guard.release();
+            if (taken) {
+                // Leave the event set for anyone else reading through this cursor
+                if (more) SetEvent(self.event);
+                return result();
+            }
+            if (_closed) return result(result::RESULT_Closed);
+
+            // Look once more after clearing the event, so no publish is missed
+            if (!armed) {
+                ResetEvent(self.event);
+                armed = true;
+                continue;
+            }
+            DWORD elapsed = GetTickCount() - start;
+            if (timeout != INFINITE && elapsed >= timeout) return result(result::RESULT_Timeout);
+            if (WaitForSingleObject(self.event, timeout == INFINITE ? INFINITE : timeout - elapsed) == WAIT_FAILED)
+                return result(result::RESULT_Backend, GetLastError());
+            armed = false;
+        }
+    }
+
+    bool broadcast::_take(reader& self, std::wstring& buffer) {
+        // Skip frames without a line for this reader, copying only the lines that match
+        sequence at = self.cursor;
+        bool taken = false;
+        while (!taken && at < _published) {
+            size_t index = static_cast<size_t>(at % _frames.size());
+            const frame& text = _frames[index];
+            if (_routes[index] & self.routes) {
+                if (self.prefix.empty()) {
+                    buffer.assign(text.begin(), text.end());
+                    taken = true;
+                } else {
+                    buffer.clear();
+                    for (size_t begin = 0; begin < text.size();) {
+                        // Lines end in a carriage return, a line feed or both
+                        size_t end = text.find_first_of(L"\r\n", begin);
+                        if (end == frame::npos) end = text.size();
+                        else if (text[end] == L'\r' && end + 1 < text.size() && text[end + 1] == L'\n') end += 2;
+                        else end++;
+                        if (end - begin >= self.prefix.size() && text.compare(begin, self.prefix.size(), self.prefix.c_str()) == 0)
+                            buffer.append(text.begin() + begin, text.begin() + end);
+                        begin = end;
+                    }
+                    taken = !buffer.empty();
+                }
+            }
+            self.cursor = ++at;
+        }
+
+        // A publisher may be waiting on this reader
+        if (_waiting) SetEvent(_event_space);
+        return taken;
+    }
+
+    void broadcast::_cancel(size_t slot, unsigned generation) {
+        // A cancelled reader no longer holds up publishing, but only once nobody
+        // is still reading a frame through it
+        reader& self = _readers[slot];
+        self.guard.acquire();
+        bool current = self.active && self.generation == generation;
+        if (current) self.active = false;
+        self.guard.release();
+        if (!current) return;
+        SetEvent(self.event);
+        SetEvent(_event_space);
+    }
+
+    broadcast::sequence broadcast::_oldest() {
+        sequence oldest = _published;
+        for (size_t i = 0; i < SUBSCRIBER_Count; i++)
+            if (_readers[i].active) oldest = (std::min)(oldest, _readers[i].cursor.load());
+        return oldest;
+    }
+}
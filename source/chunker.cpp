@@ -0,0 +1,56 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input chunking implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    chunker::chunker(size_t chunk)
+        : _chunk(chunk), _position(0), _length(0) {}
+
+    void chunker::start(size_t length) {
+        _position = 0;
+        _length = length;
+    }
+
+    void chunker::next(const source& fetch, std::wstring& frame) {
+        size_t end = (std::min)(_position + _chunk, _length);
+        frame.clear();
+        fetch(_position, end, frame);
+        if (frame.size() > end - _position) frame.resize(end - _position);
+
+        // Cut back to the last line break unless a single line fills the chunk. A
+        // carriage return ending the chunk may have its line feed in the next one
+        if (end < _length) {
+            size_t last = frame.find_last_of(L"\r\n");
+            if (last != std::wstring::npos && last + 1 == frame.size() && frame[last] == L'\r' && last > 0) {
+                size_t before = frame.find_last_of(L"\r\n", last - 1);
+                if (before != std::wstring::npos) last = before;
+            }
+            if (last != std::wstring::npos) frame.resize(last + 1);
+        }
+
+        // Never stall on a source that returns nothing
+        if (frame.empty()) _position = _length;
+        else _position += frame.size();
+    }
+}
@@ -0,0 +1,152 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Command registry implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    commands::commands()
+        : _executor(NULL)
+    {
+    }
+
+    commands::~commands() {
+        stop();
+        for (std::map<std::wstring, command*>::iterator it = _commands.begin(); it != _commands.end(); ++it)
+            delete it->second;
+    }
+
+    void commands::add(const std::wstring& name, const handler& function, int concurrency) {
+        _lock.acquire();
+        command*& target = _commands[name];
+        if (!target) {
+            target = new command;
+            target->running = 0;
+        }
+        target->function = function;
+        target->limit = concurrency;
+        _lock.release();
+    }
+
+    bool commands::exists(const std::wstring& name) {
+        _lock.acquire();
+        bool found = _commands.find(name) != _commands.end();
+        _lock.release();
+        return found;
+    }
+
+    bool commands::empty() {
+        _lock.acquire();
+        bool none = _commands.empty();
+        _lock.release();
+        return none;
+    }
+
+    bool commands::dispatch(const std::wstring& line, const output& reply) {
+        invocation call;
+        tokenize(line, call.args);
+        if (call.args.empty()) return false;
+        call.reply = reply;
+
+        _lock.acquire();
+        std::map<std::wstring, command*>::iterator it = _commands.find(call.args[0]);
+        if (it == _commands.end()) {
+            _lock.release();
+            return false;
+        }
+
+        // Start the pool on first use
+        if (!_executor) _executor = new executor();
+
+        // Run now or wait for a free slot
+        command* target = it->second;
+        if (target->limit <= 0 || target->running < target->limit) {
+            target->running++;
+            _executor->submit([this, target, call]() { _run(target, call); });
+        } else target->waiting.push_back(call);
+
+        _lock.release();
+        return true;
+    }
+
+    void commands::stop() {
+        // Forget queued invocations and let running ones finish
+        _lock.acquire();
+        for (std::map<std::wstring, command*>::iterator it = _commands.begin(); it != _commands.end(); ++it)
+            it->second->waiting.clear();
+        executor* pool = _executor;
+        _executor = NULL;
+        _lock.release();
+        delete pool;
+    }
+
+    void commands::tokenize(const std::wstring& line, arguments& tokens) {
+        std::wstring token;
+        bool quoted = false, pending = false;
+
+        for (size_t i = 0; i < line.size(); i++) {
+            wchar_t c = line[i];
+            if (quoted) {
+                if (c == L'\\' && i + 1 < line.size() && line[i + 1] == L'"') token += line[++i];
+                else if (c == L'"') quoted = false;
+                else token += c;
+            } else if (c == L'"') {
+                quoted = pending = true;
+            } else if (iswspace(c)) {
+                if (pending) tokens.push_back(token);
+                token.clear();
+                pending = false;
+            } else {
+                token += c;
+                pending = true;
+            }
+        }
+
+        if (pending) tokens.push_back(token);
+    }
+
+    void commands::_run(command* target, const invocation& call) {
+        // Run the handler, reporting failures the same way as results
+        std::wstring result;
+        try {
+            result = target->function(call.args);
+        } catch (const std::exception& e) {
+            std::string what(e.what());
+            result.assign(call.args[0]).append(L": ").append(what.begin(), what.end()).append(L"\n");
+        } catch (...) {
+            // Whatever else was thrown must not take the worker down with it
+            result.assign(call.args[0]).append(L": failed\n");
+        }
+        if (!result.empty() && call.reply) call.reply(result);
+
+        // Hand the slot to the next waiting invocation
+        _lock.acquire();
+        target->running--;
+        if (!target->waiting.empty() && _executor) {
+            invocation next = target->waiting.front();
+            target->waiting.pop_front();
+            target->running++;
+            _executor->submit([this, target, next]() { _run(target, next); });
+        }
+        _lock.release();
+    }
+}
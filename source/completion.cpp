@@ -0,0 +1,159 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Completion implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Upper bound on candidates taken from the static index
+    static const size_t COMPLETION_LIMIT = 256;
+
+    completion::completion()
+        : _generation(0),
+          _pending_valid(false),
+          _pending_notify(NULL),
+          _pending_message(0),
+          _results_id(0),
+          _thread(NULL),
+          _event_request(NULL),
+          _quit(false)
+    {
+        _pending.generation = &_generation;
+    }
+
+    completion::~completion() {
+        // Stop the worker if it was started
+        if (_thread) {
+            _lock.acquire();
+            _quit = true;
+            _lock.release();
+            cancel();
+            SetEvent(_event_request);
+            WaitForSingleObject(_thread, INFINITE);
+            CloseHandle(_thread);
+        }
+
+        if (_event_request) CloseHandle(_event_request);
+    }
+
+    void completion::add(const std::wstring& word) {
+        _lock.acquire();
+        _words.insert(word, 1);
+        _lock.release();
+    }
+
+    void completion::remove(const std::wstring& word) {
+        _lock.acquire();
+        _words.erase(word);
+        _lock.release();
+    }
+
+    void completion::attach(provider* source) {
+        _lock.acquire();
+        _providers.push_back(source);
+
+        // The worker is only needed once there is something to run
+        if (!_thread) {
+            _event_request = CreateEvent(NULL, FALSE, FALSE, NULL);
+            _thread = CreateThread(NULL, 0, _callback_threadproc, this, 0, NULL);
+        }
+        _lock.release();
+        win_exception::check(_event_request);
+        win_exception::check(_thread);
+    }
+
+    void completion::lookup(const std::wstring& prefix, std::vector<std::wstring>& candidates) {
+        _lock.acquire();
+        _words.complete(prefix, candidates, COMPLETION_LIMIT);
+        _lock.release();
+    }
+
+    LONG completion::request(const std::wstring& prefix, HWND notify, UINT message) {
+        // Supersede whatever is still running
+        LONG id = _generation.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+        // Queue the request for the providers
+        _lock.acquire();
+        if (!_providers.empty()) {
+            _pending.prefix = prefix;
+            _pending.id = id;
+            _pending_valid = true;
+            _pending_notify = notify;
+            _pending_message = message;
+            SetEvent(_event_request);
+        } else id = 0;
+        _lock.release();
+        return id;
+    }
+
+    bool completion::results(LONG id, std::vector<std::wstring>& candidates) {
+        _lock.acquire();
+        bool result = (id != 0 && id == _results_id && id == _generation.load(std::memory_order_acquire));
+        if (result) {
+            candidates.insert(candidates.end(), _results.begin(), _results.end());
+            _results.clear();
+            _results_id = 0;
+        }
+        _lock.release();
+        return result;
+    }
+
+    void completion::cancel() {
+        _generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    DWORD completion::_callback_threadproc(void* pthis) {
+        completion* self = reinterpret_cast<completion*>(pthis);
+        self->_thread_run();
+        return 0;
+    }
+
+    void completion::_thread_run() {
+        for (;;) {
+            WaitForSingleObject(_event_request, INFINITE);
+
+            // Take the latest request
+            _lock.acquire();
+            if (_quit) { _lock.release(); break; }
+            if (!_pending_valid) { _lock.release(); continue; }
+            query request = _pending;
+            HWND notify = _pending_notify;
+            UINT message = _pending_message;
+            std::vector<provider*> providers(_providers);
+            _pending_valid = false;
+            _lock.release();
+
+            // Ask every provider, bailing out as soon as the request goes stale
+            std::vector<std::wstring> candidates;
+            for (size_t i = 0; i < providers.size() && !request.cancelled(); i++)
+                providers[i]->complete(request, candidates);
+            if (request.cancelled()) continue;
+
+            // Hand the results back to the requesting window
+            _lock.acquire();
+            _results.swap(candidates);
+            _results_id = request.id;
+            _lock.release();
+            PostMessage(notify, message, static_cast<WPARAM>(request.id), 0);
+        }
+    }
+}
@@ -26,6 +26,8 @@
 // Rich edit control
 //
 #include <richedit.h>
+#include <richole.h>
+#include <tom.h>
 #include "RichEditThemed.h"
 
 namespace db
@@ -33,45 +35,105 @@ namespace db
     // Constants
     enum {CONSOLE_IDC_OUTPUT = 101, 
           CONSOLE_IDC_INPUT = 102,
-          CONSOLE_MSG_QUIT = WM_USER};
+          CONSOLE_IDC_STATUS = 103,
+          CONSOLE_MSG_QUIT = WM_USER,
+          CONSOLE_MSG_COMPLETE,
+          CONSOLE_MSG_FILTER,
+          CONSOLE_MSG_DEDUPE,
+          CONSOLE_MSG_TIMESTAMPS,
+          CONSOLE_MSG_STATUS,
+          CONSOLE_MSG_SYNTAX,
+          CONSOLE_MSG_LEX,
+          CONSOLE_TIMER_STREAM = 1,
+          CONSOLE_TIMER_REFLOW,
+          CONSOLE_TIMER_STATUS,
+          CONSOLE_TIMER_FOLLOW,
+          CONSOLE_TIMER_LEX,
+          CONSOLE_TIMER_CATCHUP};
 
     // Defaults for the console
     static const wchar_t* CONSOLE_WINDOW_CLASS = L"db::console";
     static const wchar_t* CONSOLE_WINDOW_TITLE = L"Console";
+    static const size_t CONSOLE_HISTORY_SIZE = 100000;
+    static const LONG CONSOLE_INPUT_CHUNK = 64 * 1024;
+    static const UINT CONSOLE_STREAM_RETRY = 10;
+    static const size_t CONSOLE_SCROLLBACK_SIZE = 100000;
+    static const UINT CONSOLE_REFLOW_DELAY = 50;
+    static const size_t CONSOLE_REFLOW_BUDGET = 2000;
+    static const DWORD CONSOLE_STATUS_FRAME = 16;
+    static const UINT CONSOLE_FOLLOW_DELAY = 100;
+    static const size_t CONSOLE_FOLLOW_SCAN = 4096;
+    static const UINT CONSOLE_CATCHUP_DELAY = 10;
+    static const size_t CONSOLE_CATCHUP_SLICE = 2048;
+    static const size_t CONSOLE_LEX_BUDGET = 1024;
+    static const UINT CONSOLE_LEX_DELAY = 10;
 
     // Globals
     lock console::_ref_lock;
     int console::_ref_count = 0;
+    std::atomic<bool> console::_ref_initialized(false);
 
-    console::console(int buffers)
+    console::console(int buffers, reactor* shared, memory_resource* memory)
         : _event_initialized(NULL),
           _thread_console(NULL),
           _hwnd_console(NULL),
           _hwnd_console_input(NULL),
           _hwnd_console_output(NULL),
-          _mail_input(buffers),
-          _mail_output(buffers)
+          _hwnd_console_status(NULL),
+          _memory(memory ? memory : &_pool),
+          _input_log(buffers, _memory),
+          _input_subscribed(false),
+          _mail_output(buffers, _memory),
+          _reactor(shared),
+          _reactor_slot(0),
+          _ready(false),
+          _stream_chunker(CONSOLE_INPUT_CHUNK),
+          _stream_queued(false),
+          _stream_active(false),
+          _history(CONSOLE_HISTORY_SIZE),
+          _history_active(false),
+          _lex_commands(&_commands),
+          _lex_posted(false),
+          _scrollback(CONSOLE_SCROLLBACK_SIZE, _memory),
+          _layout(_scrollback),
+          _cell_width(8),
+          _cell_height(16),
+          _sizing(false),
+          _wrap_fixed(NULL),
+          _status_lines(0),
+          _status_drawn(0),
+          _status_waiting(false),
+          _timestamps(false),
+          _catchup(0),
+          _streamer(_scrollback, _highlighter)
     {
         // Acquire a reference
         _ref_acquire();
 
-        // Load the required libraries
-        LoadLibrary(_T("msftedit.dll"));
+        // Output counts as piling up relative to how much can be queued
+        _backlog.capacity(_mail_output.capacity());
 
         // Create initialization event
-        _event_initialized = CreateEvent(NULL, FALSE, FALSE, NULL);
+        _event_initialized = CreateEvent(NULL, TRUE, FALSE, NULL);
         win_exception::check(_event_initialized);
 
-        // Start the main thread
-        _thread_console = CreateThread(NULL, 0, _calback_threadproc, this, 0, NULL);
-        win_exception::check(_thread_console);
+        // Start the main thread or join the shared one
+        if (_reactor) _reactor_slot = _reactor->_attach(this);
+        else {
+            _thread_console = CreateThread(NULL, 0, _calback_threadproc, this, 0, NULL);
+            win_exception::check(_thread_console);
+        }
 
-        // Wait for initialization to complete
-        WaitForSingleObject(_event_initialized, INFINITE);
+        // Initialization completes in the background, anything done before
+        // then is buffered and applied once the window exists
     }
 
     console::~console() {
-        // First destroy the console window
+        // Let running commands finish while their output can still be written
+        _commands.stop();
+
+        // First destroy the console window, once it exists
+        WaitForSingleObject(_event_initialized, INFINITE);
         if (_hwnd_console) SendMessage(_hwnd_console, CONSOLE_MSG_QUIT, 0, 0);
 
         // Wait for the thread to complete if it exists
@@ -80,6 +142,10 @@ namespace db
             CloseHandle(_thread_console);
         }
 
+        // Anyone still reading or writing finds the console closed
+        _mail_output.close();
+        _input_log.close();
+
         // Cleanup remaining resources
         CloseHandle(_event_initialized);
 
@@ -88,6 +154,13 @@ namespace db
     }
 
     console& console::show(bool visible) {
+        _recorder.control(recorder::OPTION_Show, visible);
+        if (_pending_acquire()) {
+            _pending.visible = visible;
+            _pending_release();
+            return *this;
+        }
+
         ShowWindow(_hwnd_console, visible ? SW_SHOW : SW_HIDE);
         return *this;
     }
@@ -98,37 +171,249 @@ namespace db
     }
 
     console& console::title(const wchar_t* text) {
+        _recorder.control(recorder::OPTION_Title, 0, 0, text);
+        if (_pending_acquire()) {
+            _pending.title.assign(text);
+            _pending.has_title = true;
+            _pending_release();
+            return *this;
+        }
+
         SendMessage(_hwnd_console, WM_SETTEXT, 0, reinterpret_cast<LPARAM>(text));
         return *this;
     }
 
     console& console::icon(HICON handle) {
+        if (_pending_acquire()) {
+            _pending.icon = handle;
+            _pending.has_icon = true;
+            _pending_release();
+            return *this;
+        }
+
         SendMessage(_hwnd_console, WM_SETICON, ICON_SMALL, reinterpret_cast<LPARAM>(handle));
         SendMessage(_hwnd_console, WM_SETICON, ICON_BIG, reinterpret_cast<LPARAM>(handle));
         return *this;
     }
 
     console& console::background(rgb colour) {
+        _recorder.control(recorder::OPTION_Background, RGB(colour.red, colour.green, colour.blue));
+        if (_pending_acquire()) {
+            _pending.background = RGB(colour.red, colour.green, colour.blue);
+            _pending.has_background = true;
+            _pending_release();
+            return *this;
+        }
+
         SendMessage(_hwnd_console_output, EM_SETBKGNDCOLOR, 0, RGB(colour.red, colour.green, colour.blue));
+        SendMessage(_hwnd_console_status, EM_SETBKGNDCOLOR, 0, RGB(colour.red, colour.green, colour.blue));
         SendMessage(_hwnd_console_input, EM_SETBKGNDCOLOR, 0, RGB(colour.red, colour.green, colour.blue));
         return *this;
     }
 
     console& console::resize(int width, int height) {
+        _recorder.control(recorder::OPTION_Resize, width, height);
+        if (_pending_acquire()) {
+            _pending.width = width;
+            _pending.height = height;
+            _pending.has_size = true;
+            _pending_release();
+            return *this;
+        }
+
         SetWindowPos(_hwnd_console, NULL, 0, 0, width, height, SWP_NOMOVE | SWP_NOACTIVATE);
         return *this;
     }
 
+    console& console::history(const wchar_t* path) {
+        _history.open(path);
+        return *this;
+    }
+
+    console& console::completion(const std::wstring& word) {
+        _completion.add(word);
+        return *this;
+    }
+
+    console& console::completion(db::completion::provider* source) {
+        _completion.attach(source);
+        return *this;
+    }
+
+    console& console::command(const std::wstring& name, const commands::handler& function, int concurrency) {
+        _commands.add(name, function, concurrency);
+        return *this;
+    }
+
+    int console::category(const std::wstring& name) {
+        _recorder.control(recorder::OPTION_Category, 0, 0, name);
+        return _scrollback.category(name);
+    }
+
+    console& console::filter(const db::scrollback::filter& which) {
+        _recorder.control(recorder::OPTION_Filter, which.levels, which.categories);
+        _pending_lock.acquire();
+        _filter_next = which;
+        bool ready = _ready.load(std::memory_order_relaxed);
+        _pending_lock.release();
+
+        // The UI thread rebuilds the output, before then the filter just waits
+        if (ready) PostMessage(_hwnd_console, CONSOLE_MSG_FILTER, 0, 0);
+        return *this;
+    }
+
+    console& console::dedupe(size_t window) {
+        _recorder.control(recorder::OPTION_Dedupe, window);
+        if (_pending_acquire()) {
+            _pending.dedupe = window;
+            _pending.has_dedupe = true;
+            _pending_release();
+            return *this;
+        }
+
+        SendMessage(_hwnd_console, CONSOLE_MSG_DEDUPE, window, 0);
+        return *this;
+    }
+
+    console& console::timestamps(bool visible) {
+        _recorder.control(recorder::OPTION_Timestamps, visible);
+        if (_pending_acquire()) {
+            _pending.timestamps = visible;
+            _pending_release();
+            return *this;
+        }
+
+        SendMessage(_hwnd_console, CONSOLE_MSG_TIMESTAMPS, visible, 0);
+        return *this;
+    }
+
+    console& console::syntax(db::tokenizer* rules) {
+        if (_pending_acquire()) {
+            _pending.syntax = rules;
+            _pending.has_syntax = true;
+            _pending_release();
+            return *this;
+        }
+
+        SendMessage(_hwnd_console, CONSOLE_MSG_SYNTAX, 0, reinterpret_cast<LPARAM>(rules));
+        return *this;
+    }
+
+    db::latency::summary console::latency() {
+        return _latency.snapshot();
+    }
+
+    console& console::stalls(double threshold) {
+        _watchdog.threshold(threshold);
+        return *this;
+    }
+
+    db::watchdog::summary console::stalls() {
+        return _watchdog.snapshot();
+    }
+
+    console& console::highlight(const std::wstring& pattern, rgb colour, highlighter::scope extent, bool bold) {
+        _recorder.control(recorder::OPTION_Highlight, RGB(colour.red, colour.green, colour.blue), extent | (bold ? 0x100 : 0), pattern);
+        _highlighter.add(pattern, highlighter::style(RGB(colour.red, colour.green, colour.blue), bold), extent);
+        return *this;
+    }
+
+    console& console::export_to(const wchar_t* path, exporter::format kind) {
+        // Stamps are written when they are shown, or will be once the window exists
+        bool stamps = _timestamps;
+        if (_pending_acquire()) {
+            stamps = _pending.timestamps;
+            _pending_release();
+        }
+        _exporter.write(_scrollback.take(), path, kind, stamps);
+        return *this;
+    }
+
+    console& console::serve(const wchar_t* path) {
+        _streamer.listen(path);
+        return *this;
+    }
+
+    console& console::record(const wchar_t* path) {
+        if (path) _recorder.open(path);
+        else _recorder.close();
+        return *this;
+    }
+
+    db::scrollback& console::scrollback() {
+        return _scrollback;
+    }
+
+    db::status_line console::status_line() {
+        // A new line shows up empty until it is first updated
+        unsigned generation = 0;
+        size_t slot = _status.open(generation);
+        _status_update(slot, generation, std::wstring());
+        return db::status_line(this, slot, generation);
+    }
+
     bool console::visible() {
-        return IsWindowVisible(_hwnd_console);
+        if (_pending_acquire()) {
+            bool result = _pending.visible;
+            _pending_release();
+            return result;
+        }
+
+        return IsWindowVisible(_hwnd_console) != FALSE;
     }
 
     bool console::write(const std::wstring& richtext, unsigned long timeout) {
-        return _mail_output.send(richtext, timeout);
+        return write(richtext, timeout, db::scrollback::LEVEL_Info);
+    }
+
+    bool console::write(const std::wstring& richtext, unsigned long timeout, db::scrollback::level level, int category) {
+        return static_cast<bool>(try_write(richtext, timeout, level, category));
     }
 
     bool console::read(std::wstring& buffer, unsigned long timeout) {
-        return _mail_input.recv(buffer, timeout);
+        return static_cast<bool>(try_read(buffer, timeout));
+    }
+
+    bool console::input(const std::wstring& text, unsigned long timeout) {
+        return static_cast<bool>(try_input(text, timeout));
+    }
+
+    result console::try_write(const std::wstring& richtext, unsigned long timeout, db::scrollback::level level, int category) {
+        _recorder.write(richtext, timeout, level, category);
+        return _output(richtext, timeout, level, category);
+    }
+
+    result console::_output(const std::wstring& richtext, unsigned long timeout, db::scrollback::level level, int category) {
+        // Not recorded, command output comes back when a replay dispatches the input again
+        mail::header info;
+        info.level = static_cast<unsigned char>(level);
+        info.category = static_cast<unsigned char>(category);
+        info.tick = timestamp::now();
+        result sent = _mail_output.put(richtext, info, timeout);
+        if (sent && _reactor) _reactor->_signal(this, _reactor_slot);
+        return sent;
+    }
+
+    result console::try_read(std::wstring& buffer, unsigned long timeout) {
+        // Subscribed on first use, so consoles only read through subscriptions never fill up
+        if (!_input_subscribed) {
+            _input_lock.acquire();
+            result subscribed = _input_reader.valid() ? result() : result::capture([this]() { _input_reader = _input_log.subscribe(); });
+            _input_lock.release();
+            if (!subscribed) return subscribed;
+            _input_subscribed = true;
+        }
+        return _input_reader.read(buffer, timeout);
+    }
+
+    result console::try_input(const std::wstring& text, unsigned long timeout) {
+        _recorder.input(text);
+        if (_commands.dispatch(text, [this](const std::wstring& output) { _output(output, INFINITE, db::scrollback::LEVEL_Info, 0); })) return result();
+        return _input_log.publish(text, broadcast::ROUTE_Injected, timeout);
+    }
+
+    db::subscription console::subscribe(const std::wstring& prefix, unsigned routes) {
+        return _input_log.subscribe(prefix, routes);
     }
 
     bool console::_thread_initialize() {
@@ -136,6 +421,9 @@ namespace db
         // Create the main terminal window
         //
 
+        // Make sure the window class exists
+        _ref_initialize();
+
         // Fetch the current instance
         HINSTANCE hinstance = _get_instance();
 
@@ -173,6 +461,17 @@ namespace db
             NULL                                          // Additional application data
             );
 
+        // Create the status edit box, empty until a status line is opened
+        _hwnd_console_status = CreateWindowEx(0, MSFTEDIT_CLASS, _T(""),
+            WS_CHILD | WS_VISIBLE | WS_BORDER |           // Style
+            ES_MULTILINE | ES_READONLY,                   // ...
+            0, 0, 0, 0,                                   // Geometry
+            _hwnd_console,                                // Parent window
+            reinterpret_cast<HMENU>(CONSOLE_IDC_STATUS),  // Control ID
+            hinstance,                                    // Parent instance
+            NULL                                          // Additional application data
+            );
+
         // Create the input edit box
         _hwnd_console_input = CreateWindowEx(0, MSFTEDIT_CLASS, _T(""),
             WS_CHILD | WS_VISIBLE | WS_BORDER |           // Style
@@ -185,6 +484,7 @@ namespace db
             );
 
         // Set initial size
+        _thread_measure();
         RECT rect; GetWindowRect(_hwnd_console, &rect);
         _thread_resize(rect.right - rect.left, rect.bottom - rect.top);
 
@@ -193,15 +493,44 @@ namespace db
 
         // Configure input
         SendMessage(_hwnd_console_input, EM_SETEVENTMASK, 0, ENM_KEYEVENTS | ENM_MOUSEEVENTS);
-        SendMessage(_hwnd_console_input, EM_SETTEXTMODE, TM_PLAINTEXT, 0);
+        SendMessage(_hwnd_console_input, EM_SETTEXTMODE, TM_RICHTEXT, 0);
 
         // Apply theme to edit controls
         CRichEditThemed::Attach(_hwnd_console_output);
+        CRichEditThemed::Attach(_hwnd_console_status);
         CRichEditThemed::Attach(_hwnd_console_input);
 
+        // Apply whatever was asked for while the window did not exist yet
+        _pending_lock.acquire();
+        if (_pending.has_title) SendMessage(_hwnd_console, WM_SETTEXT, 0, reinterpret_cast<LPARAM>(_pending.title.c_str()));
+        if (_pending.has_icon) {
+            SendMessage(_hwnd_console, WM_SETICON, ICON_SMALL, reinterpret_cast<LPARAM>(_pending.icon));
+            SendMessage(_hwnd_console, WM_SETICON, ICON_BIG, reinterpret_cast<LPARAM>(_pending.icon));
+        }
+        if (_pending.has_background) {
+            SendMessage(_hwnd_console_output, EM_SETBKGNDCOLOR, 0, _pending.background);
+            SendMessage(_hwnd_console_status, EM_SETBKGNDCOLOR, 0, _pending.background);
+            SendMessage(_hwnd_console_input, EM_SETBKGNDCOLOR, 0, _pending.background);
+        }
+        if (_pending.has_size)
+            SetWindowPos(_hwnd_console, NULL, 0, 0, _pending.width, _pending.height, SWP_NOMOVE | SWP_NOACTIVATE);
+        if (_pending.has_dedupe) _dedupe.window(_pending.dedupe);
+        _lexer.rules(_pending.has_syntax ? _pending.syntax : &_lex_commands);
+        _timestamps = _pending.timestamps;
+        if (_pending.visible) ShowWindow(_hwnd_console, SW_SHOW);
+        _filter = _filter_next;
+        _ready.store(true, std::memory_order_release);
+        _pending_lock.release();
+
+        // Show status lines opened in the meantime
+        _thread_status(true);
+
         // Set initialization event
         SetEvent(_event_initialized);
 
+        // Output written in the meantime is already queued, make sure it gets a turn
+        if (_reactor) _reactor->_signal(this, _reactor_slot);
+
         // Successful initialization
         return TRUE;
     }
@@ -209,12 +538,16 @@ namespace db
     bool console::_thread_messagepump() {
         mail::message msg; for (;;) {
             if (_mail_output.recv(msg, INFINITE)) {
+                _watchdog.enter();
                 switch (msg.type) {
                 case mail::type::MESSAGE_Mail:
-                    _thread_handler_mail(msg.mail); break;
+                    _thread_handler_mail(msg.mail, msg.info);
+                    _watchdog.leave(watchdog::SOURCE_Mail, 0, msg.mail.size());
+                    break;
                 case mail::type::MESSAGE_Windows:
                     TranslateMessage(&msg.windows);
                     DispatchMessage(&msg.windows);
+                    _watchdog.leave(watchdog::SOURCE_Windows, msg.windows.message, 0);
                     break; // Continue to next message
                 case mail::type::MESSAGE_Quit:
                     return TRUE;
@@ -223,16 +556,263 @@ namespace db
         }
     }
 
-    void console::_thread_handler_mail(mail::string &mail) {
+    bool console::_thread_drain(int quantum) {
+        // Handle up to a quantum of output, report whether more may be waiting
+        if (!_ready.load(std::memory_order_acquire)) return false;
+        mail::string buffer;
+        mail::header info;
+        for (int i = 0; i < quantum; i++) {
+            if (!_mail_output.recv(buffer, info, 0)) return false;
+            _watchdog.enter();
+            _thread_handler_mail(buffer, info);
+            _watchdog.leave(watchdog::SOURCE_Mail, 0, buffer.size());
+        }
+        return true;
+    }
+
+    void console::_thread_handler_mail(mail::string& mail, const mail::header& info) {
+        if (info.tick) _latency.record(timestamp::now() - info.tick);
+
+        // Under a sustained backlog lines are only stored and the screen follows the tail
+        bool behind = _backlog.behind();
+        if (_backlog.handled(_mail_output.waiting(), timestamp::now()) != behind) _thread_follow(!behind);
+
+        // Repeats only bump the counter of the message already written
+        bool repeated = false;
+        db::dedupe::entry* tracked = _dedupe.track(mail, info.level, info.category, repeated);
+        if (repeated) {
+            _scrollback.repeat(tracked->line);
+            if (tracked->marker >= 0) _thread_repeat(*tracked);
+            _streamer.repeat(tracked->line, tracked->count);
+            return;
+        }
+
+        // Everything is kept, only what passes the filter is shown
+        size_t line = _scrollback.append(mail, info.level, info.category, info.tick);
+        _streamer.publish(line);
+        bool shown = _filter.matches(info.level, info.category) && !_backlog.behind();
+        timestamp::tick begin = timestamp::now();
+        if (shown && _timestamps) {
+            mail::string stamped(mail);
+            _thread_stamp(stamped, info.tick);
+            _thread_append(stamped);
+        } else if (shown) _thread_append(mail);
+        if (shown) _backlog.rendered(timestamp::now() - begin);
+        if (tracked) {
+            tracked->line = line;
+            if (shown) tracked->marker = _thread_marker();
+        }
+    }
+
+    LONG console::_thread_marker() {
+        // Counters go in front of the line break ending the message
+        CHARRANGE range = { -1, -1 };
+        SendMessage(_hwnd_console_output, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&range));
+        SendMessage(_hwnd_console_output, EM_EXGETSEL, 0, reinterpret_cast<LPARAM>(&range));
+        if (range.cpMax <= 0) return 0;
+
+        wchar_t last[2] = { 0 };
+        TEXTRANGE fetch;
+        fetch.chrg.cpMin = range.cpMax - 1;
+        fetch.chrg.cpMax = range.cpMax;
+        fetch.lpstrText = last;
+        SendMessage(_hwnd_console_output, EM_GETTEXTRANGE, 0, reinterpret_cast<LPARAM>(&fetch));
+        return (last[0] == L'\r' || last[0] == L'\n') ? range.cpMax - 1 : range.cpMax;
+    }
+
+    void console::_thread_repeat(db::dedupe::entry& tracked) {
+        // Replace the counter in place, without scrolling
+        std::wstring label = db::dedupe::label(tracked.count);
         SETTEXTEX SetText;
         SetText.codepage = CP_WINUNICODE;
         SetText.flags = ST_SELECTION;
-        CHARRANGE Range = { -1, -1 };
+        CHARRANGE Range = { tracked.marker, tracked.marker + tracked.length };
         SendMessage(_hwnd_console_output, EM_HIDESELECTION, TRUE, 0);
         SendMessage(_hwnd_console_output, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&Range));
-        SendMessage(_hwnd_console_output, EM_SETTEXTEX, reinterpret_cast<WPARAM>(&SetText), reinterpret_cast<LPARAM>(mail.data()));
+        SendMessage(_hwnd_console_output, EM_SETTEXTEX, reinterpret_cast<WPARAM>(&SetText), reinterpret_cast<LPARAM>(label.c_str()));
+        SendMessage(_hwnd_console_output, EM_HIDESELECTION, FALSE, 0);
+
+        // Counters shown further down moved along
+        LONG delta = static_cast<LONG>(label.size()) - tracked.length;
+        tracked.length = static_cast<LONG>(label.size());
+        if (delta) _dedupe.shift(tracked.marker, delta);
+    }
+
+    void console::_thread_append(const mail::string& mail) {
+        _thread_place(mail, -1);
         SendMessage(_hwnd_console_output, WM_VSCROLL, SB_BOTTOM, 0);
+    }
+
+    LONG console::_thread_place(const mail::string& mail, LONG at) {
+        // Rich text brings its own styling, plain text goes through the rules
+        std::vector<highlighter::run> runs;
+        if (mail.compare(0, 5, L"{\\rtf") != 0) _highlighter.apply(mail, runs);
+
+        // Only text going in ahead of other text needs its length measured
+        GETTEXTLENGTHEX Length = { GTL_NUMCHARS, CP_WINUNICODE };
+        LONG before = (at >= 0) ? static_cast<LONG>(SendMessage(_hwnd_console_output, EM_GETTEXTLENGTHEX, reinterpret_cast<WPARAM>(&Length), 0)) : 0;
+
+        SETTEXTEX SetText;
+        SetText.codepage = CP_WINUNICODE;
+        SetText.flags = ST_SELECTION;
+        CHARRANGE Range = { at, at };
+        SendMessage(_hwnd_console_output, EM_HIDESELECTION, TRUE, 0);
+        SendMessage(_hwnd_console_output, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&Range));
+        SendMessage(_hwnd_console_output, EM_EXGETSEL, 0, reinterpret_cast<LPARAM>(&Range));
+        SendMessage(_hwnd_console_output, EM_SETTEXTEX, reinterpret_cast<WPARAM>(&SetText), reinterpret_cast<LPARAM>(mail.data()));
+        if (!runs.empty()) _thread_highlight(mail, Range.cpMin, runs);
         SendMessage(_hwnd_console_output, EM_HIDESELECTION, FALSE, 0);
+        if (at < 0) return 0;
+        return static_cast<LONG>(SendMessage(_hwnd_console_output, EM_GETTEXTLENGTHEX, reinterpret_cast<WPARAM>(&Length), 0)) - before;
+    }
+
+    void console::_thread_stamp(mail::string& text, timestamp::tick stamp) {
+        // Stamps are only turned into text when shown, rich text is left alone
+        if (!_timestamps || !stamp || text.compare(0, 5, L"{\\rtf") == 0) return;
+        text.insert(0, L"[" + timestamp::text(stamp) + L"] ");
+    }
+
+    void console::_thread_highlight(const mail::string& text, LONG start, const std::vector<highlighter::run>& runs) {
+        CHARFORMAT2 format;
+        memset(&format, 0, sizeof(format));
+        format.cbSize = sizeof(format);
+        format.dwMask = CFM_COLOR | CFM_BOLD;
+
+        // The control keeps line breaks as a single character, drop the line feeds
+        size_t scanned = 0;
+        LONG dropped = 0;
+        auto position = [&](size_t offset) -> LONG {
+            for (; scanned < offset; scanned++)
+                if (text[scanned] == L'\n' && scanned > 0 && text[scanned - 1] == L'\r') dropped++;
+            return start + static_cast<LONG>(offset) - dropped;
+        };
+
+        for (size_t i = 0; i < runs.size(); i++) {
+            CHARRANGE range;
+            range.cpMin = position(runs[i].start);
+            range.cpMax = position(runs[i].start + runs[i].length);
+            const style& look = style_table::lookup(runs[i].format);
+            format.crTextColor = look.colour;
+            format.dwEffects = look.bold ? CFE_BOLD : 0;
+            SendMessage(_hwnd_console_output, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&range));
+            SendMessage(_hwnd_console_output, EM_SETCHARFORMAT, SCF_SELECTION, reinterpret_cast<LPARAM>(&format));
+        }
+
+        // Whatever is written next starts out plain again
+        CHARRANGE range = { -1, -1 };
+        format.dwEffects = CFE_AUTOCOLOR;
+        SendMessage(_hwnd_console_output, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&range));
+        SendMessage(_hwnd_console_output, EM_SETCHARFORMAT, SCF_SELECTION, reinterpret_cast<LPARAM>(&format));
+    }
+
+    void console::_thread_refilter() {
+        // Pick up the latest filter
+        _pending_lock.acquire();
+        _filter = _filter_next;
+        _pending_lock.release();
+
+        // Counter positions are about to become meaningless
+        _dedupe.clear();
+
+        // Collect the matching lines straight from the scrollback index
+        db::scrollback::snapshot contents = _scrollback.take();
+        std::vector<size_t> matching;
+        contents.select(_filter, contents.first(), matching);
+        _thread_rebuild(contents, matching);
+    }
+
+    void console::_thread_rebuild(const db::scrollback::snapshot& contents, const std::vector<size_t>& matching) {
+        // Whatever was still being caught up on is replaced
+        KillTimer(_hwnd_console, CONSOLE_TIMER_CATCHUP);
+
+        // Rebuild the output without repainting every line
+        SendMessage(_hwnd_console_output, WM_SETREDRAW, FALSE, 0);
+        SendMessage(_hwnd_console_output, WM_SETTEXT, 0, reinterpret_cast<LPARAM>(L""));
+        _thread_insert(contents, matching, -1);
+        SendMessage(_hwnd_console_output, WM_SETREDRAW, TRUE, 0);
+        InvalidateRect(_hwnd_console_output, NULL, TRUE);
+        SendMessage(_hwnd_console_output, WM_VSCROLL, SB_BOTTOM, 0);
+    }
+
+    LONG console::_thread_insert(const db::scrollback::snapshot& contents, const std::vector<size_t>& matching, LONG at) {
+        // Text placed ahead of other text moves the position along
+        LONG inserted = 0;
+        auto place = [&](const mail::string& piece) {
+            LONG length = _thread_place(piece, at);
+            if (at >= 0) at += length;
+            inserted += length;
+        };
+
+        mail::string batch, text;
+        for (size_t i = 0; i < matching.size(); i++) {
+            const db::scrollback::line& entry = contents.at(matching[i]);
+            text.assign(entry.text.begin(), entry.text.end());
+
+            // Plain text is inserted in one go, rich text has to go in on its own
+            if (text.compare(0, 5, L"{\\rtf") != 0) {
+                if (entry.repeats > 1) {
+                    size_t end = text.find_last_not_of(L"\r\n") + 1;
+                    text.insert(end, db::dedupe::label(entry.repeats));
+                }
+                _thread_stamp(text, entry.stamp);
+                batch.append(text);
+                continue;
+            }
+            if (!batch.empty()) { place(batch); batch.clear(); }
+            place(text);
+        }
+        if (!batch.empty()) place(batch);
+        return inserted;
+    }
+
+    void console::_thread_follow(bool behind) {
+        if (behind) {
+            // Show only the newest lines, refreshed on a timer, until output slows down
+            SetTimer(_hwnd_console, CONSOLE_TIMER_FOLLOW, CONSOLE_FOLLOW_DELAY, NULL);
+            _thread_tail();
+        } else {
+            // Caught up, the screen is right at once and older lines follow a slice at a time
+            KillTimer(_hwnd_console, CONSOLE_TIMER_FOLLOW);
+            _catchup = _thread_tail();
+            SetTimer(_hwnd_console, CONSOLE_TIMER_CATCHUP, CONSOLE_CATCHUP_DELAY, NULL);
+        }
+    }
+
+    void console::_thread_catchup() {
+        // The newest slice not shown yet goes in above everything shown
+        db::scrollback::snapshot contents = _scrollback.take();
+        size_t until = (std::max)(_catchup, contents.first());
+        size_t from = until - (std::min)(until - contents.first(), CONSOLE_CATCHUP_SLICE);
+        std::vector<size_t> matching;
+        contents.select(_filter, from, matching, until);
+        _catchup = from;
+        if (from == contents.first()) KillTimer(_hwnd_console, CONSOLE_TIMER_CATCHUP);
+        if (matching.empty()) return;
+
+        // Counters shown further down moved by what went in
+        SendMessage(_hwnd_console_output, WM_SETREDRAW, FALSE, 0);
+        LONG inserted = _thread_insert(contents, matching, 0);
+        _dedupe.shift(-1, inserted);
+        SendMessage(_hwnd_console_output, WM_SETREDRAW, TRUE, 0);
+        InvalidateRect(_hwnd_console_output, NULL, TRUE);
+        SendMessage(_hwnd_console_output, WM_VSCROLL, SB_BOTTOM, 0);
+    }
+
+    size_t console::_thread_tail() {
+        // Counter positions are about to become meaningless
+        _dedupe.clear();
+
+        // A screenful of the newest matching lines, looking only at recent ones
+        db::scrollback::snapshot contents = _scrollback.take();
+        size_t from = contents.end() - (std::min)(contents.end() - contents.first(), CONSOLE_FOLLOW_SCAN);
+        std::vector<size_t> matching;
+        contents.select(_filter, from, matching);
+
+        // Long lines wrap, so the screen is filled by rows rather than lines
+        size_t shown = _layout.fit(matching, _thread_rows());
+        matching.erase(matching.begin(), matching.end() - shown);
+        _thread_rebuild(contents, matching);
+        return matching.empty() ? contents.end() : matching.front();
     }
 
     LRESULT console::_thread_handler_message(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
@@ -242,7 +822,16 @@ namespace db
 
         switch (uMsg) {
         case WM_SIZE:
+            // While the edge is dragged the output keeps wrapping at the old width
+            if (_sizing && !_wrap_fixed) _thread_wrap(true);
             _thread_resize(LOWORD(lParam), HIWORD(lParam)); break;
+        case WM_ENTERSIZEMOVE:
+            _sizing = true;
+            break;
+        case WM_EXITSIZEMOVE:
+            _sizing = false;
+            if (_wrap_fixed) _thread_wrap(false);
+            break;
         case WM_GETMINMAXINFO:
             minmax = reinterpret_cast<LPMINMAXINFO>(lParam);
             minmax->ptMinTrackSize.x = 400;
@@ -264,8 +853,43 @@ namespace db
         case CONSOLE_MSG_QUIT:
             DestroyWindow(_hwnd_console);
             break;
+        case CONSOLE_MSG_COMPLETE:
+            _thread_complete_results(static_cast<LONG>(wParam));
+            break;
+        case CONSOLE_MSG_FILTER:
+            _thread_refilter();
+            break;
+        case CONSOLE_MSG_DEDUPE:
+            _dedupe.window(static_cast<size_t>(wParam));
+            break;
+        case CONSOLE_MSG_TIMESTAMPS:
+            _timestamps = (wParam != 0);
+            _thread_refilter();
+            break;
+        case CONSOLE_MSG_STATUS:
+            _thread_status(false);
+            break;
+        case CONSOLE_MSG_SYNTAX:
+            _thread_syntax(reinterpret_cast<db::tokenizer*>(lParam));
+            break;
+        case CONSOLE_MSG_LEX:
+            _thread_lex();
+            break;
+        case WM_TIMER:
+            if (wParam == CONSOLE_TIMER_STREAM) _thread_stream_pump();
+            else if (wParam == CONSOLE_TIMER_REFLOW && !_layout.step(CONSOLE_REFLOW_BUDGET))
+                KillTimer(_hwnd_console, CONSOLE_TIMER_REFLOW);
+            else if (wParam == CONSOLE_TIMER_STATUS) _thread_status(true);
+            else if (wParam == CONSOLE_TIMER_LEX) _thread_lex();
+            else if (wParam == CONSOLE_TIMER_CATCHUP) _thread_catchup();
+            else if (wParam == CONSOLE_TIMER_FOLLOW) {
+                if (_backlog.check(_mail_output.waiting(), timestamp::now())) _thread_tail();
+                else _thread_follow(false);
+            }
+            break;
         case WM_DESTROY:
-            PostQuitMessage(0);
+            if (_reactor) _reactor->_detach(this, _reactor_slot);
+            else PostQuitMessage(0);
             break;
 
         default:
@@ -278,53 +902,446 @@ namespace db
 
     LRESULT console::_thread_handler_input(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
         // Check for send request
-        bool send_message = false;
+        bool send_message = false, paste = false;
         switch (uMsg) {
         case WM_KEYDOWN:
+            // Keys are ignored while a previous input is still being handed over
+            if (_stream_active) return 1;
+            if (wParam == VK_CONTROL || wParam == VK_SHIFT || wParam == VK_MENU) break;
+
+            // Any other key makes running completions stale
+            if (wParam != VK_TAB) _completion.cancel();
+
             if (wParam == VK_RETURN)
                 send_message = (GetKeyState(VK_CONTROL) >= 0) &&
                                (GetKeyState(VK_SHIFT)   >= 0);
+            else if (wParam == VK_TAB)
+                return _thread_complete();
+            else if (wParam == VK_UP || wParam == VK_DOWN)
+                return _thread_history_recall(wParam == VK_UP);
+            else if (wParam == 'R' && GetKeyState(VK_CONTROL) < 0)
+                return _thread_history_search();
+            else {
+                paste = (wParam == 'V' && GetKeyState(VK_CONTROL) < 0) ||
+                        (wParam == VK_INSERT && GetKeyState(VK_SHIFT) < 0);
+                _thread_history_reset();
+            }
+            break;
+        case WM_CHAR:
+            // Tabs are consumed by completion
+            if (wParam == '\t') return 1;
             break;
         }
 
         // Deal with send request
         if (send_message) {
-            // Get input text length
+            // Measure the input
             GETTEXTLENGTHEX length_spec;
             length_spec.codepage = CP_WINUNICODE;
-            length_spec.flags = GTL_DEFAULT;
+            length_spec.flags = GTL_NUMCHARS | GTL_PRECISE;
             LRESULT length = SendMessage(_hwnd_console_input, EM_GETTEXTLENGTHEX, reinterpret_cast<WPARAM>(&length_spec), 0);
-            if (length == E_INVALIDARG) return 0;
-            length += 1; // Add 1 for the null terminator
-
-            // Prepare a buffer and fill it with the text & send the text
-            mail::string buffer;
-            buffer.resize(length);
-            GETTEXTEX fetch_spec = { 0 };
-            fetch_spec.cb = length * sizeof(TCHAR);
-            fetch_spec.codepage = CP_WINUNICODE;
-            fetch_spec.flags = GT_DEFAULT;
-            SendMessage(_hwnd_console_input, EM_GETTEXTEX, reinterpret_cast<WPARAM>(&fetch_spec), reinterpret_cast<LPARAM>(buffer.data()));
-            _mail_input.send(buffer, INFINITE);
-
-            // Clear existing text
-            CHARRANGE range = { 0, -1 };
-            SendMessage(_hwnd_console_input, EM_HIDESELECTION, TRUE, 0);
-            SendMessage(_hwnd_console_input, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&range));
-            SendMessage(_hwnd_console_input, WM_CLEAR, 0, 0);
-            SendMessage(_hwnd_console_input, EM_HIDESELECTION, FALSE, 0);
+            if (length == E_INVALIDARG) return 1;
+
+            _stream_chunker.start(0);
+            if (length <= CONSOLE_INPUT_CHUNK) {
+                // Small inputs go out whole and may be history or commands
+                _thread_input_get(_stream_pending);
+                _recorder.input(_stream_pending);
+                _stream_queued = !_commands.dispatch(_stream_pending, [this](const std::wstring& output) { _output(output, INFINITE, db::scrollback::LEVEL_Info, 0); });
+                _history.add(_stream_pending);
+                _thread_history_reset();
+            } else {
+                // Large inputs are pulled out of the control a chunk at a time
+                _stream_chunker.start(static_cast<size_t>(length));
+                _stream_queued = false;
+            }
+
+            // Hand the input over without blocking, the control is locked until done
+            _stream_active = true;
+            SendMessage(_hwnd_console_input, EM_SETREADONLY, TRUE, 0);
+            _thread_stream_pump();
 
             // The input was handled
             return 1;
         }
 
+        // Pasted text comes in plain, all formatting is the highlighting's
+        if (paste) SendMessage(_hwnd_console_input, EM_PASTESPECIAL, CF_UNICODETEXT, 0);
+
+        // Highlight once the control has taken the key
+        if ((uMsg == WM_KEYDOWN || uMsg == WM_CHAR || uMsg == WM_LBUTTONUP) && !_lex_posted) {
+            _lex_posted = true;
+            PostMessage(_hwnd_console, CONSOLE_MSG_LEX, 0, 0);
+        }
+
         // Pass event on to control
-        return 0;
+        return paste ? 1 : 0;
+    }
+
+    void console::_thread_stream_pump() {
+        for (;;) {
+            // Pull the next frame once the previous one is out
+            if (!_stream_queued) {
+                if (_stream_chunker.done()) break;
+                _thread_stream_fetch(_stream_pending);
+                _stream_queued = true;
+            }
+
+            // Readers are behind, try again shortly
+            if (!_input_log.publish(_stream_pending, broadcast::ROUTE_Typed, 0)) {
+                SetTimer(_hwnd_console, CONSOLE_TIMER_STREAM, CONSOLE_STREAM_RETRY, NULL);
+                return;
+            }
+            _stream_queued = false;
+        }
+
+        // Everything was handed over
+        KillTimer(_hwnd_console, CONSOLE_TIMER_STREAM);
+        _stream_pending.clear();
+        _stream_active = false;
+        SendMessage(_hwnd_console_input, EM_SETREADONLY, FALSE, 0);
+
+        // Clear existing text
+        CHARRANGE range = { 0, -1 };
+        SendMessage(_hwnd_console_input, EM_HIDESELECTION, TRUE, 0);
+        SendMessage(_hwnd_console_input, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&range));
+        SendMessage(_hwnd_console_input, WM_CLEAR, 0, 0);
+        SendMessage(_hwnd_console_input, EM_HIDESELECTION, FALSE, 0);
+        _thread_lex();
+    }
+
+    void console::_thread_stream_fetch(mail::string& chunk) {
+        // Copy the next chunk straight out of the control
+        _stream_chunker.next([this](size_t from, size_t to, std::wstring& text) {
+            text.resize(to - from + 1);
+            TEXTRANGE range;
+            range.chrg.cpMin = static_cast<LONG>(from);
+            range.chrg.cpMax = static_cast<LONG>(to);
+            range.lpstrText = &text[0];
+            text.resize(SendMessage(_hwnd_console_input, EM_GETTEXTRANGE, 0, reinterpret_cast<LPARAM>(&range)));
+        }, chunk);
+        _recorder.input(chunk);
+    }
+
+    LRESULT console::_thread_history_recall(bool older) {
+        // Only take over the arrow keys on the outer lines of the input
+        CHARRANGE selection;
+        SendMessage(_hwnd_console_input, EM_EXGETSEL, 0, reinterpret_cast<LPARAM>(&selection));
+        LRESULT line = SendMessage(_hwnd_console_input, EM_EXLINEFROMCHAR, 0, selection.cpMin);
+        LRESULT lines = SendMessage(_hwnd_console_input, EM_GETLINECOUNT, 0, 0);
+        if (older ? line != 0 : (line != lines - 1 || !_history_active)) return 0;
+
+        // What was typed before recalling acts as the prefix
+        if (!_history_active) {
+            _thread_input_get(_history_draft);
+            _history_active = true;
+        }
+
+        std::wstring text;
+        if (older) {
+            if (_history.previous(_history_draft, text)) _thread_input_set(text);
+            else MessageBeep(MB_OK);
+        } else {
+            if (_history.next(_history_draft, text)) _thread_input_set(text);
+            else { _thread_input_set(_history_draft); _thread_history_reset(); }
+        }
+        return 1;
+    }
+
+    LRESULT console::_thread_history_search() {
+        // What was typed before searching is the text to look for
+        if (!_history_active) {
+            _thread_input_get(_history_draft);
+            _history_active = true;
+        }
+
+        // Each repeated search continues with older entries
+        std::wstring text;
+        if (_history.search(_history_draft, text)) _thread_input_set(text);
+        else MessageBeep(MB_OK);
+        return 1;
+    }
+
+    void console::_thread_history_reset() {
+        if (!_history_active) return;
+        _history.reset();
+        _history_draft.clear();
+        _history_active = false;
+    }
+
+    LRESULT console::_thread_complete() {
+        // Answer from the static words right away
+        std::vector<std::wstring> candidates;
+        std::wstring text; _thread_input_get(text);
+        size_t start = text.find_last_of(L" \t\r\n");
+        std::wstring word = text.substr(start == std::wstring::npos ? 0 : start + 1);
+        _completion.lookup(word, candidates);
+
+        // Providers answer later through CONSOLE_MSG_COMPLETE
+        _completion.request(word, _hwnd_console, CONSOLE_MSG_COMPLETE);
+        _thread_complete_apply(candidates);
+        return 1;
+    }
+
+    void console::_thread_complete_results(LONG id) {
+        std::vector<std::wstring> candidates;
+        if (!_completion.results(id, candidates)) return;
+
+        // The word may have grown since the request, so merge the static words again
+        std::wstring text; _thread_input_get(text);
+        size_t start = text.find_last_of(L" \t\r\n");
+        _completion.lookup(text.substr(start == std::wstring::npos ? 0 : start + 1), candidates);
+        _thread_complete_apply(candidates);
+    }
+
+    void console::_thread_complete_apply(std::vector<std::wstring>& candidates) {
+        // Locate the word being completed
+        std::wstring text; _thread_input_get(text);
+        size_t start = text.find_last_of(L" \t\r\n");
+        start = (start == std::wstring::npos) ? 0 : start + 1;
+        std::wstring word = text.substr(start);
+
+        // Keep distinct candidates that still match
+        std::vector<std::wstring> matches;
+        for (size_t i = 0; i < candidates.size(); i++)
+            if (candidates[i].compare(0, word.size(), word) == 0 && candidates[i].size() >= word.size())
+                matches.push_back(candidates[i]);
+        std::sort(matches.begin(), matches.end());
+        matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+        if (matches.empty()) return;
+
+        // A single match completes the word outright
+        if (matches.size() == 1) {
+            _thread_input_set(text.substr(0, start) + matches[0] + L" ");
+            _completion.cancel();
+            return;
+        }
+
+        // Otherwise extend the word as far as all matches agree
+        size_t common = matches.front().size();
+        for (size_t i = 1; i < matches.size(); i++) {
+            size_t length = 0;
+            while (length < common && length < matches[i].size() &&
+                   matches[i][length] == matches.front()[length]) length++;
+            common = length;
+        }
+        if (common > word.size()) {
+            _thread_input_set(text.substr(0, start) + matches.front().substr(0, common));
+            return;
+        }
+
+        // Nothing more to add, list the choices instead
+        mail::string listing;
+        for (size_t i = 0; i < matches.size(); i++)
+            listing.append(matches[i]).append(i + 1 < matches.size() ? L"  " : L"\n");
+        mail::header info;
+        info.level = db::scrollback::LEVEL_Info;
+        info.tick = timestamp::now();
+        _thread_handler_mail(listing, info);
+    }
+
+    void console::_thread_input_get(std::wstring& text) {
+        // Get input text length
+        GETTEXTLENGTHEX length_spec;
+        length_spec.codepage = CP_WINUNICODE;
+        length_spec.flags = GTL_DEFAULT;
+        LRESULT length = SendMessage(_hwnd_console_input, EM_GETTEXTLENGTHEX, reinterpret_cast<WPARAM>(&length_spec), 0);
+        if (length == E_INVALIDARG) { text.clear(); return; }
+        length += 1; // Add 1 for the null terminator
+
+        // Prepare a buffer and fill it with the text
+        text.resize(length);
+        GETTEXTEX fetch_spec = { 0 };
+        fetch_spec.cb = length * sizeof(TCHAR);
+        fetch_spec.codepage = CP_WINUNICODE;
+        fetch_spec.flags = GT_DEFAULT;
+        SendMessage(_hwnd_console_input, EM_GETTEXTEX, reinterpret_cast<WPARAM>(&fetch_spec), reinterpret_cast<LPARAM>(&text[0]));
+        text.resize(wcslen(text.c_str()));
+    }
+
+    void console::_thread_input_set(const std::wstring& text) {
+        // Replace the contents and put the caret at the end
+        SETTEXTEX set_spec;
+        set_spec.codepage = CP_WINUNICODE;
+        set_spec.flags = ST_DEFAULT;
+        SendMessage(_hwnd_console_input, EM_SETTEXTEX, reinterpret_cast<WPARAM>(&set_spec), reinterpret_cast<LPARAM>(text.c_str()));
+        CHARRANGE range = { -1, -1 };
+        SendMessage(_hwnd_console_input, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&range));
+        _thread_lex();
+    }
+
+    void console::_thread_syntax(db::tokenizer* rules) {
+        // Start over in plain text, then lex everything with the new rules
+        CHARFORMAT2 format;
+        memset(&format, 0, sizeof(format));
+        format.cbSize = sizeof(format);
+        format.dwMask = CFM_COLOR | CFM_BOLD;
+        format.dwEffects = CFE_AUTOCOLOR;
+        SendMessage(_hwnd_console_input, EM_SETCHARFORMAT, SCF_ALL, reinterpret_cast<LPARAM>(&format));
+        _lexer.rules(rules);
+        _lex_text.clear();
+        _thread_lex();
+    }
+
+    void console::_thread_lex() {
+        _lex_posted = false;
+
+        // The edit is whatever lies between the parts that stayed the same
+        std::wstring text;
+        _thread_input_get(text);
+        size_t shorter = (std::min)(text.size(), _lex_text.size());
+        size_t prefix = 0, suffix = 0;
+        while (prefix < shorter && text[prefix] == _lex_text[prefix]) prefix++;
+        while (suffix < shorter - prefix && text[text.size() - suffix - 1] == _lex_text[_lex_text.size() - suffix - 1]) suffix++;
+        if (prefix < text.size() || prefix < _lex_text.size())
+            _lexer.edit(prefix, _lex_text.size() - prefix - suffix, text.size() - prefix - suffix);
+        _lex_text.swap(text);
+
+        // Lexing past the budget carries on from a timer, keys come first
+        size_t from, to;
+        bool done = _lexer.update(_lex_text, CONSOLE_LEX_BUDGET, from, to);
+        _thread_lex_apply(from, to);
+        if (done) KillTimer(_hwnd_console, CONSOLE_TIMER_LEX);
+        else SetTimer(_hwnd_console, CONSOLE_TIMER_LEX, CONSOLE_LEX_DELAY, NULL);
+    }
+
+    void console::_thread_lex_apply(size_t from, size_t to) {
+        const std::vector<db::lexer::token>& tokens = _lexer.tokens();
+        size_t first = std::upper_bound(tokens.begin(), tokens.end(), from,
+            [](size_t position, const db::lexer::token& entry) { return position < entry.start + entry.length; }) - tokens.begin();
+        if (from >= to || first >= tokens.size()) return;
+
+        CHARFORMAT2 format;
+        memset(&format, 0, sizeof(format));
+        format.cbSize = sizeof(format);
+        format.dwMask = CFM_COLOR | CFM_BOLD;
+
+        // Keep the formatting out of the undo history where the control allows it
+        ITextDocument* document = NULL;
+        IRichEditOle* ole = NULL;
+        if (SendMessage(_hwnd_console_input, EM_GETOLEINTERFACE, 0, reinterpret_cast<LPARAM>(&ole)) && ole) {
+            ole->QueryInterface(__uuidof(ITextDocument), reinterpret_cast<void**>(&document));
+            ole->Release();
+        }
+        if (document) document->Undo(tomSuspend, NULL);
+
+        // Restyle runs of tokens sharing a style, then put the caret and view back
+        CHARRANGE selection;
+        POINT scroll;
+        SendMessage(_hwnd_console_input, EM_EXGETSEL, 0, reinterpret_cast<LPARAM>(&selection));
+        SendMessage(_hwnd_console_input, EM_GETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&scroll));
+        SendMessage(_hwnd_console_input, EM_HIDESELECTION, TRUE, 0);
+        for (size_t i = first; i < tokens.size() && tokens[i].start < to;) {
+            size_t last = i;
+            while (last + 1 < tokens.size() && tokens[last + 1].start < to && tokens[last + 1].format == tokens[i].format) last++;
+            CHARRANGE range;
+            range.cpMin = static_cast<LONG>(tokens[i].start);
+            range.cpMax = static_cast<LONG>(tokens[last].start + tokens[last].length);
+            const style& look = style_table::lookup(tokens[i].format);
+            format.crTextColor = look.colour;
+            format.dwEffects = (tokens[i].format == style_table::STYLE_Plain ? CFE_AUTOCOLOR : 0) | (look.bold ? CFE_BOLD : 0);
+            SendMessage(_hwnd_console_input, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&range));
+            SendMessage(_hwnd_console_input, EM_SETCHARFORMAT, SCF_SELECTION, reinterpret_cast<LPARAM>(&format));
+            i = last + 1;
+        }
+        SendMessage(_hwnd_console_input, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&selection));
+        SendMessage(_hwnd_console_input, EM_SETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&scroll));
+        SendMessage(_hwnd_console_input, EM_HIDESELECTION, FALSE, 0);
+
+        if (document) {
+            document->Undo(tomResume, NULL);
+            document->Release();
+        }
     }
     
     VOID console::_thread_resize(DWORD width, DWORD height) {
-        SetWindowPos(_hwnd_console_output, NULL, 0, 0, width, height * 0.9, 0);
-        SetWindowPos(_hwnd_console_input, NULL, 0, height * 0.9, width, height * 0.1, 0);
+        // Status lines take their room from the output
+        int status = _status_lines ? static_cast<int>(_status_lines * _cell_height + 2 * GetSystemMetrics(SM_CYBORDER) + 2) : 0;
+        int output = (std::max)(0, static_cast<int>(height * 0.9) - status);
+        SetWindowPos(_hwnd_console_output, NULL, 0, 0, width, output, 0);
+        SetWindowPos(_hwnd_console_status, NULL, 0, output, width, status, 0);
+        SetWindowPos(_hwnd_console_input, NULL, 0, output + status, width, height * 0.1, 0);
+        _thread_reflow();
+    }
+
+    void console::_thread_measure() {
+        // Cells are the average digit width and the line height of the output font
+        HDC dc = GetDC(_hwnd_console_output);
+        HGDIOBJ previous = SelectObject(dc, reinterpret_cast<HGDIOBJ>(SendMessage(_hwnd_console_output, WM_GETFONT, 0, 0)));
+        SIZE extent = { 0, 0 };
+        GetTextExtentPoint32W(dc, L"0123456789", 10, &extent);
+        if (previous) SelectObject(dc, previous);
+        ReleaseDC(_hwnd_console_output, dc);
+        if (extent.cx >= 10) _cell_width = extent.cx / 10;
+        if (extent.cy > 0) _cell_height = extent.cy;
+    }
+
+    void console::_thread_reflow() {
+        // Lay out what is on screen right away, the rest a budget at a time
+        RECT client;
+        GetClientRect(_hwnd_console_output, &client);
+        size_t columns = _layout.width();
+        _layout.width(client.right / _cell_width);
+        _layout.tail(_thread_rows());
+        if (_layout.step(0)) SetTimer(_hwnd_console, CONSOLE_TIMER_REFLOW, CONSOLE_REFLOW_DELAY, NULL);
+
+        // While following, the lines that fill the screen depend on the width
+        if (columns != _layout.width() && _backlog.behind()) _thread_tail();
+    }
+
+    size_t console::_thread_rows() {
+        RECT client;
+        GetClientRect(_hwnd_console_output, &client);
+        return client.bottom / _cell_height + 1;
+    }
+
+    void console::_thread_wrap(bool fixed) {
+        if (fixed) {
+            // Wrap at a fixed width, resizing no longer lays out the whole document
+            RECT client;
+            GetClientRect(_hwnd_console_output, &client);
+            _wrap_fixed = GetDC(_hwnd_console_output);
+            int twips = MulDiv(client.right, 1440, GetDeviceCaps(_wrap_fixed, LOGPIXELSX));
+            SendMessage(_hwnd_console_output, EM_SETTARGETDEVICE, reinterpret_cast<WPARAM>(_wrap_fixed), twips);
+        } else {
+            // Back to wrapping at the window, laid out once at the final size
+            SendMessage(_hwnd_console_output, EM_SETTARGETDEVICE, 0, 0);
+            ReleaseDC(_hwnd_console_output, _wrap_fixed);
+            _wrap_fixed = NULL;
+        }
+    }
+
+    void console::_thread_status(bool timer) {
+        // Draw at most once a frame, a frame asked for too early waits on a timer
+        if (timer) {
+            KillTimer(_hwnd_console, CONSOLE_TIMER_STATUS);
+            _status_waiting = false;
+        } else if (_status_waiting) return;
+        DWORD elapsed = GetTickCount() - _status_drawn;
+        if (!timer && elapsed < CONSOLE_STATUS_FRAME) {
+            SetTimer(_hwnd_console, CONSOLE_TIMER_STATUS, CONSOLE_STATUS_FRAME - elapsed, NULL);
+            _status_waiting = true;
+            return;
+        }
+
+        // Only the latest text of each line is drawn
+        std::vector<std::wstring> lines;
+        if (!_status.collect(lines)) return;
+        _status_drawn = GetTickCount();
+        std::wstring text;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (i) text.append(L"\r\n");
+            text.append(lines[i]);
+        }
+        SendMessage(_hwnd_console_status, WM_SETTEXT, 0, reinterpret_cast<LPARAM>(text.c_str()));
+
+        // Opening or closing a line changes the layout
+        if (lines.size() != _status_lines) {
+            _status_lines = lines.size();
+            RECT client;
+            GetClientRect(_hwnd_console, &client);
+            _thread_resize(client.right, client.bottom);
+        }
     }
 
     bool console::_thread_finalize() {
@@ -372,15 +1389,107 @@ namespace db
         UnregisterClass(CONSOLE_WINDOW_CLASS, _get_instance());
     }
 
+    void console::_status_update(size_t slot, unsigned generation, const std::wstring& text) {
+        _status_post(_status.update(slot, generation, text));
+    }
+
+    void console::_status_close(size_t slot, unsigned generation) {
+        _status_post(_status.close(slot, generation));
+    }
+
+    void console::_status_post(bool schedule) {
+        // Only the first change since the last frame asks for another, the
+        // window draws whatever is pending once it exists
+        _pending_lock.acquire();
+        bool ready = _ready.load(std::memory_order_relaxed);
+        _pending_lock.release();
+        if (schedule && ready) PostMessage(_hwnd_console, CONSOLE_MSG_STATUS, 0, 0);
+    }
+
+    bool console::_pending_acquire() {
+        // Once the window exists calls go straight through, seeing the
+        // settings published with the flag
+        if (_ready.load(std::memory_order_acquire)) return false;
+
+        // Otherwise hold the lock while the caller records its request
+        _pending_lock.acquire();
+        if (_ready.load(std::memory_order_relaxed)) {
+            _pending_lock.release();
+            return false;
+        }
+        return true;
+    }
+
+    void console::_pending_release() {
+        _pending_lock.release();
+    }
+
     void console::_ref_acquire() {
         _ref_lock.acquire();
-        if (_ref_count++ == 0) _wndclass_register();
+        _ref_count++;
+        _ref_lock.release();
+    }
+
+    void console::_ref_initialize() {
+        // Runs on the UI thread, the class stays registered while references remain
+        if (_ref_initialized.load(std::memory_order_acquire)) return;
+        _ref_lock.acquire();
+        if (!_ref_initialized.load(std::memory_order_relaxed)) {
+            LoadLibrary(_T("msftedit.dll"));
+            _wndclass_register();
+            _ref_initialized.store(true, std::memory_order_release);
+        }
         _ref_lock.release();
     }
     
     void console::_ref_release() {
         _ref_lock.acquire();
-        if (--_ref_count == 0) _wndclass_unregister();
+        if (--_ref_count == 0 && _ref_initialized.load(std::memory_order_relaxed)) {
+            _wndclass_unregister();
+            _ref_initialized.store(false, std::memory_order_release);
+        }
         _ref_lock.release();
     }
+
+    status_line& status_line::update(const std::wstring& text) {
+        _owner->_status_update(_slot, _generation, text);
+        return *this;
+    }
+
+    void status_line::close() {
+        _owner->_status_close(_slot, _generation);
+    }
+
+    size_t replayer::play(console& target, double rate) {
+        return play([&target](const recorder::event& current) {
+            switch (current.type) {
+            case recorder::EVENT_Write:
+                target.write(current.text, current.timeout, static_cast<scrollback::level>(current.level), current.category);
+                break;
+            case recorder::EVENT_Input:
+                target.input(current.text, INFINITE);
+                break;
+            case recorder::EVENT_Control: {
+                unsigned long value = static_cast<unsigned long>(current.first);
+                console::rgb colour(GetRValue(value), GetGValue(value), GetBValue(value));
+                switch (current.setting) {
+                case recorder::OPTION_Show: target.show(current.first != 0); break;
+                case recorder::OPTION_Title: target.title(current.text.c_str()); break;
+                case recorder::OPTION_Background: target.background(colour); break;
+                case recorder::OPTION_Resize: target.resize(static_cast<int>(current.first), static_cast<int>(current.second)); break;
+                case recorder::OPTION_Category: target.category(current.text); break;
+                case recorder::OPTION_Filter:
+                    target.filter(scrollback::filter(static_cast<unsigned>(current.first), current.second));
+                    break;
+                case recorder::OPTION_Dedupe: target.dedupe(static_cast<size_t>(current.first)); break;
+                case recorder::OPTION_Timestamps: target.timestamps(current.first != 0); break;
+                case recorder::OPTION_Highlight:
+                    target.highlight(current.text, colour, static_cast<highlighter::scope>(current.second & 0xFF), (current.second >> 8) != 0);
+                    break;
+                }
+                break;
+            }
+            }
+        }, rate);
+    }
 }
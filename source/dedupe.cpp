@@ -0,0 +1,103 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Repeated output suppression implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // FNV-1a parameters
+    static const unsigned long long DEDUPE_Offset = 14695981039346656037ull;
+    static const unsigned long long DEDUPE_Prime = 1099511628211ull;
+
+    dedupe::dedupe()
+        : _next(0) {}
+
+    dedupe::~dedupe() {}
+
+    void dedupe::window(size_t size) {
+        _entries.assign(size, entry());
+        for (size_t i = 0; i < _entries.size(); i++) {
+            _entries[i].count = 0;
+            _entries[i].marker = -1;
+        }
+        _slots.clear();
+        _next = 0;
+    }
+
+    dedupe::entry* dedupe::track(const std::wstring& text, int level, int category, bool& repeated) {
+        repeated = false;
+        if (_entries.empty()) return NULL;
+        unsigned long long hash = _hash(text, level, category);
+
+        // Seen within the window, count it
+        std::unordered_map<unsigned long long, size_t>::iterator found = _slots.find(hash);
+        if (found != _slots.end()) {
+            entry& seen = _entries[found->second];
+            if (seen.level == level && seen.category == category && seen.text == text) {
+                seen.count++;
+                repeated = true;
+                return &seen;
+            }
+        }
+
+        // Otherwise the message replaces the oldest entry
+        entry& fresh = _entries[_next];
+        if (fresh.count) {
+            std::unordered_map<unsigned long long, size_t>::iterator stale = _slots.find(fresh.hash);
+            if (stale != _slots.end() && stale->second == _next) _slots.erase(stale);
+        }
+        fresh.hash = hash;
+        fresh.text = text;
+        fresh.level = level;
+        fresh.category = category;
+        fresh.count = 1;
+        fresh.line = 0;
+        fresh.marker = -1;
+        fresh.length = 0;
+        _slots[hash] = _next;
+        _next = (_next + 1) % _entries.size();
+        return &fresh;
+    }
+
+    void dedupe::shift(LONG after, LONG delta) {
+        // A counter changed length, everything shown after it moved
+        for (size_t i = 0; i < _entries.size(); i++)
+            if (_entries[i].count && _entries[i].marker > after) _entries[i].marker += delta;
+    }
+
+    void dedupe::clear() {
+        window(_entries.size());
+    }
+
+    std::wstring dedupe::label(size_t count) {
+        return L" (repeated " + std::to_wstring(static_cast<unsigned long long>(count)) + L"\u00D7)";
+    }
+
+    unsigned long long dedupe::_hash(const std::wstring& text, int level, int category) {
+        unsigned long long hash = DEDUPE_Offset;
+        hash = (hash ^ static_cast<unsigned long long>(level)) * DEDUPE_Prime;
+        hash = (hash ^ static_cast<unsigned long long>(category)) * DEDUPE_Prime;
+        for (size_t i = 0; i < text.size(); i++)
+            hash = (hash ^ static_cast<unsigned long long>(text[i])) * DEDUPE_Prime;
+        return hash;
+    }
+}
@@ -0,0 +1,140 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Executor implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    executor::executor(int threads)
+        : _sem_work(NULL),
+          _tls_worker(TLS_OUT_OF_INDEXES),
+          _next(0),
+          _quit(0)
+    {
+        // Default to one worker per processor
+        if (threads <= 0) {
+            SYSTEM_INFO info; GetSystemInfo(&info);
+            threads = static_cast<int>(info.dwNumberOfProcessors);
+        }
+
+        // Shared state for the workers
+        _sem_work = CreateSemaphore(NULL, 0, MAXLONG, NULL);
+        win_exception::check(_sem_work);
+        _tls_worker = TlsAlloc();
+        if (_tls_worker == TLS_OUT_OF_INDEXES) win_exception::check_last_error();
+
+        // Start the workers
+        for (int i = 0; i < threads; i++) {
+            worker* fresh = new worker;
+            fresh->owner = this;
+            fresh->index = _workers.size();
+            fresh->thread = NULL;
+            _workers.push_back(fresh);
+        }
+        for (size_t i = 0; i < _workers.size(); i++) {
+            _workers[i]->thread = CreateThread(NULL, 0, _callback_threadproc, _workers[i], 0, NULL);
+            win_exception::check(_workers[i]->thread);
+        }
+    }
+
+    executor::~executor() {
+        // Wake every worker, each one leaves once no work is left
+        InterlockedExchange(&_quit, 1);
+        ReleaseSemaphore(_sem_work, static_cast<LONG>(_workers.size()), NULL);
+
+        for (size_t i = 0; i < _workers.size(); i++) {
+            if (_workers[i]->thread) {
+                WaitForSingleObject(_workers[i]->thread, INFINITE);
+                CloseHandle(_workers[i]->thread);
+            }
+            delete _workers[i];
+        }
+
+        TlsFree(_tls_worker);
+        CloseHandle(_sem_work);
+    }
+
+    void executor::submit(const task& work) {
+        // Workers keep their own work local, everyone else spreads it out
+        worker* local = reinterpret_cast<worker*>(TlsGetValue(_tls_worker));
+        worker* target = local ? local
+            : _workers[static_cast<unsigned long>(InterlockedIncrement(&_next)) % _workers.size()];
+
+        target->guard.acquire();
+        target->queue.push_back(work);
+        target->guard.release();
+
+        ReleaseSemaphore(_sem_work, 1, NULL);
+    }
+
+    DWORD executor::_callback_threadproc(void* pworker) {
+        worker* self = reinterpret_cast<worker*>(pworker);
+        self->owner->_thread_run(*self);
+        return 0;
+    }
+
+    void executor::_thread_run(worker& self) {
+        TlsSetValue(_tls_worker, &self);
+
+        task work;
+        for (;;) {
+            WaitForSingleObject(_sem_work, INFINITE);
+
+            // Every count on the semaphore is backed by a task unless shutting down
+            if (!_take(self.index, work)) {
+                if (_quit) break;
+                continue;
+            }
+
+            work();
+            work = task();
+        }
+    }
+
+    bool executor::_take(size_t index, task& work) {
+        // Newest task from our own deque first
+        worker& self = *_workers[index];
+        self.guard.acquire();
+        if (!self.queue.empty()) {
+            work.swap(self.queue.back());
+            self.queue.pop_back();
+            self.guard.release();
+            return true;
+        }
+        self.guard.release();
+
+        // Then steal the oldest task from someone else
+        for (size_t i = 1; i < _workers.size(); i++) {
+            worker& victim = *_workers[(index + i) % _workers.size()];
+            victim.guard.acquire();
+            if (!victim.queue.empty()) {
+                work.swap(victim.queue.front());
+                victim.queue.pop_front();
+                victim.guard.release();
+                return true;
+            }
+            victim.guard.release();
+        }
+
+        return false;
+    }
+}
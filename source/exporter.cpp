@@ -0,0 +1,269 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Scrollback export implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Lines formatted by one task
+    static const size_t EXPORT_LINES = 4096;
+
+    // Ranges in flight per worker
+    static const size_t EXPORT_DEPTH = 2;
+
+    // Bytes gathered before each write
+    static const size_t EXPORT_BUFFER = 4 * 1024 * 1024;
+
+    // RTF groups whose text is not part of the document
+    static const wchar_t* EXPORT_DESTINATIONS[] = {
+        L"fonttbl", L"colortbl", L"stylesheet", L"info", L"pict", L"header", L"footer", NULL
+    };
+
+    exporter::exporter()
+        : _executor(NULL) {}
+
+    exporter::~exporter() {
+        delete _executor;
+    }
+
+    void exporter::write(const scrollback::snapshot& contents, const wchar_t* path, format kind, bool stamps) {
+        HANDLE file = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) win_exception::check_last_error();
+
+        // Ranges are handed out round robin over a fixed set of slots
+        executor& pool = _pool();
+        size_t first = contents.first();
+        size_t count = (contents.end() - first + EXPORT_LINES - 1) / EXPORT_LINES;
+        std::vector<range> slots((std::max)(static_cast<size_t>(1), (std::min)(count, pool.threads() * EXPORT_DEPTH)));
+        for (size_t i = 0; i < slots.size(); i++)
+            slots[i].done = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+        auto start = [&](size_t index) {
+            range* slot = &slots[index % slots.size()];
+            slot->from = first + index * EXPORT_LINES;
+            slot->to = (std::min)(contents.end(), slot->from + EXPORT_LINES);
+            pool.submit([&contents, slot, kind, stamps]() {
+                slot->data.clear();
+                slot->failed = false;
+                try {
+                    for (size_t i = slot->from; i < slot->to; i++)
+                        render(contents.at(i), kind, stamps, slot->data);
+                } catch (...) {
+                    slot->failed = true;
+                }
+                SetEvent(slot->done);
+            });
+        };
+
+        std::string buffer;
+        buffer.reserve(EXPORT_BUFFER + EXPORT_BUFFER / 4);
+        _header(kind, buffer);
+
+        // Write ranges in order, refilling each slot as soon as it is drained
+        DWORD error = ERROR_SUCCESS;
+        size_t submitted = 0;
+        for (; submitted < (std::min)(count, slots.size()); submitted++) start(submitted);
+        for (size_t i = 0; i < submitted; i++) {
+            range& slot = slots[i % slots.size()];
+            WaitForSingleObject(slot.done, INFINITE);
+            if (error == ERROR_SUCCESS && slot.failed) error = ERROR_NOT_ENOUGH_MEMORY;
+            if (error == ERROR_SUCCESS) {
+                buffer.append(slot.data);
+                if (buffer.size() >= EXPORT_BUFFER) error = _flush(file, buffer);
+            }
+            if (error == ERROR_SUCCESS && submitted < count) start(submitted++);
+        }
+
+        if (error == ERROR_SUCCESS) {
+            _footer(kind, buffer);
+            error = _flush(file, buffer);
+        }
+        for (size_t i = 0; i < slots.size(); i++)
+            CloseHandle(slots[i].done);
+        CloseHandle(file);
+        if (error != ERROR_SUCCESS) throw win_exception(error);
+    }
+
+    void exporter::render(const scrollback::line& entry, format kind, bool stamps, std::string& out) {
+        // Compose the line as shown: stamp, plain text and repeat counter
+        std::wstring shown;
+        if (stamps && entry.stamp) shown.append(L"[").append(timestamp::text(entry.stamp)).append(L"] ");
+        if (entry.text.compare(0, 5, L"{\\rtf") == 0) text(std::wstring(entry.text.begin(), entry.text.end()), shown);
+        else shown.append(entry.text.begin(), entry.text.end());
+        if (entry.repeats > 1) {
+            size_t end = shown.find_last_not_of(L"\r\n") + 1;
+            shown.insert(end, dedupe::label(entry.repeats));
+        }
+
+        static const char* classes[] = { "debug", NULL, "warning", "error" };
+        const char* style = (entry.level < scrollback::LEVEL_Count) ? classes[entry.level] : NULL;
+
+        switch (kind) {
+        case FORMAT_Plain:
+            utf8(shown, out);
+            break;
+
+        case FORMAT_Html: {
+            if (style) out.append("<span class=\"").append(style).append("\">");
+            std::wstring escaped;
+            escaped.reserve(shown.size());
+            for (size_t i = 0; i < shown.size(); i++) {
+                switch (shown[i]) {
+                case L'&': escaped.append(L"&amp;"); break;
+                case L'<': escaped.append(L"&lt;"); break;
+                case L'>': escaped.append(L"&gt;"); break;
+                case L'"': escaped.append(L"&quot;"); break;
+                case L'\r': break;
+                default: escaped.push_back(shown[i]);
+                }
+            }
+            utf8(escaped, out);
+            if (style) out.append("</span>");
+            break;
+        }
+
+        case FORMAT_Rtf: {
+            // Colour table entries follow the level order
+            out.append("\\cf").append(std::to_string(static_cast<long long>(entry.level + 1))).append(" ");
+            for (size_t i = 0; i < shown.size(); i++) {
+                wchar_t c = shown[i];
+                if (c == L'\\' || c == L'{' || c == L'}') { out.push_back('\\'); out.push_back(static_cast<char>(c)); }
+                else if (c == L'\n') out.append("\\par\n");
+                else if (c == L'\r') continue;
+                else if (c == L'\t') out.append("\\tab ");
+                else if (c < 0x80) out.push_back(static_cast<char>(c));
+                else out.append("\\u").append(std::to_string(static_cast<long long>(static_cast<short>(c)))).append("?");
+            }
+            break;
+        }
+        }
+    }
+
+    void exporter::_header(format kind, std::string& out) {
+        if (kind == FORMAT_Html)
+            out.append("<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><style>\n"
+                       "pre{font-family:Consolas,monospace}.debug{color:#808080}.warning{color:#c08000}.error{color:#c00000}\n"
+                       "</style></head><body><pre>");
+        else if (kind == FORMAT_Rtf)
+            out.append("{\\rtf1\\ansi\\deff0{\\fonttbl{\\f0\\fmodern Consolas;}}"
+                       "{\\colortbl;\\red128\\green128\\blue128;\\red0\\green0\\blue0;\\red192\\green128\\blue0;\\red192\\green0\\blue0;}"
+                       "\\f0\\fs18\n");
+    }
+
+    void exporter::_footer(format kind, std::string& out) {
+        if (kind == FORMAT_Html) out.append("</pre></body></html>\n");
+        else if (kind == FORMAT_Rtf) out.append("}\n");
+    }
+
+    void exporter::text(const std::wstring& rtf, std::wstring& out) {
+        // Just enough RTF to recover the text of what the console was sent
+        int depth = 0, skip = 0, fallback = 0;
+        for (size_t i = 0; i < rtf.size(); i++) {
+            wchar_t c = rtf[i];
+            if (c == L'{') {
+                depth++;
+                if (!skip && rtf.compare(i + 1, 2, L"\\*") == 0) skip = depth;
+                for (int j = 0; !skip && EXPORT_DESTINATIONS[j]; j++) {
+                    size_t length = wcslen(EXPORT_DESTINATIONS[j]);
+                    if (rtf.compare(i + 1, 1, L"\\") == 0 && rtf.compare(i + 2, length, EXPORT_DESTINATIONS[j]) == 0)
+                        skip = depth;
+                }
+            } else if (c == L'}') {
+                if (skip == depth) skip = 0;
+                depth--;
+            } else if (c == L'\\' && i + 1 < rtf.size()) {
+                wchar_t next = rtf[++i];
+                if (next == L'\\' || next == L'{' || next == L'}') {
+                    if (!skip) out.push_back(next);
+                } else if (next == L'\'' && i + 2 < rtf.size()) {
+                    wchar_t digits[3] = { rtf[i + 1], rtf[i + 2], 0 };
+                    if (!skip && !fallback) out.push_back(static_cast<wchar_t>(wcstol(digits, NULL, 16)));
+                    if (fallback) fallback--;
+                    i += 2;
+                } else if (iswalpha(next)) {
+                    // Control word with an optional numeric parameter and delimiting space
+                    size_t begin = i;
+                    while (i < rtf.size() && iswalpha(rtf[i])) i++;
+                    std::wstring word = rtf.substr(begin, i - begin);
+                    size_t number = i;
+                    if (i < rtf.size() && (rtf[i] == L'-' || iswdigit(rtf[i]))) i++;
+                    while (i < rtf.size() && iswdigit(rtf[i])) i++;
+                    long parameter = wcstol(rtf.substr(number, i - number).c_str(), NULL, 10);
+                    if (i >= rtf.size() || rtf[i] != L' ') i--;
+                    if (skip) continue;
+                    if (word == L"par" || word == L"line") out.push_back(L'\n');
+                    else if (word == L"tab") out.push_back(L'\t');
+                    else if (word == L"u") { out.push_back(static_cast<wchar_t>(parameter & 0xFFFF)); fallback = 1; }
+                }
+            } else if (c != L'\r' && c != L'\n' && !skip) {
+                if (fallback) fallback--;
+                else out.push_back(c);
+            }
+        }
+    }
+
+    void exporter::utf8(const std::wstring& text, std::string& out) {
+        for (size_t i = 0; i < text.size(); i++) {
+            unsigned long c = static_cast<unsigned long>(text[i]);
+
+            // Join surrogate pairs
+            if (c >= 0xD800 && c < 0xDC00 && i + 1 < text.size() &&
+                text[i + 1] >= 0xDC00 && text[i + 1] < 0xE000)
+                c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<unsigned long>(text[++i]) - 0xDC00);
+
+            if (c < 0x80) out.push_back(static_cast<char>(c));
+            else if (c < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+                out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+            } else if (c < 0x10000) {
+                out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+            } else {
+                out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+            }
+        }
+    }
+
+    DWORD exporter::_flush(HANDLE file, std::string& buffer) {
+        size_t offset = 0;
+        while (offset < buffer.size()) {
+            DWORD written = 0;
+            DWORD size = static_cast<DWORD>((std::min)(buffer.size() - offset, static_cast<size_t>(0x40000000)));
+            if (!WriteFile(file, buffer.data() + offset, size, &written, NULL)) return GetLastError();
+            offset += written;
+        }
+        buffer.clear();
+        return ERROR_SUCCESS;
+    }
+
+    executor& exporter::_pool() {
+        _lock.acquire();
+        if (!_executor) _executor = new executor();
+        executor& result = *_executor;
+        _lock.release();
+        return result;
+    }
+}
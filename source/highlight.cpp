@@ -0,0 +1,169 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output highlighting implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Characters with a class of their own, anything above shares class 0
+    static const size_t HIGHLIGHT_Characters = 0x10000;
+
+    highlighter::highlighter()
+        : _width(1), _compiled(true)
+    {
+        _classes.assign(HIGHLIGHT_Characters, 0);
+        _transitions.assign(1, 0);
+        _outputs.assign(1, -1);
+    }
+
+    void highlighter::add(const std::wstring& pattern, const style& format, scope extent) {
+        if (pattern.empty()) return;
+        rule entry;
+        entry.pattern = pattern;
+        entry.format = style_table::intern(format);
+        entry.extent = extent;
+
+        // The automaton is rebuilt the next time it is used
+        _lock.acquire();
+        _rules.push_back(entry);
+        _compiled = false;
+        _lock.release();
+    }
+
+    void highlighter::apply(const std::wstring& text, std::vector<run>& runs) {
+        runs.clear();
+        _lock.acquire();
+        if (!_compiled) _compile();
+
+        int state = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            // At the root, characters starting no rule are skipped without
+            // walking the automaton, each test independent of the last
+            if (state == 0) {
+                while (i < text.size() && _transitions[static_cast<size_t>(text[i]) < HIGHLIGHT_Characters ? _classes[text[i]] : 0] == 0) i++;
+                if (i == text.size()) break;
+            }
+
+            wchar_t c = text[i];
+            state = _transitions[state * _width + (static_cast<size_t>(c) < HIGHLIGHT_Characters ? _classes[c] : 0)];
+
+            // Each state knows the longest rule ending at it
+            int hit = _outputs[state];
+            if (hit < 0) continue;
+            const rule& matched = _rules[hit];
+
+            size_t start = i + 1 - matched.pattern.size(), end = i + 1;
+            if (matched.extent == SCOPE_Token) {
+                while (start > 0 && !iswspace(text[start - 1])) start--;
+                while (end < text.size() && !iswspace(text[end])) end++;
+            } else if (matched.extent == SCOPE_Line) {
+                while (start > 0 && text[start - 1] != L'\r' && text[start - 1] != L'\n') start--;
+                while (end < text.size() && text[end] != L'\r' && text[end] != L'\n') end++;
+            }
+
+            // Overlapping runs go to whichever starts first
+            if (!runs.empty() && start < runs.back().start + runs.back().length) {
+                if (start > runs.back().start || end <= runs.back().start + runs.back().length) continue;
+                runs.pop_back();
+            }
+            // Touching runs of the same style become one
+            if (!runs.empty() && start == runs.back().start + runs.back().length && matched.format == runs.back().format) {
+                runs.back().length = end - runs.back().start;
+                continue;
+            }
+            run found;
+            found.start = start;
+            found.length = end - start;
+            found.format = matched.format;
+            runs.push_back(found);
+        }
+        _lock.release();
+    }
+
+    bool highlighter::empty() {
+        _lock.acquire();
+        bool result = _rules.empty();
+        _lock.release();
+        return result;
+    }
+
+    void highlighter::_compile() {
+        // Give every character used by a rule a class of its own
+        std::fill(_classes.begin(), _classes.end(), 0);
+        _width = 1;
+        for (size_t i = 0; i < _rules.size(); i++) {
+            const std::wstring& pattern = _rules[i].pattern;
+            for (size_t j = 0; j < pattern.size(); j++) {
+                size_t c = static_cast<size_t>(pattern[j]);
+                if (c < HIGHLIGHT_Characters && !_classes[c])
+                    _classes[c] = static_cast<unsigned short>(_width++);
+            }
+        }
+
+        // Build the trie, missing edges are -1 for now
+        _transitions.assign(_width, -1);
+        _outputs.assign(1, -1);
+        for (size_t i = 0; i < _rules.size(); i++) {
+            const std::wstring& pattern = _rules[i].pattern;
+            int state = 0;
+            for (size_t j = 0; j < pattern.size(); j++) {
+                size_t c = static_cast<size_t>(pattern[j]);
+                int& next = _transitions[state * _width + (c < HIGHLIGHT_Characters ? _classes[c] : 0)];
+                if (next < 0) {
+                    next = static_cast<int>(_outputs.size());
+                    _outputs.push_back(-1);
+                    _transitions.resize(_transitions.size() + _width, -1);
+                }
+                state = _transitions[state * _width + (c < HIGHLIGHT_Characters ? _classes[c] : 0)];
+            }
+            if (_outputs[state] < 0) _outputs[state] = static_cast<int>(i);
+        }
+
+        // Breadth first, turn failure links into a complete transition table
+        std::vector<int> failure(_outputs.size(), 0);
+        std::deque<int> queue;
+        for (int c = 0; c < _width; c++) {
+            int& next = _transitions[c];
+            if (next < 0) next = 0;
+            else queue.push_back(next);
+        }
+        while (!queue.empty()) {
+            int state = queue.front();
+            queue.pop_front();
+
+            // Without a rule of its own a state reports the longest suffix rule
+            int fallback = failure[state];
+            if (_outputs[state] < 0) _outputs[state] = _outputs[fallback];
+
+            for (int c = 0; c < _width; c++) {
+                int& next = _transitions[state * _width + c];
+                int alternative = _transitions[fallback * _width + c];
+                if (next < 0) next = alternative;
+                else {
+                    failure[next] = alternative;
+                    queue.push_back(next);
+                }
+            }
+        }
+        _compiled = true;
+    }
+}
@@ -0,0 +1,346 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input history implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // History file layout
+    static const DWORD HISTORY_MAGIC = 0x31484244; // "DBH1"
+    static const radix::rank HISTORY_END = static_cast<radix::rank>(-1);
+
+    // Trigram index layout, characters are packed into a 64-bit key
+    static const size_t HISTORY_Gram = 3;
+    static const int HISTORY_CharBits = 21;
+
+    // Lists past the rarest one checked before looking at an entry
+    static const size_t HISTORY_Narrowing = 2;
+
+    history::history(size_t capacity)
+        : _posted(0),
+          _live(0),
+          _rank(0),
+          _cursor(HISTORY_END),
+          _capacity(capacity),
+          _records(0),
+          _file(INVALID_HANDLE_VALUE)
+    {
+    }
+
+    history::~history() {
+        _close();
+    }
+
+    void history::open(const wchar_t* path) {
+        _lock.acquire();
+        _close();
+
+        try {
+            // Open or create the history file
+            HANDLE file = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                     OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) win_exception::check_last_error();
+            _file = file;
+            _path.assign(path);
+
+            // Read the whole file in one go
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(_file, &size)) win_exception::check_last_error();
+            std::vector<char> contents(static_cast<size_t>(size.QuadPart));
+            DWORD read = 0;
+            if (!contents.empty() && !ReadFile(_file, contents.data(), static_cast<DWORD>(contents.size()), &read, NULL))
+                win_exception::check_last_error();
+            contents.resize(read);
+
+            // Validate or write the header
+            size_t offset = sizeof(DWORD);
+            if (contents.empty()) {
+                DWORD written = 0;
+                WriteFile(_file, &HISTORY_MAGIC, sizeof(HISTORY_MAGIC), &written, NULL);
+            } else if (contents.size() < sizeof(DWORD) ||
+                       *reinterpret_cast<const DWORD*>(contents.data()) != HISTORY_MAGIC) {
+                throw win_exception(ERROR_BAD_FORMAT);
+            }
+
+            // Replay the records, a torn record at the end is discarded
+            _records = 0;
+            while (offset + sizeof(DWORD) <= contents.size()) {
+                DWORD length = *reinterpret_cast<const DWORD*>(contents.data() + offset);
+                size_t bytes = static_cast<size_t>(length) * sizeof(wchar_t);
+                if (bytes > contents.size() - offset - sizeof(DWORD)) break;
+
+                const wchar_t* text = reinterpret_cast<const wchar_t*>(contents.data() + offset + sizeof(DWORD));
+                _insert(std::wstring(text, length));
+                offset += sizeof(DWORD) + bytes;
+                _records++;
+            }
+
+            // Position for appending
+            if (!contents.empty()) {
+                LARGE_INTEGER end; end.QuadPart = offset;
+                SetFilePointerEx(_file, end, NULL, FILE_BEGIN);
+                SetEndOfFile(_file);
+            }
+
+            // Drop stale records carried over from earlier sessions
+            if (_records > 2 * _capacity) _compact();
+        } catch (...) {
+            _close();
+            _lock.release();
+            throw;
+        }
+
+        _cursor = HISTORY_END;
+        _trail.clear();
+        _lock.release();
+    }
+
+    void history::add(const std::wstring& line) {
+        if (line.empty()) return;
+        _lock.acquire();
+        _insert(line);
+        _persist(line);
+        _cursor = HISTORY_END;
+        _trail.clear();
+        _lock.release();
+    }
+
+    bool history::previous(const std::wstring& prefix, std::wstring& line) {
+        _lock.acquire();
+        std::wstring key; radix::rank found = 0;
+        bool result = _index.previous(prefix, _cursor, key, found);
+        if (result) {
+            _trail.push_back(_cursor);
+            _cursor = found;
+            line.swap(key);
+        }
+        _lock.release();
+        return result;
+    }
+
+    bool history::next(const std::wstring& prefix, std::wstring& line) {
+        _lock.acquire();
+        bool result = false;
+        if (!_trail.empty()) {
+            // Step back towards where navigation started
+            _cursor = _trail.back();
+            _trail.pop_back();
+            std::map<radix::rank, entry>::const_iterator it = _entries.find(_cursor);
+            if (it != _entries.end() && it->second.line.compare(0, prefix.size(), prefix) == 0) {
+                line = it->second.line;
+                result = true;
+            }
+        }
+        _lock.release();
+        return result;
+    }
+
+    bool history::search(const std::wstring& text, std::wstring& line) {
+        _lock.acquire();
+        bool result = false;
+
+        if (text.size() >= HISTORY_Gram) {
+            // Only entries listed for every trigram of the text can match, a missing one rules all out
+            std::vector<trigram> grams;
+            _trigrams(text, grams);
+            std::vector<const std::vector<radix::rank>*> lists;
+            for (size_t i = 0; i < grams.size(); i++) {
+                std::unordered_map<trigram, std::vector<radix::rank> >::const_iterator found = _postings.find(grams[i]);
+                if (found == _postings.end()) { lists.clear(); break; }
+                lists.push_back(&found->second);
+            }
+            std::sort(lists.begin(), lists.end(), [](const std::vector<radix::rank>* a, const std::vector<radix::rank>* b) {
+                return a->size() < b->size();
+            });
+
+            // Walk the rarest list from the cursor towards older entries. The next rarest
+            // lists weed out most candidates before the entry itself is looked at.
+            if (!lists.empty()) {
+                const std::vector<radix::rank>& rarest = *lists[0];
+                size_t checked = (std::min)(lists.size(), HISTORY_Narrowing + 1);
+                std::vector<radix::rank>::const_iterator it = std::lower_bound(rarest.begin(), rarest.end(), _cursor);
+                while (it != rarest.begin()) {
+                    radix::rank rank = *--it;
+                    size_t held = 1;
+                    while (held < checked && std::binary_search(lists[held]->begin(), lists[held]->end(), rank)) held++;
+                    if (held < checked) continue;
+                    std::map<radix::rank, entry>::const_iterator current = _entries.find(rank);
+                    if (current == _entries.end() || current->second.line.find(text) == std::wstring::npos) continue;
+
+                    _trail.push_back(_cursor);
+                    _cursor = rank;
+                    line = current->second.line;
+                    result = true;
+                    break;
+                }
+            }
+            _lock.release();
+            return result;
+        }
+
+        // Walk from the cursor towards older entries
+        signature mask = _signature(text);
+        std::map<radix::rank, entry>::const_reverse_iterator it(_entries.lower_bound(_cursor));
+        for (; it != _entries.rend(); ++it) {
+            // Cheap rejection before the actual substring test
+            if ((it->second.mask & mask) != mask) continue;
+            if (it->second.line.find(text) == std::wstring::npos) continue;
+
+            _trail.push_back(_cursor);
+            _cursor = it->first;
+            line = it->second.line;
+            result = true;
+            break;
+        }
+
+        _lock.release();
+        return result;
+    }
+
+    void history::reset() {
+        _lock.acquire();
+        _cursor = HISTORY_END;
+        _trail.clear();
+        _lock.release();
+    }
+
+    size_t history::size() {
+        _lock.acquire();
+        size_t result = _entries.size();
+        _lock.release();
+        return result;
+    }
+
+    history::signature history::_signature(const std::wstring& text) {
+        signature mask = 0;
+        for (size_t i = 0; i < text.size(); i++)
+            mask |= signature(1) << (text[i] % 64);
+        return mask;
+    }
+
+    void history::_trigrams(const std::wstring& text, std::vector<trigram>& grams) {
+        grams.clear();
+        for (size_t i = 0; i + HISTORY_Gram <= text.size(); i++)
+            grams.push_back((static_cast<trigram>(text[i]) << (2 * HISTORY_CharBits)) |
+                            (static_cast<trigram>(text[i + 1]) << HISTORY_CharBits) |
+                             static_cast<trigram>(text[i + 2]));
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    }
+
+    void history::_insert(const std::wstring& line) {
+        // Repeated lines move to the front
+        radix::rank existing;
+        if (_index.find(line, existing)) {
+            std::map<radix::rank, entry>::iterator moved = _entries.find(existing);
+            _live -= moved->second.trigrams;
+            _entries.erase(moved);
+        }
+
+        entry& fresh = _entries[++_rank];
+        fresh.line = line;
+        fresh.mask = _signature(line);
+        _index.insert(line, _rank);
+        _post(_rank, fresh);
+
+        // Evict the oldest entries beyond capacity
+        while (_entries.size() > _capacity) {
+            _index.erase(_entries.begin()->second.line);
+            _live -= _entries.begin()->second.trigrams;
+            _entries.erase(_entries.begin());
+        }
+
+        // Stale ranks are dropped once they outnumber the live ones
+        if (_posted > 2 * _live + 1024) _repost();
+    }
+
+    void history::_post(radix::rank rank, entry& fresh) {
+        // Ranks only grow, so appending keeps every list sorted
+        std::vector<trigram> grams;
+        _trigrams(fresh.line, grams);
+        for (size_t i = 0; i < grams.size(); i++) _postings[grams[i]].push_back(rank);
+        fresh.trigrams = grams.size();
+        _posted += grams.size();
+        _live += grams.size();
+    }
+
+    void history::_repost() {
+        _postings.clear();
+        _posted = _live = 0;
+        for (std::map<radix::rank, entry>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+            _post(it->first, it->second);
+    }
+
+    void history::_persist(const std::wstring& line) {
+        if (_file == INVALID_HANDLE_VALUE) return;
+
+        // Write the record with a single call
+        std::vector<char> record(sizeof(DWORD) + line.size() * sizeof(wchar_t));
+        *reinterpret_cast<DWORD*>(record.data()) = static_cast<DWORD>(line.size());
+        memcpy(record.data() + sizeof(DWORD), line.data(), line.size() * sizeof(wchar_t));
+        DWORD written = 0;
+        WriteFile(_file, record.data(), static_cast<DWORD>(record.size()), &written, NULL);
+
+        if (++_records > 2 * _capacity) _compact();
+    }
+
+    void history::_compact() {
+        // Serialize the live entries
+        std::vector<char> contents(sizeof(DWORD));
+        *reinterpret_cast<DWORD*>(contents.data()) = HISTORY_MAGIC;
+        for (std::map<radix::rank, entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it) {
+            size_t offset = contents.size();
+            const std::wstring& line = it->second.line;
+            contents.resize(offset + sizeof(DWORD) + line.size() * sizeof(wchar_t));
+            *reinterpret_cast<DWORD*>(contents.data() + offset) = static_cast<DWORD>(line.size());
+            memcpy(contents.data() + offset + sizeof(DWORD), line.data(), line.size() * sizeof(wchar_t));
+        }
+
+        // Write a replacement file next to the current one
+        std::wstring path(_path), replacement(_path + L".tmp");
+        HANDLE file = CreateFile(replacement.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return;
+        DWORD written = 0;
+        BOOL success = WriteFile(file, contents.data(), static_cast<DWORD>(contents.size()), &written, NULL);
+        CloseHandle(file);
+        if (!success || written != contents.size()) {
+            DeleteFile(replacement.c_str());
+            return;
+        }
+
+        // Swap it in and reopen for appending
+        _close();
+        MoveFileEx(replacement.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+        _file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                           OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (_file == INVALID_HANDLE_VALUE) return;
+        SetFilePointer(_file, 0, NULL, FILE_END);
+        _path.swap(path);
+        _records = _entries.size();
+    }
+
+    void history::_close() {
+        if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+        _file = INVALID_HANDLE_VALUE;
+        _path.clear();
+    }
+}
@@ -0,0 +1,208 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Line layout implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Characters measured once and cached
+    static const size_t LAYOUT_Cached = 0x10000;
+
+    // Ranges taking no cells: combining marks, joiners and variation selectors
+    static const unsigned long LAYOUT_Zero[][2] = {
+        { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x0610, 0x061A }, { 0x064B, 0x065F },
+        { 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E }, { 0x1AB0, 0x1AFF }, { 0x1DC0, 0x1DFF },
+        { 0x200B, 0x200F }, { 0x202A, 0x202E }, { 0x2060, 0x2064 }, { 0x20D0, 0x20FF }, { 0xFE00, 0xFE0F },
+        { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF }, { 0xE0100, 0xE01EF }
+    };
+
+    // East Asian wide and fullwidth ranges taking two cells
+    static const unsigned long LAYOUT_Wide[][2] = {
+        { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC }, { 0x23F0, 0x23F0 },
+        { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 }, { 0x2648, 0x2653 }, { 0x267F, 0x267F },
+        { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 }, { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 },
+        { 0x26CE, 0x26CE }, { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+        { 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B }, { 0x2728, 0x2728 },
+        { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 }, { 0x2757, 0x2757 }, { 0x2795, 0x2797 },
+        { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF }, { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 },
+        { 0x2E80, 0x303E }, { 0x3041, 0x33FF }, { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF },
+        { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 }, { 0xFE30, 0xFE6F },
+        { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 }, { 0x1F300, 0x1F64F }, { 0x1F900, 0x1F9FF }, { 0x20000, 0x2FFFD },
+        { 0x30000, 0x3FFFD }
+    };
+
+    layout::layout(scrollback& source)
+        : _source(source), _first(0), _cursor(0), _columns(80) {
+        _widths.assign(LAYOUT_Cached, 0xFF);
+    }
+
+    void layout::width(size_t columns) {
+        columns = (std::max)(columns, static_cast<size_t>(1));
+        if (columns == _columns) return;
+
+        // Everything is stale, step() starts over from the newest line
+        _sync();
+        _columns = columns;
+        std::fill(_counts.begin(), _counts.end(), 0);
+        _cursor = _first + _counts.size();
+    }
+
+    size_t layout::rows(size_t index) {
+        scrollback::snapshot contents = _sync();
+        if (index < _first || index >= contents.end()) return 0;
+        size_t& count = _rows(index);
+        if (!count) {
+            const scrollback::line& entry = contents.at(index);
+            std::wstring text(entry.text.begin(), entry.text.end());
+            if (text.compare(0, 5, L"{\\rtf") == 0) {
+                std::wstring plain;
+                exporter::text(text, plain);
+                text.swap(plain);
+            }
+            count = wrap(text, _columns);
+        }
+        return count;
+    }
+
+    size_t layout::tail(size_t rows) {
+        // Walk back from the newest line until the rows are filled
+        size_t end = _sync().end(), index = end, filled = 0;
+        while (index > _first) {
+            size_t needed = this->rows(index - 1);
+            if (filled + needed > rows && index < end) break;
+            filled += needed;
+            index--;
+        }
+        return index;
+    }
+
+    size_t layout::fit(const std::vector<size_t>& lines, size_t rows) {
+        // Same walk as tail(), over the given lines only
+        size_t count = 0, filled = 0;
+        while (count < lines.size()) {
+            size_t needed = this->rows(lines[lines.size() - count - 1]);
+            if (filled + needed > rows && count > 0) break;
+            filled += needed;
+            count++;
+        }
+        return count;
+    }
+
+    bool layout::step(size_t budget) {
+        _sync();
+        for (; budget && _cursor > _first; budget--)
+            rows(--_cursor);
+        return _cursor > _first;
+    }
+
+    int layout::glyph(unsigned long c) {
+        if (c >= LAYOUT_Cached) return _measure(c);
+        unsigned char& cached = _widths[c];
+        if (cached == 0xFF) cached = static_cast<unsigned char>(_measure(c));
+        return cached;
+    }
+
+    size_t layout::wrap(const std::wstring& text, size_t columns, std::vector<size_t>* breaks) {
+        columns = (std::max)(columns, static_cast<size_t>(1));
+        size_t rows = 1, column = 0;
+        size_t space = std::wstring::npos;   // Where the row can break after the last space
+        size_t spaced = 0;                   // Cells used up to that point
+
+        for (size_t i = 0; i < text.size(); i++) {
+            unsigned long c = static_cast<unsigned long>(text[i]);
+            size_t next = i + 1;
+            if (c >= 0xD800 && c < 0xDC00 && next < text.size() && text[next] >= 0xDC00 && text[next] < 0xE000)
+                c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<unsigned long>(text[next++]) - 0xDC00);
+
+            // Hard line breaks, a trailing one does not start another row
+            if (c == L'\r' || c == L'\n') {
+                if (c == L'\r' && next < text.size() && text[next] == L'\n') next++;
+                if (next < text.size()) {
+                    rows++;
+                    if (breaks) breaks->push_back(next);
+                }
+                column = 0;
+                space = std::wstring::npos;
+                i = next - 1;
+                continue;
+            }
+
+            size_t cells = (c == L'\t') ? LAYOUT_Tab - column % LAYOUT_Tab : glyph(c);
+            if (column + cells > columns && column > 0) {
+                // Break after the last space when there is one, otherwise right here
+                rows++;
+                if (space != std::wstring::npos) {
+                    if (breaks) breaks->push_back(space);
+                    column -= spaced;
+                } else {
+                    if (breaks) breaks->push_back(i);
+                    column = 0;
+                }
+                space = std::wstring::npos;
+
+                // What moved down may still leave no room
+                if (column + cells > columns && column > 0) {
+                    rows++;
+                    if (breaks) breaks->push_back(i);
+                    column = 0;
+                }
+            }
+            column += (c == L'\t') ? LAYOUT_Tab - column % LAYOUT_Tab : cells;
+            if (c == L' ' || c == L'\t') {
+                space = next;
+                spaced = column;
+            }
+            i = next - 1;
+        }
+        return rows;
+    }
+
+    int layout::_measure(unsigned long c) {
+        if (c < 0x20 || (c >= 0x7F && c < 0xA0)) return 0;
+        if (c < 0x300) return 1;
+        for (size_t i = 0; i < sizeof(LAYOUT_Zero) / sizeof(LAYOUT_Zero[0]); i++)
+            if (c >= LAYOUT_Zero[i][0] && c <= LAYOUT_Zero[i][1]) return 0;
+
+        // Ranges are sorted, search for the last one starting at or before the character
+        size_t low = 0, high = sizeof(LAYOUT_Wide) / sizeof(LAYOUT_Wide[0]);
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (LAYOUT_Wide[middle][0] <= c) low = middle + 1;
+            else high = middle;
+        }
+        return (low > 0 && c <= LAYOUT_Wide[low - 1][1]) ? 2 : 1;
+    }
+
+    scrollback::snapshot layout::_sync() {
+        // Follow the scrollback, lines evicted from it are dropped here too
+        scrollback::snapshot contents = _source.take();
+        while (_first < contents.first() && !_counts.empty()) {
+            _counts.pop_front();
+            _first++;
+        }
+        if (_counts.empty()) _first = contents.first();
+        if (_cursor < _first) _cursor = _first;
+        if (_first + _counts.size() < contents.end())
+            _counts.resize(contents.end() - _first, 0);
+        return contents;
+    }
+}
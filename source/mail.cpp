@@ -20,45 +20,94 @@
  *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
  ***/
 
-#include "console.hpp"
+#include "core.hpp"
 
 namespace db
 {
-    mail::mail(int mailboxes) {
+    mail::mail(int mailboxes, memory_resource* memory) {
         _sem_filled = CreateSemaphore(NULL, 0, mailboxes, NULL);
         _sem_empty = CreateSemaphore(NULL, mailboxes, mailboxes, NULL);
+        _event_closed = CreateEvent(NULL, TRUE, FALSE, NULL);
         _next_empty = _next_filled = 0;
-        _boxes.resize(mailboxes);
+        _waiting = 0;
+        // Copies of a box fall back to the heap, so every box is made in place
+        _boxes.reserve(mailboxes);
+        for (int i = 0; i < mailboxes; i++) _boxes.push_back(box(allocator<wchar_t>(memory)));
+        _headers.resize(mailboxes);
     }
 
     bool mail::send(const string& mail, unsigned long timeout) {
-        // Wait for an empty mailbox
-        if (WaitForSingleObject(_sem_empty, timeout) != WAIT_OBJECT_0) return false;
+        return send(mail, header(), timeout);
+    }
+
+    bool mail::send(const string& mail, const header& info, unsigned long timeout) {
+        return static_cast<bool>(put(mail, info, timeout));
+    }
+
+    bool mail::recv(string& buffer, unsigned long timeout) {
+        header info;
+        return recv(buffer, info, timeout);
+    }
+
+    bool mail::recv(string& buffer, header& info, unsigned long timeout) {
+        return static_cast<bool>(take(buffer, info, timeout));
+    }
 
-        // Fill mailbox with message
+    result mail::put(const string& mail, const header& info, unsigned long timeout) {
+        // Wait for an empty mailbox, closing wins over a free one
+        HANDLE waits[] = { _event_closed, _sem_empty };
+        switch (WaitForMultipleObjects(2, waits, FALSE, timeout)) {
+        case WAIT_OBJECT_0 + 1: break;
+        case WAIT_OBJECT_0: return result(result::RESULT_Closed);
+        case WAIT_TIMEOUT: return result(timeout ? result::RESULT_Timeout : result::RESULT_Full);
+        default: return result(result::RESULT_Backend, GetLastError());
+        }
+
+        // Fill mailbox with message, handing it back if there is no room for the text
         _lock.acquire();
-        _boxes[_next_empty].assign(mail);
+        try {
+            _boxes[_next_empty].assign(mail.data(), mail.size());
+        } catch (const std::bad_alloc&) {
+            _lock.release();
+            ReleaseSemaphore(_sem_empty, 1, NULL);
+            return result(result::RESULT_Backend, ERROR_NOT_ENOUGH_MEMORY);
+        }
+        _headers[_next_empty] = info;
         _next_empty = (_next_empty + 1) % _boxes.size();
+        _waiting++;
         _lock.release();
 
         // Flag reader
         ReleaseSemaphore(_sem_filled, 1, NULL);
-        return true;
+        return result();
     }
 
-    bool mail::recv(string& buffer, unsigned long timeout) {
+    result mail::take(string& buffer, header& info, unsigned long timeout) {
         // Wait for a filled mailbox
-        if (WaitForSingleObject(_sem_filled, timeout) != WAIT_OBJECT_0) return false;
-        
+        HANDLE waits[] = { _event_closed, _sem_filled };
+        switch (WaitForMultipleObjects(2, waits, FALSE, timeout)) {
+        case WAIT_OBJECT_0 + 1: break;
+        case WAIT_OBJECT_0: return result(result::RESULT_Closed);
+        case WAIT_TIMEOUT: return result(result::RESULT_Timeout);
+        default: return result(result::RESULT_Backend, GetLastError());
+        }
+
         // Read mail in mailbox
         _lock.acquire();
-        buffer = _boxes[_next_filled];
+        buffer.assign(_boxes[_next_filled].data(), _boxes[_next_filled].size());
+        info = _headers[_next_filled];
         _next_filled = (_next_filled + 1) % _boxes.size();
+        _waiting--;
         _lock.release();
 
         // Flag writer
         ReleaseSemaphore(_sem_empty, 1, NULL);
-        return true;
+        return result();
+    }
+
+    void mail::close() {
+        // Everyone waiting, and everyone after, gives up
+        SetEvent(_event_closed);
     }
 
     bool mail::recv(message& message, unsigned long timeout) {
@@ -74,8 +123,10 @@ namespace db
                 // Read mail in mailbox
                 message.type = MESSAGE_Mail;
                 _lock.acquire();
-                message.mail = _boxes[_next_filled];
+                message.mail.assign(_boxes[_next_filled].data(), _boxes[_next_filled].size());
+                message.info = _headers[_next_filled];
                 _next_filled = (_next_filled + 1) % _boxes.size();
+                _waiting--;
                 _lock.release();
 
                 // Flag writer
@@ -100,5 +151,6 @@ namespace db
     mail::~mail() {
         CloseHandle(_sem_empty);
         CloseHandle(_sem_filled);
+        CloseHandle(_event_closed);
     }
 }
@@ -0,0 +1,156 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Markup template implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Colours known by name
+    static const struct {
+        const wchar_t* name;
+        COLORREF colour;
+    } MARKUP_Colours[] = {
+        { L"black", RGB(0, 0, 0) }, { L"red", RGB(255, 0, 0) }, { L"green", RGB(0, 192, 0) },
+        { L"blue", RGB(0, 0, 255) }, { L"yellow", RGB(255, 255, 0) }, { L"cyan", RGB(0, 255, 255) },
+        { L"magenta", RGB(255, 0, 255) }, { L"white", RGB(255, 255, 255) }, { L"gray", RGB(128, 128, 128) },
+        { NULL, 0 }
+    };
+
+    markup::markup(const std::wstring& layout)
+        : _size(0), _rich(false) {
+        // Both forms are built, which one is kept depends on whether any tag shows up
+        std::vector<std::wstring> plain(1), rich(1);
+        std::vector<std::wstring> open;
+        std::vector<style> looks(1);
+        std::vector<COLORREF> colours;
+
+        for (size_t i = 0; i < layout.size(); i++) {
+            wchar_t c = layout[i];
+            wchar_t next = (i + 1 < layout.size()) ? layout[i + 1] : 0;
+
+            if (c == L'<' && next != L'<') {
+                size_t end = layout.find(L'>', i);
+                if (end == std::wstring::npos) throw win_exception(ERROR_INVALID_PARAMETER);
+                std::wstring tag = layout.substr(i + 1, end - i - 1);
+                i = end;
+
+                // Closing tags have to match the innermost open one
+                if (!tag.empty() && tag[0] == L'/') {
+                    if (open.empty() || open.back() != tag.substr(1)) throw win_exception(ERROR_INVALID_PARAMETER);
+                    open.pop_back();
+                    looks.pop_back();
+                    rich.back().append(L"}");
+                    continue;
+                }
+
+                style look = looks.back();
+                COLORREF colour = 0;
+                if (tag == L"b") {
+                    look.bold = true;
+                    rich.back().append(L"{\\b ");
+                } else if (_colour(tag, colour)) {
+                    look.colour = colour;
+                    size_t index = std::find(colours.begin(), colours.end(), colour) - colours.begin();
+                    if (index == colours.size()) colours.push_back(colour);
+                    rich.back().append(L"{\\cf").append(std::to_wstring(static_cast<unsigned long long>(index + 1))).append(L" ");
+                } else throw win_exception(ERROR_INVALID_PARAMETER);
+
+                open.push_back(tag);
+                looks.push_back(look);
+                style_table::id used = style_table::intern(look);
+                if (std::find(_styles.begin(), _styles.end(), used) == _styles.end()) _styles.push_back(used);
+                _rich = true;
+                continue;
+            }
+
+            // Argument slots start new pieces
+            if (c == L'{' && next == L'}') {
+                plain.push_back(std::wstring());
+                rich.push_back(std::wstring());
+                i++;
+                continue;
+            }
+            if ((c == L'{' || c == L'}') && next != c) throw win_exception(ERROR_INVALID_PARAMETER);
+            if (c == L'<' || c == L'{' || c == L'}') i++;
+
+            plain.back().push_back(c);
+            size_t start = rich.back().size();
+            rich.back().push_back(c);
+            _escape(rich.back(), start);
+        }
+        if (!open.empty()) throw win_exception(ERROR_INVALID_PARAMETER);
+
+        if (_rich) {
+            _pieces.swap(rich);
+            _header.assign(L"{\\rtf1\\ansi\\deff0{\\colortbl;");
+            for (size_t i = 0; i < colours.size(); i++)
+                _header.append(L"\\red").append(std::to_wstring(static_cast<unsigned long long>(GetRValue(colours[i]))))
+                       .append(L"\\green").append(std::to_wstring(static_cast<unsigned long long>(GetGValue(colours[i]))))
+                       .append(L"\\blue").append(std::to_wstring(static_cast<unsigned long long>(GetBValue(colours[i])))).append(L";");
+            _header.append(L"}");
+            _footer.assign(L"}");
+        } else _pieces.swap(plain);
+
+        _size = _header.size() + _footer.size();
+        for (size_t i = 0; i < _pieces.size(); i++)
+            _size += _pieces[i].size();
+    }
+
+    void markup::_escape(std::wstring& out, size_t start) {
+        // Most text needs nothing done to it
+        size_t i = start;
+        for (; i < out.size(); i++) {
+            wchar_t c = out[i];
+            if (c == L'\\' || c == L'{' || c == L'}' || c == L'\r' || c == L'\n' || c == L'\t' || c >= 0x80) break;
+        }
+        if (i == out.size()) return;
+
+        std::wstring tail = out.substr(i);
+        out.resize(i);
+        for (size_t j = 0; j < tail.size(); j++) {
+            wchar_t c = tail[j];
+            if (c == L'\\' || c == L'{' || c == L'}') { out.push_back(L'\\'); out.push_back(c); }
+            else if (c == L'\n') out.append(L"\\par\n");
+            else if (c == L'\r') continue;
+            else if (c == L'\t') out.append(L"\\tab ");
+            else if (c >= 0x80) out.append(L"\\u").append(std::to_wstring(static_cast<long long>(static_cast<short>(c)))).append(L"?");
+            else out.push_back(c);
+        }
+    }
+
+    bool markup::_colour(const std::wstring& name, COLORREF& colour) {
+        for (size_t i = 0; MARKUP_Colours[i].name; i++) {
+            if (name == MARKUP_Colours[i].name) {
+                colour = MARKUP_Colours[i].colour;
+                return true;
+            }
+        }
+
+        // Anything else has to be #RRGGBB
+        if (name.size() != 7 || name[0] != L'#') return false;
+        for (size_t i = 1; i < name.size(); i++)
+            if (!iswxdigit(name[i])) return false;
+        unsigned long value = wcstoul(name.c_str() + 1, NULL, 16);
+        colour = RGB((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF);
+        return true;
+    }
+}
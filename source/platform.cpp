@@ -0,0 +1,656 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Platform implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#ifndef _WIN32
+
+#include "platform.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <cerrno>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    //
+    // Every waitable handle is guarded by one lock and one condition, so a
+    // wait on several handles sees them change together. Threads are
+    // signalled when they exit, and their handle stays valid until both the
+    // thread and whoever created it are done with it.
+    //
+    enum kind { HANDLE_Event, HANDLE_Semaphore, HANDLE_Thread, HANDLE_File };
+
+    struct object {
+        kind type;
+        long count;                 // Signalled while above zero
+        long maximum;
+        bool manual;                // Events staying set for every waiter
+        int descriptor;             // Files only
+        std::atomic<int> references;
+    };
+
+    struct start {
+        object* thread;
+        LPTHREAD_START_ROUTINE routine;
+        void* parameter;
+    };
+
+    // Never destroyed, threads that were only closed may still be finishing at exit
+    std::mutex& guard() { static std::mutex* instance = new std::mutex; return *instance; }
+    std::condition_variable& changed() { static std::condition_variable* instance = new std::condition_variable; return *instance; }
+
+    thread_local DWORD last_error = ERROR_SUCCESS;
+    std::atomic<DWORD> thread_ids(0);
+    thread_local DWORD thread_id = 0;
+
+    object* waitable(HANDLE handle) {
+        object* target = static_cast<object*>(handle);
+        return (target && handle != INVALID_HANDLE_VALUE && target->type != HANDLE_File) ? target : NULL;
+    }
+
+    object* file(HANDLE handle) {
+        object* target = static_cast<object*>(handle);
+        return (target && handle != INVALID_HANDLE_VALUE && target->type == HANDLE_File) ? target : NULL;
+    }
+
+    object* create(kind type, long count, long maximum, bool manual) {
+        object* fresh = new object;
+        fresh->type = type;
+        fresh->count = count;
+        fresh->maximum = maximum;
+        fresh->manual = manual;
+        fresh->descriptor = -1;
+        fresh->references = 1;
+        return fresh;
+    }
+
+    void release(object* target) {
+        if (--target->references == 0) {
+            if (target->descriptor >= 0) ::close(target->descriptor);
+            delete target;
+        }
+    }
+
+    DWORD translate(int error) {
+        switch (error) {
+        case 0: return ERROR_SUCCESS;
+        case ENOENT: return ERROR_FILE_NOT_FOUND;
+        case ENOTDIR: return ERROR_PATH_NOT_FOUND;
+        case EMFILE: case ENFILE: return ERROR_TOO_MANY_OPEN_FILES;
+        case EACCES: case EPERM: case EROFS: return ERROR_ACCESS_DENIED;
+        case EBADF: return ERROR_INVALID_HANDLE;
+        case ENOMEM: return ERROR_NOT_ENOUGH_MEMORY;
+        case EEXIST: return ERROR_FILE_EXISTS;
+        case ENOSPC: return ERROR_DISK_FULL;
+        case EBUSY: return ERROR_BUSY;
+        case ETIMEDOUT: return ERROR_TIMEOUT;
+        default: return ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    BOOL fail(DWORD error) {
+        last_error = error;
+        return FALSE;
+    }
+
+    std::string narrow(LPCWSTR text) {
+        std::string result;
+        int size = WideCharToMultiByte(CP_UTF8, 0, text, -1, NULL, 0, NULL, NULL);
+        if (size > 1) {
+            result.resize(static_cast<size_t>(size));
+            WideCharToMultiByte(CP_UTF8, 0, text, -1, &result[0], size, NULL, NULL);
+            result.resize(static_cast<size_t>(size - 1));
+        }
+        return result;
+    }
+
+    // Takes a signalled handle, or just looks when only checking
+    bool signalled(object* target, bool take) {
+        if (target->count <= 0) return false;
+        if (take && !target->manual) target->count--;
+        return true;
+    }
+
+    void* thread_start(void* parameter) {
+        start* begin = static_cast<start*>(parameter);
+        begin->routine(begin->parameter);
+        {
+            std::lock_guard<std::mutex> hold(guard());
+            begin->thread->count = 1;
+        }
+        changed().notify_all();
+        release(begin->thread);
+        delete begin;
+        return NULL;
+    }
+}
+
+//
+// Errors
+//
+
+DWORD GetLastError() {
+    return last_error;
+}
+
+void SetLastError(DWORD error) {
+    last_error = error;
+}
+
+DWORD FormatMessageA(DWORD flags, LPCVOID, DWORD error, DWORD, LPSTR buffer, DWORD, void*) {
+    // Only allocated messages are asked for
+    if (!(flags & FORMAT_MESSAGE_ALLOCATE_BUFFER)) return fail(ERROR_INVALID_PARAMETER);
+    char text[64];
+    int length = std::snprintf(text, sizeof(text), "System error %u.", error);
+    char* message = static_cast<char*>(std::malloc(static_cast<size_t>(length) + 1));
+    if (!message) return fail(ERROR_NOT_ENOUGH_MEMORY);
+    std::memcpy(message, text, static_cast<size_t>(length) + 1);
+    *reinterpret_cast<char**>(buffer) = message;
+    return static_cast<DWORD>(length);
+}
+
+void* LocalFree(void* memory) {
+    std::free(memory);
+    return NULL;
+}
+
+//
+// Critical sections
+//
+
+void InitializeCriticalSection(CRITICAL_SECTION* section) {
+    // Critical sections may be entered again by the thread holding them
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&section->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+void DeleteCriticalSection(CRITICAL_SECTION* section) {
+    pthread_mutex_destroy(&section->mutex);
+}
+
+void EnterCriticalSection(CRITICAL_SECTION* section) {
+    pthread_mutex_lock(&section->mutex);
+}
+
+BOOL TryEnterCriticalSection(CRITICAL_SECTION* section) {
+    return pthread_mutex_trylock(&section->mutex) == 0;
+}
+
+void LeaveCriticalSection(CRITICAL_SECTION* section) {
+    pthread_mutex_unlock(&section->mutex);
+}
+
+BOOL InitOnceExecuteOnce(INIT_ONCE* once, PINIT_ONCE_FN function, void* parameter, void** context) {
+    // The pointer goes from zero to one while the function runs and to two once it succeeded
+    void* const idle = reinterpret_cast<void*>(0);
+    void* const running = reinterpret_cast<void*>(1);
+    void* const done = reinterpret_cast<void*>(2);
+    if (__atomic_load_n(&once->Ptr, __ATOMIC_ACQUIRE) == done) return TRUE;
+    for (;;) {
+        void* state = idle;
+        if (__atomic_compare_exchange_n(&once->Ptr, &state, running, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            BOOL succeeded = function(once, parameter, context);
+            __atomic_store_n(&once->Ptr, succeeded ? done : idle, __ATOMIC_RELEASE);
+            return succeeded;
+        }
+        if (state == done) return TRUE;
+        sched_yield();
+    }
+}
+
+//
+// Waitable handles
+//
+
+HANDLE CreateEvent(void*, BOOL manual, BOOL initial, LPCWSTR) {
+    return create(HANDLE_Event, initial ? 1 : 0, 1, manual != FALSE);
+}
+
+BOOL SetEvent(HANDLE event) {
+    object* target = waitable(event);
+    if (!target) return fail(ERROR_INVALID_HANDLE);
+    {
+        std::lock_guard<std::mutex> hold(guard());
+        target->count = 1;
+    }
+    changed().notify_all();
+    return TRUE;
+}
+
+BOOL ResetEvent(HANDLE event) {
+    object* target = waitable(event);
+    if (!target) return fail(ERROR_INVALID_HANDLE);
+    std::lock_guard<std::mutex> hold(guard());
+    target->count = 0;
+    return TRUE;
+}
+
+HANDLE CreateSemaphore(void*, LONG initial, LONG maximum, LPCWSTR) {
+    if (maximum <= 0 || initial < 0 || initial > maximum) {
+        last_error = ERROR_INVALID_PARAMETER;
+        return NULL;
+    }
+    return create(HANDLE_Semaphore, initial, maximum, false);
+}
+
+BOOL ReleaseSemaphore(HANDLE semaphore, LONG count, LONG* previous) {
+    object* target = waitable(semaphore);
+    if (!target || target->type != HANDLE_Semaphore) return fail(ERROR_INVALID_HANDLE);
+    {
+        std::lock_guard<std::mutex> hold(guard());
+        if (count <= 0 || target->count + count > target->maximum) return fail(ERROR_INVALID_PARAMETER);
+        if (previous) *previous = target->count;
+        target->count += count;
+    }
+    changed().notify_all();
+    return TRUE;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD timeout) {
+    return WaitForMultipleObjects(1, &handle, FALSE, timeout);
+}
+
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL all, DWORD timeout) {
+    for (DWORD i = 0; i < count; i++)
+        if (!waitable(handles[i])) { last_error = ERROR_INVALID_HANDLE; return WAIT_FAILED; }
+
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout == INFINITE ? 0 : timeout);
+    std::unique_lock<std::mutex> hold(guard());
+    for (;;) {
+        if (all) {
+            // Nothing is taken until everything can be
+            bool ready = true;
+            for (DWORD i = 0; i < count && ready; i++) ready = signalled(waitable(handles[i]), false);
+            if (ready) {
+                for (DWORD i = 0; i < count; i++) signalled(waitable(handles[i]), true);
+                return WAIT_OBJECT_0;
+            }
+        } else {
+            for (DWORD i = 0; i < count; i++)
+                if (signalled(waitable(handles[i]), true)) return WAIT_OBJECT_0 + i;
+        }
+
+        if (timeout == INFINITE) changed().wait(hold);
+        else if (changed().wait_until(hold, deadline) == std::cv_status::timeout) {
+            // One last look, the handle may have been signalled right at the deadline
+            if (!all) {
+                for (DWORD i = 0; i < count; i++)
+                    if (signalled(waitable(handles[i]), true)) return WAIT_OBJECT_0 + i;
+            }
+            return WAIT_TIMEOUT;
+        }
+    }
+}
+
+BOOL CloseHandle(HANDLE handle) {
+    object* target = static_cast<object*>(handle);
+    if (!target || handle == INVALID_HANDLE_VALUE) return fail(ERROR_INVALID_HANDLE);
+    release(target);
+    return TRUE;
+}
+
+//
+// Threads
+//
+
+HANDLE CreateThread(void*, size_t stack, LPTHREAD_START_ROUTINE routine, void* parameter, DWORD, DWORD* id) {
+    object* thread = create(HANDLE_Thread, 0, 1, true);
+    thread->references = 2;
+    start* begin = new start;
+    begin->thread = thread;
+    begin->routine = routine;
+    begin->parameter = parameter;
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    if (stack) pthread_attr_setstacksize(&attributes, stack);
+    pthread_t created;
+    int error = pthread_create(&created, &attributes, thread_start, begin);
+    pthread_attr_destroy(&attributes);
+    if (error) {
+        delete begin;
+        delete thread;
+        last_error = translate(error);
+        return NULL;
+    }
+    if (id) *id = 0;
+    return thread;
+}
+
+DWORD GetCurrentThreadId() {
+    // Numbered on first use, never zero
+    if (!thread_id) thread_id = ++thread_ids;
+    return thread_id;
+}
+
+void Sleep(DWORD milliseconds) {
+    if (!milliseconds) sched_yield();
+    else {
+        timespec duration = { static_cast<time_t>(milliseconds / 1000), static_cast<long>(milliseconds % 1000) * 1000000L };
+        while (nanosleep(&duration, &duration) != 0 && errno == EINTR) {}
+    }
+}
+
+BOOL SwitchToThread() {
+    return sched_yield() == 0;
+}
+
+void GetSystemInfo(SYSTEM_INFO* info) {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    info->dwPageSize = static_cast<DWORD>(sysconf(_SC_PAGESIZE));
+    info->dwNumberOfProcessors = static_cast<DWORD>(processors > 0 ? processors : 1);
+}
+
+DWORD TlsAlloc() {
+    pthread_key_t key;
+    if (pthread_key_create(&key, NULL) != 0) return TLS_OUT_OF_INDEXES;
+    return static_cast<DWORD>(key);
+}
+
+BOOL TlsFree(DWORD index) {
+    return pthread_key_delete(static_cast<pthread_key_t>(index)) == 0;
+}
+
+void* TlsGetValue(DWORD index) {
+    return pthread_getspecific(static_cast<pthread_key_t>(index));
+}
+
+BOOL TlsSetValue(DWORD index, void* value) {
+    return pthread_setspecific(static_cast<pthread_key_t>(index), value) == 0;
+}
+
+//
+// Message queues
+//
+
+BOOL PeekMessage(MSG*, HWND, UINT, UINT, UINT) {
+    return FALSE;
+}
+
+BOOL PostMessage(HWND, UINT, WPARAM, LPARAM) {
+    return fail(ERROR_INVALID_WINDOW_HANDLE);
+}
+
+DWORD MsgWaitForMultipleObjectsEx(DWORD count, const HANDLE* handles, DWORD timeout, DWORD, DWORD) {
+    if (!count) {
+        Sleep(timeout == INFINITE ? 0 : timeout);
+        return WAIT_TIMEOUT;
+    }
+    return WaitForMultipleObjects(count, handles, FALSE, timeout);
+}
+
+//
+// Files
+//
+
+HANDLE CreateFile(LPCWSTR path, DWORD access, DWORD, void*, DWORD disposition, DWORD, HANDLE) {
+    int flags = O_CLOEXEC;
+    if ((access & GENERIC_READ) && (access & GENERIC_WRITE)) flags |= O_RDWR;
+    else if (access & GENERIC_WRITE) flags |= O_WRONLY;
+    else flags |= O_RDONLY;
+    switch (disposition) {
+    case CREATE_NEW: flags |= O_CREAT | O_EXCL; break;
+    case CREATE_ALWAYS: flags |= O_CREAT | O_TRUNC; break;
+    case OPEN_ALWAYS: flags |= O_CREAT; break;
+    case TRUNCATE_EXISTING: flags |= O_TRUNC; break;
+    case OPEN_EXISTING: break;
+    default:
+        last_error = ERROR_INVALID_PARAMETER;
+        return INVALID_HANDLE_VALUE;
+    }
+
+    int descriptor = ::open(narrow(path).c_str(), flags, 0666);
+    if (descriptor < 0) {
+        last_error = translate(errno);
+        return INVALID_HANDLE_VALUE;
+    }
+    object* opened = create(HANDLE_File, 0, 0, false);
+    opened->descriptor = descriptor;
+    return opened;
+}
+
+BOOL ReadFile(HANDLE handle, void* buffer, DWORD size, DWORD* read, void*) {
+    object* target = file(handle);
+    if (read) *read = 0;
+    if (!target) return fail(ERROR_INVALID_HANDLE);
+    ssize_t count;
+    while ((count = ::read(target->descriptor, buffer, size)) < 0 && errno == EINTR) {}
+    if (count < 0) return fail(translate(errno));
+    if (read) *read = static_cast<DWORD>(count);
+    return TRUE;
+}
+
+BOOL WriteFile(HANDLE handle, const void* buffer, DWORD size, DWORD* written, void*) {
+    object* target = file(handle);
+    if (written) *written = 0;
+    if (!target) return fail(ERROR_INVALID_HANDLE);
+
+    // Writes complete unless the disk fails
+    const char* from = static_cast<const char*>(buffer);
+    DWORD done = 0;
+    while (done < size) {
+        ssize_t count = ::write(target->descriptor, from + done, size - done);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            if (written) *written = done;
+            return fail(translate(errno));
+        }
+        done += static_cast<DWORD>(count);
+    }
+    if (written) *written = done;
+    return TRUE;
+}
+
+BOOL GetFileSizeEx(HANDLE handle, LARGE_INTEGER* size) {
+    object* target = file(handle);
+    if (!target) return fail(ERROR_INVALID_HANDLE);
+    struct stat status;
+    if (fstat(target->descriptor, &status) != 0) return fail(translate(errno));
+    size->QuadPart = static_cast<LONGLONG>(status.st_size);
+    return TRUE;
+}
+
+BOOL SetFilePointerEx(HANDLE handle, LARGE_INTEGER distance, LARGE_INTEGER* position, DWORD method) {
+    object* target = file(handle);
+    if (!target) return fail(ERROR_INVALID_HANDLE);
+    int whence = (method == FILE_BEGIN) ? SEEK_SET : (method == FILE_CURRENT) ? SEEK_CUR : SEEK_END;
+    off_t moved = ::lseek(target->descriptor, static_cast<off_t>(distance.QuadPart), whence);
+    if (moved < 0) return fail(translate(errno));
+    if (position) position->QuadPart = static_cast<LONGLONG>(moved);
+    return TRUE;
+}
+
+DWORD SetFilePointer(HANDLE handle, LONG distance, LONG* high, DWORD method) {
+    LARGE_INTEGER move, position;
+    move.QuadPart = high ? ((static_cast<LONGLONG>(*high) << 32) | static_cast<DWORD>(distance)) : distance;
+    if (!SetFilePointerEx(handle, move, &position, method)) return INVALID_SET_FILE_POINTER;
+    if (high) *high = static_cast<LONG>(position.QuadPart >> 32);
+    return static_cast<DWORD>(position.QuadPart);
+}
+
+BOOL SetEndOfFile(HANDLE handle) {
+    object* target = file(handle);
+    if (!target) return fail(ERROR_INVALID_HANDLE);
+    off_t position = ::lseek(target->descriptor, 0, SEEK_CUR);
+    if (position < 0 || ::ftruncate(target->descriptor, position) != 0) return fail(translate(errno));
+    return TRUE;
+}
+
+BOOL FlushFileBuffers(HANDLE handle) {
+    object* target = file(handle);
+    if (!target) return fail(ERROR_INVALID_HANDLE);
+    if (::fsync(target->descriptor) != 0) return fail(translate(errno));
+    return TRUE;
+}
+
+BOOL DeleteFile(LPCWSTR path) {
+    if (::unlink(narrow(path).c_str()) != 0) return fail(translate(errno));
+    return TRUE;
+}
+
+BOOL MoveFileEx(LPCWSTR from, LPCWSTR to, DWORD flags) {
+    std::string target = narrow(to);
+    if (!(flags & MOVEFILE_REPLACE_EXISTING) && ::access(target.c_str(), F_OK) == 0) return fail(ERROR_ALREADY_EXISTS);
+    if (::rename(narrow(from).c_str(), target.c_str()) != 0) return fail(translate(errno));
+    return TRUE;
+}
+
+//
+// Time
+//
+
+DWORD GetTickCount() {
+    return static_cast<DWORD>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* count) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    count->QuadPart = static_cast<LONGLONG>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency) {
+    frequency->QuadPart = 1000000000LL;
+    return TRUE;
+}
+
+void GetSystemTimeAsFileTime(FILETIME* time) {
+    // File times count 100 nanosecond intervals since 1601
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    unsigned long long intervals = (static_cast<unsigned long long>(now.tv_sec) + 11644473600ULL) * 10000000ULL + now.tv_nsec / 100;
+    time->dwLowDateTime = static_cast<DWORD>(intervals & 0xFFFFFFFF);
+    time->dwHighDateTime = static_cast<DWORD>(intervals >> 32);
+}
+
+BOOL FileTimeToSystemTime(const FILETIME* time, SYSTEMTIME* system) {
+    unsigned long long intervals = (static_cast<unsigned long long>(time->dwHighDateTime) << 32) | time->dwLowDateTime;
+    if (intervals < 11644473600ULL * 10000000ULL) return fail(ERROR_INVALID_PARAMETER);
+    time_t seconds = static_cast<time_t>(intervals / 10000000ULL - 11644473600ULL);
+    tm broken;
+    if (!gmtime_r(&seconds, &broken)) return fail(ERROR_INVALID_PARAMETER);
+    system->wYear = static_cast<WORD>(broken.tm_year + 1900);
+    system->wMonth = static_cast<WORD>(broken.tm_mon + 1);
+    system->wDayOfWeek = static_cast<WORD>(broken.tm_wday);
+    system->wDay = static_cast<WORD>(broken.tm_mday);
+    system->wHour = static_cast<WORD>(broken.tm_hour);
+    system->wMinute = static_cast<WORD>(broken.tm_min);
+    system->wSecond = static_cast<WORD>(broken.tm_sec);
+    system->wMilliseconds = static_cast<WORD>((intervals / 10000ULL) % 1000);
+    return TRUE;
+}
+
+BOOL SystemTimeToTzSpecificLocalTime(void*, const SYSTEMTIME* universal, SYSTEMTIME* local) {
+    // Only the current time zone is supported
+    tm broken = tm();
+    broken.tm_year = universal->wYear - 1900;
+    broken.tm_mon = universal->wMonth - 1;
+    broken.tm_mday = universal->wDay;
+    broken.tm_hour = universal->wHour;
+    broken.tm_min = universal->wMinute;
+    broken.tm_sec = universal->wSecond;
+    time_t seconds = timegm(&broken);
+    if (!localtime_r(&seconds, &broken)) return fail(ERROR_INVALID_PARAMETER);
+    local->wYear = static_cast<WORD>(broken.tm_year + 1900);
+    local->wMonth = static_cast<WORD>(broken.tm_mon + 1);
+    local->wDayOfWeek = static_cast<WORD>(broken.tm_wday);
+    local->wDay = static_cast<WORD>(broken.tm_mday);
+    local->wHour = static_cast<WORD>(broken.tm_hour);
+    local->wMinute = static_cast<WORD>(broken.tm_min);
+    local->wSecond = static_cast<WORD>(broken.tm_sec);
+    local->wMilliseconds = universal->wMilliseconds;
+    return TRUE;
+}
+
+//
+// Text
+//
+
+int MultiByteToWideChar(UINT page, DWORD, LPCSTR text, int length, LPWSTR out, int size) {
+    // Wide characters hold a whole code point, malformed sequences become U+FFFD
+    if (page != CP_UTF8 || !text) { last_error = ERROR_INVALID_PARAMETER; return 0; }
+    const unsigned char* from = reinterpret_cast<const unsigned char*>(text);
+    size_t count = (length < 0) ? std::strlen(text) + 1 : static_cast<size_t>(length);
+    int produced = 0;
+    for (size_t i = 0; i < count;) {
+        unsigned char lead = from[i];
+        unsigned long point;
+        size_t extra = (lead < 0x80) ? 0 : (lead >= 0xC2 && lead < 0xE0) ? 1 : (lead >= 0xE0 && lead < 0xF0) ? 2 : (lead >= 0xF0 && lead < 0xF5) ? 3 : 4;
+        if (extra == 4 || i + extra >= count + (extra ? 0 : 1)) {
+            point = 0xFFFD;
+            i++;
+        } else {
+            point = (extra == 0) ? lead : lead & (0x3F >> extra);
+            size_t j = 1;
+            for (; j <= extra && (from[i + j] & 0xC0) == 0x80; j++) point = (point << 6) | (from[i + j] & 0x3F);
+            if (j <= extra) point = 0xFFFD;
+            i += j;
+        }
+        if (out) {
+            if (produced >= size) { last_error = ERROR_INVALID_PARAMETER; return 0; }
+            out[produced] = static_cast<wchar_t>(point);
+        }
+        produced++;
+    }
+    return produced;
+}
+
+int WideCharToMultiByte(UINT page, DWORD, LPCWSTR text, int length, LPSTR out, int size, LPCSTR, BOOL*) {
+    if (page != CP_UTF8 || !text) { last_error = ERROR_INVALID_PARAMETER; return 0; }
+    size_t count = (length < 0) ? std::wcslen(text) + 1 : static_cast<size_t>(length);
+    int produced = 0;
+    for (size_t i = 0; i < count; i++) {
+        unsigned long point = static_cast<unsigned long>(text[i]);
+        if (point > 0x10FFFF || (point >= 0xD800 && point < 0xE000)) point = 0xFFFD;
+        char bytes[4];
+        int used;
+        if (point < 0x80) { bytes[0] = static_cast<char>(point); used = 1; }
+        else if (point < 0x800) { bytes[0] = static_cast<char>(0xC0 | (point >> 6)); used = 2; }
+        else if (point < 0x10000) { bytes[0] = static_cast<char>(0xE0 | (point >> 12)); used = 3; }
+        else { bytes[0] = static_cast<char>(0xF0 | (point >> 18)); used = 4; }
+        for (int j = 1; j < used; j++) bytes[j] = static_cast<char>(0x80 | ((point >> (6 * (used - 1 - j))) & 0x3F));
+        if (out) {
+            if (produced + used > size) { last_error = ERROR_INVALID_PARAMETER; return 0; }
+            std::memcpy(out + produced, bytes, static_cast<size_t>(used));
+        }
+        produced += used;
+    }
+    return produced;
+}
+
+#endif
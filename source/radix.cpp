@@ -0,0 +1,305 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Radix tree implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    radix::radix() {
+        clear();
+    }
+
+    radix::~radix() {
+    }
+
+    void radix::insert(const std::wstring& key, rank value) {
+        unsigned current = 0;
+        size_t offset = 0;
+
+        while (offset < key.size()) {
+            unsigned child = _child(current, key[offset]);
+
+            // No edge starts with this character, hang the remainder off a new leaf
+            if (child == NODE_None) {
+                unsigned leaf = _allocate(key.substr(offset), current);
+                std::vector<unsigned>& children = _nodes[current].children;
+                children.insert(children.begin() + _slot(current, key[offset]), leaf);
+                current = leaf;
+                break;
+            }
+
+            // Measure how much of the edge label matches
+            const std::wstring& label = _nodes[child].label;
+            size_t common = 0;
+            while (common < label.size() && offset + common < key.size() &&
+                   label[common] == key[offset + common]) common++;
+
+            // Whole edge matched, keep descending
+            if (common == label.size()) {
+                current = child;
+                offset += common;
+                continue;
+            }
+
+            // Split the edge at the point of divergence
+            size_t slot = _slot(current, key[offset]);
+            unsigned middle = _allocate(label.substr(0, common), current);
+            _nodes[current].children[slot] = middle;
+            _nodes[child].label.erase(0, common);
+            _nodes[child].parent = middle;
+            _nodes[middle].children.push_back(child);
+            _nodes[middle].best = _nodes[child].best;
+            current = middle;
+            offset += common;
+        }
+
+        // Mark the key as present
+        if (_nodes[current].value == 0) _size++;
+        _nodes[current].value = value;
+        _refresh(current);
+    }
+
+    bool radix::erase(const std::wstring& key) {
+        unsigned current = _exact(key);
+        if (current == NODE_None || _nodes[current].value == 0) return false;
+        _nodes[current].value = 0;
+        _size--;
+
+        // Prune leaves that no longer terminate a key
+        while (current != 0 && _nodes[current].value == 0 && _nodes[current].children.empty()) {
+            unsigned parent = _nodes[current].parent;
+            std::vector<unsigned>& children = _nodes[parent].children;
+            children.erase(children.begin() + _slot(parent, _nodes[current].label[0]));
+            _free(current);
+            current = parent;
+        }
+
+        // Fold a pass-through node into its only child
+        if (current != 0 && _nodes[current].value == 0 && _nodes[current].children.size() == 1) {
+            unsigned child = _nodes[current].children[0];
+            unsigned parent = _nodes[current].parent;
+            _nodes[child].label.insert(0, _nodes[current].label);
+            _nodes[child].parent = parent;
+            _nodes[parent].children[_slot(parent, _nodes[current].label[0])] = child;
+            _free(current);
+            current = parent;
+        }
+
+        _refresh(current);
+        return true;
+    }
+
+    bool radix::find(const std::wstring& key, rank& value) const {
+        unsigned current = _exact(key);
+        if (current == NODE_None || _nodes[current].value == 0) return false;
+        value = _nodes[current].value;
+        return true;
+    }
+
+    bool radix::previous(const std::wstring& prefix, rank below, std::wstring& key, rank& value) const {
+        std::wstring path;
+        unsigned subtree = _locate(prefix, path);
+        if (subtree == NODE_None) return false;
+
+        unsigned found = _search(subtree, below);
+        if (found == NODE_None) return false;
+
+        key = _key(found);
+        value = _nodes[found].value;
+        return true;
+    }
+
+    size_t radix::complete(const std::wstring& prefix, std::vector<std::wstring>& keys, size_t limit) const {
+        std::wstring path;
+        unsigned subtree = _locate(prefix, path);
+        if (subtree == NODE_None) return 0;
+
+        size_t before = keys.size();
+        _collect(subtree, path, keys, before + limit);
+        return keys.size() - before;
+    }
+
+    void radix::clear() {
+        _nodes.clear();
+        _unused.clear();
+        _size = 0;
+        _allocate(std::wstring(), NODE_None);
+    }
+
+    unsigned radix::_allocate(const std::wstring& label, unsigned parent) {
+        unsigned index;
+        if (!_unused.empty()) {
+            index = _unused.back();
+            _unused.pop_back();
+        } else {
+            index = static_cast<unsigned>(_nodes.size());
+            _nodes.push_back(node());
+        }
+
+        node& fresh = _nodes[index];
+        fresh.label = label;
+        fresh.children.clear();
+        fresh.parent = parent;
+        fresh.value = 0;
+        fresh.best = 0;
+        return index;
+    }
+
+    void radix::_free(unsigned index) {
+        node& dead = _nodes[index];
+        std::wstring().swap(dead.label);
+        std::vector<unsigned>().swap(dead.children);
+        _unused.push_back(index);
+    }
+
+    size_t radix::_slot(unsigned index, wchar_t first) const {
+        // Children are kept sorted by the first character of their label
+        const std::vector<unsigned>& children = _nodes[index].children;
+        size_t low = 0, high = children.size();
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (_nodes[children[middle]].label[0] < first) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    }
+
+    unsigned radix::_child(unsigned index, wchar_t first) const {
+        const std::vector<unsigned>& children = _nodes[index].children;
+        size_t slot = _slot(index, first);
+        if (slot < children.size() && _nodes[children[slot]].label[0] == first)
+            return children[slot];
+        return NODE_None;
+    }
+
+    unsigned radix::_locate(const std::wstring& prefix, std::wstring& path) const {
+        unsigned current = 0;
+        size_t offset = 0;
+
+        while (offset < prefix.size()) {
+            unsigned child = _child(current, prefix[offset]);
+            if (child == NODE_None) return NODE_None;
+
+            // The prefix may end part way through an edge
+            const std::wstring& label = _nodes[child].label;
+            size_t length = (std::min)(label.size(), prefix.size() - offset);
+            if (label.compare(0, length, prefix, offset, length) != 0) return NODE_None;
+
+            path.append(label);
+            offset += length;
+            current = child;
+        }
+
+        return current;
+    }
+
+    unsigned radix::_exact(const std::wstring& key) const {
+        std::wstring path;
+        unsigned found = _locate(key, path);
+        return (found != NODE_None && path.size() == key.size()) ? found : NODE_None;
+    }
+
+    unsigned radix::_search(unsigned index, rank below) const {
+        unsigned winner = NODE_None;
+        rank top = 0;
+
+        std::vector<unsigned> pending(1, index);
+        while (!pending.empty()) {
+            unsigned current = pending.back(); pending.pop_back();
+            const node& candidate = _nodes[current];
+
+            // Nothing in this subtree can beat the current winner
+            if (candidate.best <= top) continue;
+
+            // The whole subtree qualifies, so its best key is the answer for it
+            if (candidate.best < below) {
+                winner = _descend(current);
+                top = candidate.best;
+                continue;
+            }
+
+            // Otherwise this subtree holds newer keys, look around them
+            if (candidate.value != 0 && candidate.value < below && candidate.value > top) {
+                winner = current;
+                top = candidate.value;
+            }
+            pending.insert(pending.end(), candidate.children.begin(), candidate.children.end());
+        }
+
+        return winner;
+    }
+
+    unsigned radix::_descend(unsigned index) const {
+        // Follow the trail of the subtree maximum down to the key holding it
+        while (_nodes[index].value != _nodes[index].best) {
+            const std::vector<unsigned>& children = _nodes[index].children;
+            for (size_t i = 0; i < children.size(); i++) {
+                if (_nodes[children[i]].best == _nodes[index].best) {
+                    index = children[i];
+                    break;
+                }
+            }
+        }
+        return index;
+    }
+
+    void radix::_collect(unsigned index, std::wstring& path, std::vector<std::wstring>& keys, size_t limit) const {
+        if (keys.size() >= limit) return;
+        if (_nodes[index].value != 0) keys.push_back(path);
+
+        const std::vector<unsigned>& children = _nodes[index].children;
+        for (size_t i = 0; i < children.size() && keys.size() < limit; i++) {
+            size_t length = path.size();
+            path.append(_nodes[children[i]].label);
+            _collect(children[i], path, keys, limit);
+            path.resize(length);
+        }
+    }
+
+    void radix::_refresh(unsigned index) {
+        // Recompute subtree maximums up towards the root, stopping once stable
+        while (index != NODE_None) {
+            node& current = _nodes[index];
+            rank best = current.value;
+            for (size_t i = 0; i < current.children.size(); i++)
+                best = (std::max)(best, _nodes[current.children[i]].best);
+            if (best == current.best && index != 0) break;
+            current.best = best;
+            index = current.parent;
+        }
+    }
+
+    std::wstring radix::_key(unsigned index) const {
+        std::vector<unsigned> trail;
+        size_t length = 0;
+        for (; index != 0; index = _nodes[index].parent) {
+            trail.push_back(index);
+            length += _nodes[index].label.size();
+        }
+
+        std::wstring key;
+        key.reserve(length);
+        for (size_t i = trail.size(); i > 0; i--)
+            key.append(_nodes[trail[i - 1]].label);
+        return key;
+    }
+}
@@ -0,0 +1,185 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Shared UI reactor implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "console.hpp"
+
+namespace db
+{
+    // Requests to a loop's window
+    enum { REACTOR_MSG_ATTACH = WM_APP + 1,
+           REACTOR_MSG_DRAIN,
+           REACTOR_MSG_QUIT,
+           REACTOR_TIMER_DRAIN = 1 };
+
+    static const wchar_t* REACTOR_WINDOW_CLASS = L"db::reactor";
+
+    // Messages a console may drain per turn
+    static const int REACTOR_QUANTUM = 32;
+
+    reactor::reactor(int threads) {
+        if (threads <= 0) threads = 1;
+
+        // Every loop has a message-only window of this class
+        WNDCLASSEX cls = { 0 };
+        cls.cbSize = sizeof(cls);
+        cls.lpfnWndProc = _callback_winproc;
+        cls.lpszClassName = REACTOR_WINDOW_CLASS;
+        cls.hInstance = console::_get_instance();
+        if (!RegisterClassEx(&cls) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+            win_exception::check_last_error();
+
+        for (int i = 0; i < threads; i++) {
+            loop* fresh = new loop;
+            fresh->owner = this;
+            fresh->thread = NULL;
+            fresh->window = NULL;
+            fresh->error = ERROR_SUCCESS;
+            fresh->posted = false;
+            fresh->attached = 0;
+            fresh->event_started = CreateEvent(NULL, TRUE, FALSE, NULL);
+            _loops.push_back(fresh);
+            win_exception::check(fresh->event_started);
+
+            // Wait until the thread has a window to post to
+            fresh->thread = CreateThread(NULL, 0, _callback_threadproc, fresh, 0, NULL);
+            win_exception::check(fresh->thread);
+            WaitForSingleObject(fresh->event_started, INFINITE);
+            if (!fresh->window) throw win_exception(fresh->error);
+        }
+    }
+
+    reactor::~reactor() {
+        for (size_t i = 0; i < _loops.size(); i++) {
+            loop* current = _loops[i];
+            if (current->thread) {
+                if (current->window) PostMessage(current->window, REACTOR_MSG_QUIT, 0, 0);
+                WaitForSingleObject(current->thread, INFINITE);
+                CloseHandle(current->thread);
+            }
+            if (current->event_started) CloseHandle(current->event_started);
+            delete current;
+        }
+
+        // Fails harmlessly while another reactor still has windows of the class
+        UnregisterClass(REACTOR_WINDOW_CLASS, console::_get_instance());
+    }
+
+    size_t reactor::_attach(console* target) {
+        // Pin the console to the least loaded loop
+        _lock.acquire();
+        size_t slot = 0;
+        for (size_t i = 1; i < _loops.size(); i++)
+            if (_loops[i]->attached < _loops[slot]->attached) slot = i;
+        _loops[slot]->attached++;
+        _lock.release();
+
+        // The window has to be created on the loop's thread
+        PostMessage(_loops[slot]->window, REACTOR_MSG_ATTACH, 0, reinterpret_cast<LPARAM>(target));
+        return slot;
+    }
+
+    void reactor::_detach(console* target, size_t slot) {
+        _loops[slot]->queue.remove(target);
+        _lock.acquire();
+        _loops[slot]->attached--;
+        _lock.release();
+    }
+
+    void reactor::_signal(console* target, size_t slot) {
+        // Only wake the loop when the console was not already waiting for a
+        // turn and no earlier request is still on its way
+        loop& current = *_loops[slot];
+        if (current.queue.ready(target) && !current.posted.exchange(true))
+            PostMessage(current.window, REACTOR_MSG_DRAIN, 0, 0);
+    }
+
+    DWORD reactor::_callback_threadproc(void* ploop) {
+        loop* self = reinterpret_cast<loop*>(ploop);
+        self->owner->_thread_run(*self);
+        return 0;
+    }
+
+    LRESULT reactor::_callback_winproc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+        loop* self = reinterpret_cast<loop*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+        if (!self) return DefWindowProc(hwnd, uMsg, wParam, lParam);
+
+        switch (uMsg) {
+        case REACTOR_MSG_ATTACH:
+            reinterpret_cast<console*>(lParam)->_thread_initialize();
+            break;
+        case REACTOR_MSG_DRAIN:
+            self->posted = false;
+            // Fall through
+        case WM_TIMER:
+            // Usually the loop's own pump keeps going once a round leaves work
+            // behind, the timer only matters while a modal loop has the thread
+            if (self->owner->_thread_round(*self)) SetTimer(hwnd, REACTOR_TIMER_DRAIN, USER_TIMER_MINIMUM, NULL);
+            else KillTimer(hwnd, REACTOR_TIMER_DRAIN);
+            break;
+        case REACTOR_MSG_QUIT:
+            DestroyWindow(hwnd);
+            PostQuitMessage(0);
+            break;
+        default:
+            return DefWindowProc(hwnd, uMsg, wParam, lParam);
+        }
+        return 0;
+    }
+
+    void reactor::_thread_run(loop& self) {
+        // Requests arrive through a window, modal loops dispatch those too
+        self.window = CreateWindowEx(0, REACTOR_WINDOW_CLASS, NULL, 0, 0, 0, 0, 0,
+                                     HWND_MESSAGE, NULL, console::_get_instance(), NULL);
+        if (!self.window) {
+            self.error = GetLastError();
+            SetEvent(self.event_started);
+            return;
+        }
+        SetWindowLongPtr(self.window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(&self));
+        SetEvent(self.event_started);
+
+        MSG msg;
+        for (;;) {
+            // Window messages for every console on this thread
+            while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+                if (msg.message == WM_QUIT) return;
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
+
+            // Sleep only once nobody is waiting for a turn
+            if (!_thread_round(self))
+                MsgWaitForMultipleObjectsEx(0, NULL, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        }
+    }
+
+    bool reactor::_thread_round(loop& self) {
+        // One round over the consoles with pending output
+        size_t turns = self.queue.size();
+        console* target = NULL;
+        while (turns-- > 0 && self.queue.next(target)) {
+            if (target->_thread_drain(REACTOR_QUANTUM))
+                self.queue.ready(target); // Still more, back of the line
+        }
+        return self.queue.size() != 0;
+    }
+}
@@ -0,0 +1,241 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Session recording implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Recording file header
+    static const DWORD RECORD_MAGIC = 0x31524244; // "DBR1"
+
+    // Bytes gathered before each write
+    static const size_t RECORD_BUFFER = 256 * 1024;
+
+    recorder::recorder()
+        : _file(INVALID_HANDLE_VALUE), _origin(0), _frequency(0), _active(false) {}
+
+    recorder::~recorder() {
+        close();
+    }
+
+    void recorder::open(const wchar_t* path) {
+        HANDLE file = CreateFile(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) win_exception::check_last_error();
+
+        close();
+        _lock.acquire();
+        _file = file;
+        _origin = timestamp::now();
+        _frequency = timestamp::calibrated().frequency;
+
+        // The header carries the tick rate so recordings play back anywhere
+        _buffer.clear();
+        _buffer.append(reinterpret_cast<const char*>(&RECORD_MAGIC), sizeof(RECORD_MAGIC));
+        _buffer.append(reinterpret_cast<const char*>(&_frequency), sizeof(_frequency));
+        _active = true;
+        _lock.release();
+    }
+
+    void recorder::close() {
+        _lock.acquire();
+        if (_file != INVALID_HANDLE_VALUE) {
+            DWORD written = 0;
+            if (!_buffer.empty()) WriteFile(_file, _buffer.data(), static_cast<DWORD>(_buffer.size()), &written, NULL);
+            CloseHandle(_file);
+            _file = INVALID_HANDLE_VALUE;
+        }
+        _buffer.clear();
+        _active = false;
+        _lock.release();
+    }
+
+    void recorder::write(const std::wstring& text, unsigned long timeout, int level, int category) {
+        if (!_active) return;
+        _begin(EVENT_Write);
+        _buffer.push_back(static_cast<char>(level));
+        _buffer.push_back(static_cast<char>(category));
+        _number(_buffer, timeout);
+        _number(_buffer, text.size());
+        exporter::utf8(text, _buffer);
+        _end();
+    }
+
+    void recorder::input(const std::wstring& text) {
+        if (!_active) return;
+        _begin(EVENT_Input);
+        _number(_buffer, text.size());
+        exporter::utf8(text, _buffer);
+        _end();
+    }
+
+    void recorder::control(option setting, unsigned long long first, unsigned long long second, const std::wstring& text) {
+        if (!_active) return;
+        _begin(EVENT_Control);
+        _buffer.push_back(static_cast<char>(setting));
+        _number(_buffer, first);
+        _number(_buffer, second);
+        _number(_buffer, text.size());
+        exporter::utf8(text, _buffer);
+        _end();
+    }
+
+    void recorder::_begin(kind type) {
+        _lock.acquire();
+
+        // Records are stamped in the order they are taken, offsets never go back
+        _buffer.push_back(static_cast<char>(type));
+        _number(_buffer, _file != INVALID_HANDLE_VALUE ? timestamp::now() - _origin : 0);
+        _number(_buffer, GetCurrentThreadId());
+    }
+
+    void recorder::_end() {
+        if (_file == INVALID_HANDLE_VALUE) _buffer.clear();
+        else if (_buffer.size() >= RECORD_BUFFER) {
+            DWORD written = 0;
+            WriteFile(_file, _buffer.data(), static_cast<DWORD>(_buffer.size()), &written, NULL);
+            _buffer.clear();
+        }
+        _lock.release();
+    }
+
+    void recorder::_number(std::string& out, unsigned long long value) {
+        // Seven bits at a time, low bits first
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    replayer::replayer(const wchar_t* path)
+        : _frequency(0) {
+        HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) win_exception::check_last_error();
+
+        // Read the whole file in one go
+        LARGE_INTEGER size;
+        DWORD read = 0;
+        if (!GetFileSizeEx(file, &size)) {
+            DWORD error = GetLastError();
+            CloseHandle(file);
+            throw win_exception(error);
+        }
+        _contents.resize(static_cast<size_t>(size.QuadPart));
+        BOOL success = _contents.empty() || ReadFile(file, &_contents[0], static_cast<DWORD>(_contents.size()), &read, NULL);
+        DWORD error = GetLastError();
+        CloseHandle(file);
+        if (!success) throw win_exception(error);
+        _contents.resize(read);
+
+        // Validate the header
+        if (_contents.size() < sizeof(RECORD_MAGIC) + sizeof(_frequency) ||
+            *reinterpret_cast<const DWORD*>(_contents.data()) != RECORD_MAGIC)
+            throw win_exception(ERROR_BAD_FORMAT);
+        _frequency = *reinterpret_cast<const timestamp::tick*>(_contents.data() + sizeof(RECORD_MAGIC));
+        if (!_frequency) throw win_exception(ERROR_BAD_FORMAT);
+    }
+
+    size_t replayer::play(const handler& target, double rate) {
+        // Recorded ticks are converted to this machine's counter once per event
+        timestamp::tick local = timestamp::calibrated().frequency;
+        double scale = (rate > 0) ? static_cast<double>(local) / (static_cast<double>(_frequency) * rate) : 0;
+        timestamp::tick start = timestamp::now();
+
+        size_t played = 0;
+        size_t offset = sizeof(RECORD_MAGIC) + sizeof(_frequency);
+        recorder::event current;
+        while (_next(offset, current)) {
+            if (scale > 0) {
+                timestamp::tick due = start + static_cast<timestamp::tick>(current.offset * scale);
+                for (timestamp::tick now = timestamp::now(); now < due; now = timestamp::now()) {
+                    // Sleep through most of the gap, yield through the last millisecond
+                    timestamp::tick remaining = (due - now) * 1000 / local;
+                    Sleep(remaining > 1 ? static_cast<DWORD>(remaining - 1) : 0);
+                }
+            }
+            target(current);
+            played++;
+        }
+        return played;
+    }
+
+    bool replayer::_next(size_t& offset, recorder::event& result) const {
+        // Anything cut short, such as a torn final record, ends playback
+        if (offset >= _contents.size()) return false;
+        result.type = static_cast<recorder::kind>(static_cast<unsigned char>(_contents[offset++]));
+
+        unsigned long long producer = 0;
+        if (!_number(offset, result.offset) || !_number(offset, producer)) return false;
+        result.producer = static_cast<unsigned long>(producer);
+
+        switch (result.type) {
+        case recorder::EVENT_Write: {
+            unsigned long long timeout = 0;
+            if (offset + 2 > _contents.size()) return false;
+            result.level = static_cast<unsigned char>(_contents[offset++]);
+            result.category = static_cast<unsigned char>(_contents[offset++]);
+            if (!_number(offset, timeout)) return false;
+            result.timeout = static_cast<unsigned long>(timeout);
+            return _text(offset, result.text);
+        }
+        case recorder::EVENT_Input:
+            return _text(offset, result.text);
+        case recorder::EVENT_Control:
+            if (offset >= _contents.size()) return false;
+            result.setting = static_cast<recorder::option>(static_cast<unsigned char>(_contents[offset++]));
+            return _number(offset, result.first) && _number(offset, result.second) && _text(offset, result.text);
+        default:
+            throw win_exception(ERROR_BAD_FORMAT);
+        }
+    }
+
+    bool replayer::_number(size_t& offset, unsigned long long& value) const {
+        value = 0;
+        for (int shift = 0; offset < _contents.size() && shift < 64; shift += 7) {
+            unsigned char byte = static_cast<unsigned char>(_contents[offset++]);
+            value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool replayer::_text(size_t& offset, std::wstring& value) const {
+        // Lengths count wide characters, the bytes in between are found by walking lead bytes.
+        // Characters outside the basic plane take two where wide characters are UTF-16
+        unsigned long long units = 0;
+        if (!_number(offset, units)) return false;
+        size_t end = offset;
+        for (unsigned long long counted = 0; counted < units; ) {
+            if (end >= _contents.size()) return false;
+            unsigned char lead = static_cast<unsigned char>(_contents[end]);
+            size_t length = (lead < 0x80) ? 1 : (lead < 0xE0) ? 2 : (lead < 0xF0) ? 3 : 4;
+            counted += (length == 4 && sizeof(wchar_t) == 2) ? 2 : 1;
+            end += length;
+        }
+        if (end > _contents.size()) return false;
+
+        value.resize(static_cast<size_t>(units));
+        if (units) MultiByteToWideChar(CP_UTF8, 0, _contents.data() + offset, static_cast<int>(end - offset), &value[0], static_cast<int>(units));
+        offset = end;
+        return true;
+    }
+}
@@ -0,0 +1,351 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Scrollback implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Widest character code, trigrams pack three of them into one key
+    static const int SCROLLBACK_CharBits = 21;
+
+    scrollback::scrollback(size_t capacity, memory_resource* memory)
+        : _end(0), _capacity(capacity), _memory(memory) {}
+
+    scrollback::~scrollback() {}
+
+    int scrollback::category(const std::wstring& name) {
+        _lock.acquire();
+        int result = -1;
+        for (size_t i = 0; i < _categories.size() && result < 0; i++)
+            if (_categories[i] == name) result = static_cast<int>(i);
+
+        // Past the limit everything shares the last category
+        if (result < 0) {
+            if (_categories.size() < CATEGORY_Count)
+                _categories.push_back(name);
+            result = static_cast<int>(_categories.size()) - 1;
+        }
+        _lock.release();
+        return result;
+    }
+
+    size_t scrollback::append(const std::wstring& text, int level, int category, unsigned long long stamp) {
+        if (level < 0 || level >= LEVEL_Count) level = LEVEL_Info;
+        if (category < 0 || category >= CATEGORY_Count) category = 0;
+
+        size_t index = _end.load(std::memory_order_relaxed);
+        if (!_current || index - _current->base == BLOCK_Lines) _extend();
+
+        // Fill the next slot, readers do not look at it until the count moves past it
+        block& current = *_current;
+        size_t offset = index - current.base;
+        line& entry = current.lines[offset];
+        entry.text.assign(text.data(), text.size());
+        entry.level = static_cast<unsigned char>(level);
+        entry.category = static_cast<unsigned char>(category);
+        entry.repeats = 1;
+        entry.stamp = stamp;
+
+        // Mark it in the block's bitmaps, a category's bitmap is complete before it is seen
+        bitmap* categories = current.categories[category].load(std::memory_order_relaxed);
+        if (!categories) {
+            categories = new (current.memory.allocate(sizeof(bitmap), __alignof(bitmap))) bitmap();
+            current.categories[category].store(categories, std::memory_order_release);
+        }
+        mask bit = 1ull << (offset % 64);
+        _mark(current.levels[level].words[offset / 64], bit);
+        _mark(categories->words[offset / 64], bit);
+        current.level_mask.store(current.level_mask.load(std::memory_order_relaxed) | (1u << level), std::memory_order_relaxed);
+        _mark(current.category_mask, 1ull << category);
+
+        size_t positions[BLOOM_Hashes];
+        for (size_t i = 0; i + 3 <= text.size(); i++) {
+            _bloom(_trigram(&text[i]), positions);
+            for (int j = 0; j < BLOOM_Hashes; j++)
+                _mark(current.trigrams[positions[j] / 64], 1ull << (positions[j] % 64));
+        }
+
+        // Publish the line
+        _end.store(index + 1, std::memory_order_release);
+        return index;
+    }
+
+    bool scrollback::repeat(size_t index) {
+        snapshot current = take();
+        if (index < current.first() || index >= current.end()) return false;
+        const directory& blocks = *current._directory;
+        blocks.blocks[(index - blocks.first) / BLOCK_Lines]->lines[index % BLOCK_Lines].repeats++;
+        return true;
+    }
+
+    scrollback::snapshot scrollback::take() const {
+        // The count is read first, any directory seen afterwards holds all of its lines
+        snapshot result;
+        result._end = _end.load(std::memory_order_acquire);
+        result._directory = std::atomic_load(&_directory);
+        return result;
+    }
+
+    size_t scrollback::select(const filter& which, size_t from, std::vector<size_t>& lines, size_t until) const {
+        return take().select(which, from, lines, until);
+    }
+
+    bool scrollback::get(size_t index, line& result) const {
+        return take().get(index, result);
+    }
+
+    size_t scrollback::search(const std::wstring& pattern, bool expression, const match& found) const {
+        return take().search(pattern, expression, found);
+    }
+
+    size_t scrollback::first() const {
+        return take().first();
+    }
+
+    size_t scrollback::end() const {
+        return _end.load(std::memory_order_acquire);
+    }
+
+    scrollback::block::block(memory_resource* upstream)
+        : memory(upstream), base(0)
+    {
+        // Lines keep their text in the block's arena, copies of them do not
+        allocator<wchar_t> text(&memory);
+        lines.reserve(BLOCK_Lines);
+        for (size_t i = 0; i < BLOCK_Lines; i++)
+            lines.push_back(line(text));
+        for (size_t i = 0; i < CATEGORY_Count; i++)
+            categories[i].store(NULL, std::memory_order_relaxed);
+        level_mask.store(0, std::memory_order_relaxed);
+        category_mask.store(0, std::memory_order_relaxed);
+        for (size_t i = 0; i < BLOOM_Bits / 64; i++)
+            trigrams[i].store(0, std::memory_order_relaxed);
+    }
+
+    void scrollback::_extend() {
+        std::shared_ptr<block> fresh = std::make_shared<block>(_memory);
+        fresh->base = _end.load(std::memory_order_relaxed);
+
+        // Readers keep the directory they hold, the new one is published whole
+        std::shared_ptr<directory> next = std::make_shared<directory>();
+        if (_directory) next->blocks = _directory->blocks;
+        next->blocks.push_back(fresh);
+
+        // Evict whole blocks once over capacity
+        size_t evicted = 0;
+        while (next->blocks.size() - evicted > 1 && fresh->base - next->blocks[evicted + 1]->base >= _capacity)
+            evicted++;
+        next->blocks.erase(next->blocks.begin(), next->blocks.begin() + evicted);
+        next->first = next->blocks.front()->base;
+
+        _current = fresh;
+        std::atomic_store(&_directory, std::shared_ptr<const directory>(next));
+    }
+
+    unsigned long scrollback::_lowest(mask bits) {
+        unsigned long index = 0;
+        if (_BitScanForward(&index, static_cast<unsigned long>(bits)))
+            return index;
+        _BitScanForward(&index, static_cast<unsigned long>(bits >> 32));
+        return index + 32;
+    }
+
+    unsigned long long scrollback::_trigram(const wchar_t* text) {
+        return (static_cast<unsigned long long>(text[0]) << (2 * SCROLLBACK_CharBits)) |
+               (static_cast<unsigned long long>(text[1]) << SCROLLBACK_CharBits) |
+                static_cast<unsigned long long>(text[2]);
+    }
+
+    void scrollback::_bloom(unsigned long long trigram, size_t positions[BLOOM_Hashes]) {
+        // One well mixed word split into a position per hash
+        unsigned long long hash = trigram * 0xBF58476D1CE4E5B9ull;
+        hash = (hash ^ (hash >> 31)) * 0x94D049BB133111EBull;
+        hash ^= hash >> 29;
+        for (int i = 0; i < BLOOM_Hashes; i++, hash >>= 17)
+            positions[i] = static_cast<size_t>(hash) & (BLOOM_Bits - 1);
+    }
+
+    void scrollback::_mark(std::atomic<mask>& word, mask bits) {
+        // Only the appending thread writes, readers never see a torn word
+        word.store(word.load(std::memory_order_relaxed) | bits, std::memory_order_relaxed);
+    }
+
+    std::wstring scrollback::_literal(const std::wstring& expression) {
+        // With alternatives no single run is required
+        std::wstring best, run;
+        if (expression.find(L'|') != std::wstring::npos) return best;
+
+        for (size_t i = 0; i < expression.size(); i++) {
+            wchar_t c = expression[i];
+            bool literal = false;
+            switch (c) {
+            case L'\\':
+                // Escaped punctuation is literal, escaped letters are classes, anchors or codes
+                if (++i >= expression.size()) break;
+                c = expression[i];
+                literal = !iswalnum(c);
+                if (c == L'x') i += 2;
+                else if (c == L'u') i += 4;
+                else if (c == L'c') i += 1;
+                break;
+            case L'[': case L'(': {
+                // Classes and groups are skipped as a whole
+                wchar_t close = (c == L'[') ? L']' : L')';
+                int depth = 1;
+                while (depth > 0 && ++i < expression.size()) {
+                    if (expression[i] == L'\\') i++;
+                    else if (expression[i] == close) depth--;
+                    else if (c == L'(' && expression[i] == L'(') depth++;
+                }
+                break;
+            }
+            case L'?': case L'*': case L'{':
+                // The previous character may be missing altogether
+                if (!run.empty()) run.erase(run.size() - 1);
+                while (c == L'{' && i < expression.size() && expression[i] != L'}') i++;
+                break;
+            case L'+': case L'.': case L'^': case L'$':
+                break;
+            default:
+                literal = true;
+            }
+
+            if (literal) { run.push_back(c); continue; }
+            if (run.size() > best.size()) best = run;
+            run.clear();
+        }
+        if (run.size() > best.size()) best = run;
+        return best;
+    }
+
+    const scrollback::line& scrollback::snapshot::at(size_t index) const {
+        const directory& blocks = *_directory;
+        return blocks.blocks[(index - blocks.first) / BLOCK_Lines]->lines[index % BLOCK_Lines];
+    }
+
+    bool scrollback::snapshot::get(size_t index, line& result) const {
+        bool found = index >= first() && index < _end;
+        if (found) result = at(index);
+        return found;
+    }
+
+    size_t scrollback::snapshot::select(const filter& which, size_t from, std::vector<size_t>& lines, size_t until) const {
+        if (!_directory) return _end;
+        const std::vector<std::shared_ptr<block> >& blocks = _directory->blocks;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            const block& current = *blocks[i];
+            if (current.base >= until) break;
+            size_t count = (std::min)(_count(current), until - current.base);
+            if (current.base + count <= from) continue;
+
+            // Skip blocks holding nothing of interest
+            mask present = current.category_mask.load(std::memory_order_relaxed);
+            unsigned levels = current.level_mask.load(std::memory_order_relaxed) & which.levels;
+            mask categories = present & which.categories;
+            if (!levels || !categories) continue;
+            bool all = categories == present;
+
+            size_t start = from > current.base ? from - current.base : 0;
+            size_t words = (count + 63) / 64;
+            for (size_t word = start / 64; word < words; word++) {
+                mask hits = 0;
+                for (int level = 0; level < LEVEL_Count; level++)
+                    if (levels & (1u << level)) hits |= current.levels[level].words[word].load(std::memory_order_relaxed);
+                if (!hits) continue;
+
+                // Categories only narrow the result when some are filtered out
+                if (!all) {
+                    mask wanted = 0;
+                    for (mask rest = categories; rest; rest &= rest - 1) {
+                        const bitmap* marked = current.categories[_lowest(rest)].load(std::memory_order_acquire);
+                        if (marked) wanted |= marked->words[word].load(std::memory_order_relaxed);
+                    }
+                    hits &= wanted;
+                }
+
+                // Only lines within the snapshot count
+                if (word == start / 64) hits &= ~0ull << (start % 64);
+                if ((word + 1) * 64 > count) hits &= (1ull << (count % 64)) - 1;
+
+                for (; hits; hits &= hits - 1)
+                    lines.push_back(current.base + word * 64 + _lowest(hits));
+            }
+        }
+        return _end;
+    }
+
+    size_t scrollback::snapshot::search(const std::wstring& pattern, bool expression, const match& found) const {
+        std::wregex compiled;
+        if (expression) compiled.assign(pattern);
+        else if (pattern.empty()) return 0;
+        if (!_directory) return 0;
+        std::wstring literal = expression ? _literal(pattern) : pattern;
+
+        std::vector<size_t> probes;
+        for (size_t i = 0; i + 3 <= literal.size(); i++) {
+            size_t positions[BLOOM_Hashes];
+            _bloom(_trigram(&literal[i]), positions);
+            probes.insert(probes.end(), positions, positions + BLOOM_Hashes);
+        }
+
+        size_t matches = 0;
+        const std::vector<std::shared_ptr<block> >& blocks = _directory->blocks;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            const block& current = *blocks[i];
+
+            // Only scan blocks that may hold every trigram
+            bool candidate = true;
+            for (size_t j = 0; j < probes.size() && candidate; j++)
+                candidate = ((current.trigrams[probes[j] / 64].load(std::memory_order_relaxed) >> (probes[j] % 64)) & 1) != 0;
+            if (!candidate) continue;
+
+            size_t count = _count(current);
+            for (size_t j = 0; j < count; j++) {
+                const string& text = current.lines[j].text;
+                if (expression ? !std::regex_search(text, compiled) : text.find(pattern.c_str(), 0, pattern.size()) == string::npos)
+                    continue;
+                matches++;
+                if (!found(current.base + j)) return matches;
+            }
+        }
+        return matches;
+    }
+
+    size_t scrollback::snapshot::_count(const block& current) const {
+        return _end > current.base ? (std::min)(static_cast<size_t>(BLOCK_Lines), _end - current.base) : 0;
+    }
+
+    view::view(scrollback& store, const scrollback::filter& which)
+        : _store(store), _filter(which), _next(0) {}
+
+    void view::refresh() {
+        // Forget evicted lines then pick up everything new
+        scrollback::snapshot current = _store.take();
+        size_t first = current.first();
+        while (!_lines.empty() && _lines.front() < first)
+            _lines.pop_front();
+
+        std::vector<size_t> fresh;
+        _next = current.select(_filter, (std::max)(_next, first), fresh);
+        _lines.insert(_lines.end(), fresh.begin(), fresh.end());
+    }
+}
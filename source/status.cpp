@@ -0,0 +1,85 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Status line implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    status_board::status_board()
+        : _changed(false), _scheduled(false) {}
+
+    size_t status_board::open(unsigned& generation) {
+        _lock.acquire();
+
+        // Reuse a closed slot before growing
+        size_t index = 0;
+        while (index < _slots.size() && _slots[index].open) index++;
+        if (index == _slots.size()) _slots.push_back(slot());
+        _slots[index].text.clear();
+        _slots[index].open = true;
+        generation = ++_slots[index].generation;
+        _changed = true;
+        _lock.release();
+        return index;
+    }
+
+    bool status_board::close(size_t slot, unsigned generation) {
+        _lock.acquire();
+        bool schedule = false;
+        if (slot < _slots.size() && _slots[slot].open && _slots[slot].generation == generation) {
+            _slots[slot].open = false;
+            _slots[slot].text.clear();
+            _changed = true;
+            schedule = !_scheduled;
+            _scheduled = true;
+        }
+        _lock.release();
+        return schedule;
+    }
+
+    bool status_board::update(size_t slot, unsigned generation, const std::wstring& text) {
+        _lock.acquire();
+        bool schedule = false;
+        if (slot < _slots.size() && _slots[slot].open && _slots[slot].generation == generation) {
+            _slots[slot].text.assign(text);
+            _changed = true;
+            schedule = !_scheduled;
+            _scheduled = true;
+        }
+        _lock.release();
+        return schedule;
+    }
+
+    bool status_board::collect(std::vector<std::wstring>& lines) {
+        _lock.acquire();
+        _scheduled = false;
+        bool changed = _changed;
+        if (changed) {
+            lines.clear();
+            for (size_t i = 0; i < _slots.size(); i++)
+                if (_slots[i].open) lines.push_back(_slots[i].text);
+            _changed = false;
+        }
+        _lock.release();
+        return changed;
+    }
+}
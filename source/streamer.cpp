@@ -0,0 +1,344 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output streaming implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+// Winsock goes first, so Windows.h leaves out the old winsock.h
+#include <WinSock2.h>
+#include "console.hpp"
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace db
+{
+    // Lines of scrollback sent to a new viewer
+    static const size_t STREAM_TAIL = 1000;
+
+    // Bytes queued for a viewer before it skips ahead
+    static const size_t STREAM_LIMIT = 1024 * 1024;
+
+    // Packets handed to one send
+    static const size_t STREAM_GATHER = 64;
+
+    // Lines a new viewer may still be behind by when it is registered
+    static const size_t STREAM_CATCHUP = 64;
+
+    // Unix domain socket address, afunix.h is missing from older SDKs
+    static const size_t STREAM_PATH = 108;
+    struct stream_address {
+        unsigned short family;
+        char path[STREAM_PATH];
+    };
+
+    // Globals
+    INIT_ONCE streamer::_startup = INIT_ONCE_STATIC_INIT;
+
+    streamer::streamer(scrollback& source, highlighter& styles)
+        : _source(source), _styles(styles), _listener(INVALID_SOCKET),
+          _event_listener(WSA_INVALID_EVENT), _event_wake(NULL), _thread(NULL), _quit(false) {
+        _event_wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+        win_exception::check(_event_wake);
+    }
+
+    streamer::~streamer() {
+        if (_thread) {
+            _quit = true;
+            SetEvent(_event_wake);
+            WaitForSingleObject(_thread, INFINITE);
+            CloseHandle(_thread);
+        }
+        for (size_t i = 0; i < _clients.size(); i++)
+            _close(_clients[i]);
+        if (_listener != INVALID_SOCKET) closesocket(_listener);
+        if (_event_listener != WSA_INVALID_EVENT) WSACloseEvent(_event_listener);
+        if (!_path.empty()) DeleteFile(_path.c_str());
+        CloseHandle(_event_wake);
+    }
+
+    void streamer::listen(const wchar_t* path) {
+        if (_listener != INVALID_SOCKET) throw win_exception(ERROR_ALREADY_EXISTS);
+
+        // Winsock is started once for the process and left running until it exits
+        int error = 0;
+        if (!InitOnceExecuteOnce(&_startup, _callback_startup, &error, NULL)) throw win_exception(error);
+
+        // Socket paths are narrow, pass them as UTF-8
+        std::string name;
+        exporter::utf8(path, name);
+        stream_address address = { 0 };
+        address.family = AF_UNIX;
+        if (name.size() >= sizeof(address.path)) throw win_exception(ERROR_FILENAME_EXCED_RANGE);
+        std::copy(name.begin(), name.end(), address.path);
+
+        // A socket left behind by an earlier run blocks the bind
+        DeleteFile(path);
+        SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener == INVALID_SOCKET) throw win_exception(WSAGetLastError());
+        WSAEVENT event = WSACreateEvent();
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+            ::listen(listener, SOMAXCONN) == SOCKET_ERROR ||
+            WSAEventSelect(listener, event, FD_ACCEPT) == SOCKET_ERROR) {
+            int error = WSAGetLastError();
+            closesocket(listener);
+            WSACloseEvent(event);
+            throw win_exception(error);
+        }
+
+        _listener = listener;
+        _event_listener = event;
+        _path = path;
+        _thread = CreateThread(NULL, 0, _callback_threadproc, this, 0, NULL);
+        win_exception::check(_thread);
+    }
+
+    void streamer::publish(size_t index) {
+        _lock.acquire();
+        if (!_clients.empty()) {
+            // Encoded once, whoever is watching shares the frame
+            std::string data;
+            scrollback::snapshot contents = _source.take();
+            if (index >= contents.first() && index < contents.end())
+                _encode(index, contents.at(index), data);
+            packet shared = std::make_shared<const std::string>(std::move(data));
+            for (size_t i = 0; i < _clients.size(); i++)
+                if (index >= _clients[i]->start) _enqueue(*_clients[i], shared);
+            SetEvent(_event_wake);
+        }
+        _lock.release();
+    }
+
+    void streamer::repeat(size_t index, size_t count) {
+        _lock.acquire();
+        if (!_clients.empty()) {
+            // Counts are absolute, a viewer whose tail already had it loses nothing
+            std::string payload, data;
+            _put(payload, index, 8);
+            _put(payload, count, 4);
+            _frame(FRAME_Repeat, payload, data);
+            packet shared = std::make_shared<const std::string>(std::move(data));
+            for (size_t i = 0; i < _clients.size(); i++)
+                _enqueue(*_clients[i], shared);
+            SetEvent(_event_wake);
+        }
+        _lock.release();
+    }
+
+    BOOL CALLBACK streamer::_callback_startup(INIT_ONCE*, void* parameter, void**) {
+        WSADATA data;
+        int error = WSAStartup(MAKEWORD(2, 2), &data);
+        *static_cast<int*>(parameter) = error;
+        return error == 0;
+    }
+
+    DWORD CALLBACK streamer::_callback_threadproc(void* self) {
+        static_cast<streamer*>(self)->_thread_run();
+        return 0;
+    }
+
+    void streamer::_thread_run() {
+        std::vector<WSAEVENT> events;
+        while (!_quit) {
+            events.clear();
+            events.push_back(_event_wake);
+            events.push_back(_event_listener);
+            _lock.acquire();
+            for (size_t i = 0; i < _clients.size(); i++)
+                events.push_back(_clients[i]->event);
+            _lock.release();
+
+            WSAWaitForMultipleEvents(static_cast<DWORD>(events.size()), &events[0], FALSE, WSA_INFINITE, FALSE);
+            if (_quit) break;
+            _thread_accept();
+
+            // Sends never block, so holding the lock here only delays writers briefly
+            _lock.acquire();
+            for (size_t i = 0; i < _clients.size();) {
+                client* target = _clients[i];
+                WSANETWORKEVENTS happened = { 0 };
+                WSAEnumNetworkEvents(target->socket, target->event, &happened);
+
+                // Viewers have nothing to say, whatever they send is dropped
+                if (happened.lNetworkEvents & FD_READ) {
+                    char sink[256];
+                    while (recv(target->socket, sink, sizeof(sink), 0) > 0);
+                }
+                if ((happened.lNetworkEvents & FD_CLOSE) || !_thread_flush(*target)) {
+                    _close(target);
+                    _clients.erase(_clients.begin() + i);
+                } else i++;
+            }
+            _lock.release();
+        }
+    }
+
+    void streamer::_thread_accept() {
+        WSANETWORKEVENTS happened = { 0 };
+        WSAEnumNetworkEvents(_listener, _event_listener, &happened);
+        if (!(happened.lNetworkEvents & FD_ACCEPT)) return;
+
+        for (;;) {
+            SOCKET incoming = accept(_listener, NULL, NULL);
+            if (incoming == INVALID_SOCKET) break;
+
+            // One wait covers the wake event, the listener and every viewer
+            _lock.acquire();
+            bool full = _clients.size() + 2 >= WSA_MAXIMUM_WAIT_EVENTS;
+            _lock.release();
+            if (full) { closesocket(incoming); continue; }
+
+            client* fresh = new client;
+            fresh->socket = incoming;
+            fresh->event = WSACreateEvent();
+            fresh->queued = 0;
+            fresh->offset = 0;
+            if (WSAEventSelect(incoming, fresh->event, FD_READ | FD_WRITE | FD_CLOSE) == SOCKET_ERROR) {
+                _close(fresh);
+                continue;
+            }
+
+            // The tail is encoded without holding up writers, then whatever was written
+            // meanwhile is caught up with under the lock, so no line is missed or sent twice
+            scrollback::snapshot contents = _source.take();
+            size_t next = contents.end() > STREAM_TAIL ? contents.end() - STREAM_TAIL : 0;
+            for (bool locked = false;;) {
+                for (next = (std::max)(next, contents.first()); next < contents.end(); next++) {
+                    std::string data;
+                    _encode(next, contents.at(next), data);
+                    _enqueue(*fresh, std::make_shared<const std::string>(std::move(data)));
+                }
+                if (locked) break;
+                _lock.acquire();
+                contents = _source.take();
+                locked = contents.end() - next <= STREAM_CATCHUP;
+                if (!locked) _lock.release();
+            }
+            size_t end = contents.end();
+            std::string live;
+            _frame(FRAME_Live, std::string(), live);
+            _enqueue(*fresh, std::make_shared<const std::string>(std::move(live)));
+            fresh->start = end;
+            _clients.push_back(fresh);
+            _lock.release();
+        }
+    }
+
+    bool streamer::_thread_flush(client& target) {
+        while (!target.queue.empty()) {
+            // Gather several packets into one send
+            WSABUF buffers[STREAM_GATHER];
+            DWORD count = 0;
+            for (size_t i = 0; i < target.queue.size() && count < STREAM_GATHER; i++, count++) {
+                size_t skip = i ? 0 : target.offset;
+                buffers[count].buf = const_cast<char*>(target.queue[i]->data()) + skip;
+                buffers[count].len = static_cast<ULONG>(target.queue[i]->size() - skip);
+            }
+
+            DWORD sent = 0;
+            if (WSASend(target.socket, buffers, count, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+                return WSAGetLastError() == WSAEWOULDBLOCK;
+
+            // Retire whatever went out, the rest waits for FD_WRITE
+            while (sent > 0) {
+                size_t left = target.queue.front()->size() - target.offset;
+                if (sent < left) { target.offset += sent; break; }
+                sent -= static_cast<DWORD>(left);
+                target.queued -= target.queue.front()->size();
+                target.queue.pop_front();
+                target.offset = 0;
+            }
+        }
+        return true;
+    }
+
+    void streamer::_encode(size_t index, const scrollback::line& entry, std::string& out) {
+        std::wstring text;
+        std::vector<highlighter::run> runs;
+        if (entry.text.compare(0, 5, L"{\\rtf") == 0) exporter::text(std::wstring(entry.text.begin(), entry.text.end()), text);
+        else {
+            text.assign(entry.text.begin(), entry.text.end());
+            _styles.apply(text, runs);
+        }
+
+        // Runs are sorted and disjoint, so their UTF-8 offsets come from converting in pieces
+        std::string body, styles;
+        size_t position = 0;
+        for (size_t i = 0; i < runs.size(); i++) {
+            exporter::utf8(text.substr(position, runs[i].start - position), body);
+            size_t start = body.size();
+            exporter::utf8(text.substr(runs[i].start, runs[i].length), body);
+            position = runs[i].start + runs[i].length;
+            _put(styles, start, 4);
+            _put(styles, body.size() - start, 4);
+            const style& format = style_table::lookup(runs[i].format);
+            _put(styles, format.colour, 4);
+            _put(styles, format.bold ? 1 : 0, 1);
+        }
+        exporter::utf8(text.substr(position), body);
+
+        std::string payload;
+        payload.reserve(30 + styles.size() + body.size());
+        _put(payload, index, 8);
+        _put(payload, entry.level, 1);
+        _put(payload, entry.category, 1);
+        _put(payload, entry.stamp, 8);
+        _put(payload, entry.repeats, 4);
+        _put(payload, runs.size(), 4);
+        payload.append(styles).append(body);
+        _frame(FRAME_Text, payload, out);
+    }
+
+    void streamer::_frame(frame type, const std::string& payload, std::string& out) {
+        _put(out, payload.size() + 1, 4);
+        _put(out, type, 1);
+        out.append(payload);
+    }
+
+    void streamer::_put(std::string& out, unsigned long long value, int bytes) {
+        for (int i = 0; i < bytes; i++)
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    void streamer::_enqueue(client& target, const packet& data) {
+        if (target.queued + data->size() > STREAM_LIMIT) {
+            // Skip ahead, only a packet already partly sent stays so frames remain whole
+            size_t keep = target.offset ? 1 : 0;
+            size_t dropped = target.queue.size() - keep;
+            while (target.queue.size() > keep) {
+                target.queued -= target.queue.back()->size();
+                target.queue.pop_back();
+            }
+            if (dropped) {
+                std::string payload, notice;
+                _put(payload, dropped, 4);
+                _frame(FRAME_Skipped, payload, notice);
+                target.queued += notice.size();
+                target.queue.push_back(std::make_shared<const std::string>(std::move(notice)));
+            }
+        }
+        target.queued += data->size();
+        target.queue.push_back(data);
+    }
+
+    void streamer::_close(client* target) {
+        closesocket(target->socket);
+        WSACloseEvent(target->event);
+        delete target;
+    }
+}
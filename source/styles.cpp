@@ -0,0 +1,90 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Text style implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Returned for identifiers not handed out, all zero like a default style
+    static const style STYLES_Plain;
+
+    // Globals, constant initialized so they are ready before any constructor runs
+    INIT_ONCE style_table::_once = INIT_ONCE_STATIC_INIT;
+    style_table::storage* style_table::_table = NULL;
+
+    style_table::id style_table::intern(const style& format) {
+        storage& table = _storage();
+        table.guard.acquire();
+
+        std::unordered_map<unsigned long long, id>::const_iterator found = table.ids.find(_key(format));
+        if (found != table.ids.end()) {
+            id result = found->second;
+            table.guard.release();
+            return result;
+        }
+
+        // Once every identifier is taken new styles fall back to plain
+        size_t count = table.size.load(std::memory_order_relaxed);
+        if (count >= STYLE_Count) {
+            table.guard.release();
+            return STYLE_Plain;
+        }
+
+        // Store the style before publishing it, readers never see it half written
+        if (count % STYLE_Chunk == 0) table.chunks[count / STYLE_Chunk] = new style[STYLE_Chunk];
+        table.chunks[count / STYLE_Chunk][count % STYLE_Chunk] = format;
+        id result = static_cast<id>(count);
+        table.ids[_key(format)] = result;
+        table.size.store(count + 1, std::memory_order_release);
+        table.guard.release();
+        return result;
+    }
+
+    const style& style_table::lookup(id which) {
+        storage& table = _storage();
+        if (which >= table.size.load(std::memory_order_acquire)) return STYLES_Plain;
+        return table.chunks[which / STYLE_Chunk][which % STYLE_Chunk];
+    }
+
+    size_t style_table::size() {
+        return _storage().size.load(std::memory_order_acquire);
+    }
+
+    BOOL CALLBACK style_table::_callback_initialize(INIT_ONCE*, void*, void**) {
+        // The plain style always comes first, the table lives as long as the process
+        storage* table = new storage();
+        table->chunks[0] = new style[STYLE_Chunk];
+        table->ids[_key(style())] = STYLE_Plain;
+        table->size.store(1, std::memory_order_relaxed);
+        _table = table;
+        return TRUE;
+    }
+
+    style_table::storage& style_table::_storage() {
+        InitOnceExecuteOnce(&_once, _callback_initialize, NULL, NULL);
+        return *_table;
+    }
+
+    unsigned long long style_table::_key(const style& format) {
+        return static_cast<unsigned long long>(format.colour) | (static_cast<unsigned long long>(format.bold) << 32);
+    }
+}
@@ -0,0 +1,127 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Timestamp implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // System time units per second
+    static const long long TIMESTAMP_Units = 10000000;
+
+    // Globals
+    timestamp::calibration timestamp::_calibration;
+    INIT_ONCE timestamp::_once = INIT_ONCE_STATIC_INIT;
+
+    timestamp::tick timestamp::now() {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return static_cast<tick>(counter.QuadPart);
+    }
+
+    const timestamp::calibration& timestamp::calibrated() {
+        InitOnceExecuteOnce(&_once, _callback_calibrate, NULL, NULL);
+        return _calibration;
+    }
+
+    BOOL CALLBACK timestamp::_callback_calibrate(INIT_ONCE*, void*, void**) {
+        // Pair the counter with the system clock, bracketing the read to tighten it
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        FILETIME system;
+        tick before = now();
+        GetSystemTimeAsFileTime(&system);
+        tick after = now();
+
+        _calibration.origin = before + (after - before) / 2;
+        _calibration.wall = (static_cast<unsigned long long>(system.dwHighDateTime) << 32) | system.dwLowDateTime;
+        _calibration.frequency = static_cast<tick>(frequency.QuadPart);
+        return TRUE;
+    }
+
+    unsigned long long timestamp::wall(tick stamp, const calibration& base) {
+        // Split into whole seconds first so the scaling cannot overflow
+        long long delta = static_cast<long long>(stamp - base.origin);
+        long long frequency = static_cast<long long>(base.frequency);
+        long long units = (delta / frequency) * TIMESTAMP_Units + (delta % frequency) * TIMESTAMP_Units / frequency;
+        return base.wall + units;
+    }
+
+    std::wstring timestamp::text(tick stamp) {
+        unsigned long long units = wall(stamp, calibrated());
+        FILETIME system;
+        system.dwLowDateTime = static_cast<DWORD>(units);
+        system.dwHighDateTime = static_cast<DWORD>(units >> 32);
+
+        SYSTEMTIME universal, local;
+        FileTimeToSystemTime(&system, &universal);
+        SystemTimeToTzSpecificLocalTime(NULL, &universal, &local);
+
+        wchar_t buffer[32];
+        swprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), L"%02u:%02u:%02u.%03u",
+            local.wHour, local.wMinute, local.wSecond, local.wMilliseconds);
+        return buffer;
+    }
+
+    double timestamp::seconds(tick elapsed) {
+        return static_cast<double>(static_cast<long long>(elapsed)) / calibrated().frequency;
+    }
+
+    latency::latency()
+        : _count(0), _total(0), _max(0)
+    {
+        memset(_buckets, 0, sizeof(_buckets));
+    }
+
+    void latency::record(timestamp::tick elapsed) {
+        // Bucket by the highest set bit of the delay in microseconds
+        unsigned long long micros = static_cast<unsigned long long>(timestamp::seconds(elapsed) * 1e6);
+        int bucket = 0;
+        while ((micros >>= 1) != 0 && bucket < BUCKET_Count - 1) bucket++;
+
+        _lock.acquire();
+        _buckets[bucket]++;
+        _count++;
+        _total += elapsed;
+        if (elapsed > _max) _max = elapsed;
+        _lock.release();
+    }
+
+    latency::summary latency::snapshot() {
+        summary result;
+        _lock.acquire();
+        result.count = _count;
+        result.mean = _count ? timestamp::seconds(_total) / _count : 0.0;
+        result.max = timestamp::seconds(_max);
+
+        // Percentiles are reported as the upper bound of their bucket
+        result.p50 = result.p99 = 0.0;
+        unsigned long long seen = 0;
+        for (int i = 0; i < BUCKET_Count && _count; i++) {
+            seen += _buckets[i];
+            double bound = static_cast<double>(2ull << i) / 1e6;
+            if (result.p50 == 0.0 && seen * 2 >= _count) result.p50 = bound;
+            if (result.p99 == 0.0 && seen * 100 >= _count * 99) result.p99 = bound;
+        }
+        _lock.release();
+        return result;
+    }
+}
@@ -0,0 +1,164 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input tokenizer implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    command_tokenizer::command_tokenizer(commands* known)
+        : _known(known)
+    {
+        _command = style_table::intern(style(RGB(0x1E, 0x64, 0xC8), true));
+        _unknown = style_table::intern(style(RGB(0xC8, 0x28, 0x28), true));
+        _option = style_table::intern(style(RGB(0x8C, 0x50, 0xC8)));
+        _number = style_table::intern(style(RGB(0x00, 0x8C, 0x6E)));
+        _string = style_table::intern(style(RGB(0xB4, 0x64, 0x00)));
+    }
+
+    size_t command_tokenizer::next(const std::wstring& text, size_t position, state& current, style_table::id& format) {
+        size_t end = position;
+        size_t limit = (std::min)(text.size(), position + TOKEN_Longest);
+        wchar_t c = text[position];
+
+        // Strings run to their closing quote, long ones come in pieces
+        if (current == STATE_String) {
+            format = _string;
+            while (end < limit && text[end] != L'"') end += (text[end] == L'\\' && end + 1 < text.size()) ? 2 : 1;
+            if (end < limit) {
+                end++;
+                current = STATE_Arguments;
+            }
+            return (std::min)(end, text.size());
+        }
+
+        // Line breaks start a new command, other blanks change nothing
+        format = style_table::STYLE_Plain;
+        if (c == L'\r' || c == L'\n') {
+            current = STATE_Command;
+            return position + 1;
+        }
+        if (iswspace(c)) {
+            while (end < limit && iswspace(text[end]) && text[end] != L'\r' && text[end] != L'\n') end++;
+            return end;
+        }
+        if (c == L'"') {
+            current = STATE_String;
+            return (position + 1 < text.size()) ? next(text, position + 1, current, format) : position + 1;
+        }
+
+        // Everything else is a word up to the next blank or quote
+        while (end < limit && !iswspace(text[end]) && text[end] != L'"') end++;
+        if (current == STATE_Command) {
+            current = STATE_Arguments;
+            format = (_known && !_known->empty() && !_known->exists(text.substr(position, end - position))) ? _unknown : _command;
+        } else if (c == L'-' && end > position + 1 && !iswdigit(text[position + 1]) && text[position + 1] != L'.') {
+            format = _option;
+        } else {
+            size_t digits = (c == L'-' || c == L'+') ? position + 1 : position;
+            if (digits < end && text.find_first_not_of(L"0123456789.xXabcdefABCDEF", digits) >= end && iswdigit(text[digits]))
+                format = _number;
+        }
+        return end;
+    }
+
+    lexer::lexer()
+        : _rules(NULL), _resume(0), _state(0), _dirty(0), _length(0) {}
+
+    void lexer::rules(tokenizer* rules) {
+        _rules = rules;
+        _tokens.clear();
+        _tail.clear();
+        _resume = 0;
+        _state = rules ? rules->initial() : 0;
+        _dirty = 0;
+        _length = 0;
+    }
+
+    void lexer::edit(size_t position, size_t removed, size_t inserted) {
+        // Lex again from the first token reaching the edit, since it may grow
+        size_t keep = 0;
+        while (keep < _tokens.size() && _tokens[keep].start + _tokens[keep].length < position) keep++;
+
+        // Tokens past the edit stay around to converge on, moved along with the text.
+        // Remembered tokens already lexed over are stale and dropped. Unless lexing
+        // had reached the end, where they meet the tokens lexed since is unchecked.
+        size_t seam = (_resume < _length) ? _resume : 0;
+        _scratch.assign(_tokens.begin() + keep, _tokens.end());
+        for (size_t i = 0; i < _tail.size(); i++)
+            if (_tail[i].start >= _resume) _scratch.push_back(_tail[i]);
+        if (keep < _tokens.size()) {
+            _resume = _tokens[keep].start;
+            _state = _tokens[keep].entry;
+        }
+        _tokens.resize(keep);
+        _tail.clear();
+        for (size_t i = 0; i < _scratch.size(); i++) {
+            if (_scratch[i].start < position + removed) continue;
+            _tail.push_back(_scratch[i]);
+            _tail.back().start = _scratch[i].start - removed + inserted;
+        }
+
+        // Convergence is only safe past the end of every edit
+        if (_dirty >= position + removed) _dirty = _dirty - removed + inserted;
+        if (seam >= position + removed) seam = seam - removed + inserted;
+        _length = _length - removed + inserted;
+        _dirty = (std::max)((std::max)(_dirty, seam), position + inserted);
+    }
+
+    bool lexer::update(const std::wstring& text, size_t budget, size_t& from, size_t& to) {
+        from = to = _resume;
+        _length = text.size();
+        if (!_rules) return true;
+        size_t lexed = 0, next = 0;
+        while (_resume < text.size()) {
+            if (lexed >= budget) {
+                to = _resume;
+                return false;
+            }
+
+            // Meeting a remembered token in the state it was lexed from, nothing after it changes
+            while (next < _tail.size() && _tail[next].start < _resume) next++;
+            if (next < _tail.size() && _tail[next].start == _resume && _resume >= _dirty && _tail[next].entry == _state) {
+                // The state at the end is not needed, every edit resumes from a token's own
+                _tokens.insert(_tokens.end(), _tail.begin() + next, _tail.end());
+                to = _resume;
+                _resume = text.size();
+                _tail.clear();
+                _dirty = 0;
+                return true;
+            }
+
+            token current;
+            current.start = _resume;
+            current.entry = _state;
+            size_t end = _rules->next(text, _resume, _state, current.format);
+            current.length = end - _resume;
+            _tokens.push_back(current);
+            lexed += current.length;
+            _resume = end;
+        }
+        to = _resume;
+        _tail.clear();
+        _dirty = 0;
+        return true;
+    }
+}
@@ -0,0 +1,94 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   UI thread stall detection implementation
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "core.hpp"
+
+namespace db
+{
+    // Turns taking longer than this are stalls unless told otherwise
+    static const double WATCHDOG_THRESHOLD = 0.1;
+
+    watchdog::watchdog()
+        : _slowest_count(0), _floor(0), _limit(0), _entered(0), _count(0), _stalls(0), _busy(0)
+    {
+        threshold(WATCHDOG_THRESHOLD);
+    }
+
+    void watchdog::threshold(double seconds) {
+        _lock.acquire();
+        _limit = static_cast<timestamp::tick>(seconds * timestamp::calibrated().frequency);
+        _lock.release();
+    }
+
+    void watchdog::leave(source kind, unsigned message, size_t payload) {
+        timestamp::tick start = _entered.load(std::memory_order_relaxed);
+        timestamp::tick elapsed = timestamp::now() - start;
+        _entered.store(0, std::memory_order_relaxed);
+
+        _lock.acquire();
+        _count++;
+        _busy += elapsed;
+        if (elapsed >= _limit) _stalls++;
+
+        // Only turns beating the shortest one kept are worth a look
+        if (elapsed > _floor || _slowest_count < SLOWEST_Count) {
+            size_t slot = _slowest_count;
+            if (slot < SLOWEST_Count) _slowest_count++;
+            else {
+                slot = 0;
+                for (size_t i = 1; i < SLOWEST_Count; i++)
+                    if (_slowest[i].seconds < _slowest[slot].seconds) slot = i;
+            }
+            sample& entry = _slowest[slot];
+            entry.kind = kind;
+            entry.message = message;
+            entry.payload = payload;
+            entry.stamp = start;
+            entry.seconds = timestamp::seconds(elapsed);
+
+            // The floor is the shortest turn kept once the ring is full
+            if (_slowest_count == SLOWEST_Count) {
+                double shortest = _slowest[0].seconds;
+                for (size_t i = 1; i < SLOWEST_Count; i++) shortest = (std::min)(shortest, _slowest[i].seconds);
+                _floor = static_cast<timestamp::tick>(shortest * timestamp::calibrated().frequency);
+            }
+        }
+        _lock.release();
+    }
+
+    watchdog::summary watchdog::snapshot() {
+        summary result;
+        _lock.acquire();
+        timestamp::tick entered = _entered.load(std::memory_order_relaxed);
+        result.count = _count;
+        result.stalls = _stalls;
+        result.busy = timestamp::seconds(_busy);
+        result.current = entered ? timestamp::seconds(timestamp::now() - entered) : 0.0;
+        result.slowest.assign(_slowest, _slowest + _slowest_count);
+        _lock.release();
+
+        std::sort(result.slowest.begin(), result.slowest.end(), [](const sample& a, const sample& b) {
+            return a.seconds > b.seconds;
+        });
+        return result;
+    }
+}
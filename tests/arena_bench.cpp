@@ -0,0 +1,84 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Memory resource benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Threads building and dropping message sized strings, as producers and
+// the UI thread do, through the global heap, one shared pool and a pool
+// each. How much the pool's stripes help depends on the cores there are.
+//
+typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, allocator<wchar_t> > text;
+
+struct worker {
+    memory_resource* memory;
+    long count;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        worker& self = *static_cast<worker*>(parameter);
+        allocator<wchar_t> source(self.memory);
+        for (long i = 0; i < self.count; i++) {
+            text message(L"a message long enough to need its own allocation", source);
+            message.append(L" and then some");
+            check::keep(message);
+        }
+        return 0;
+    }
+};
+
+static double measure(memory_resource* shared, bool own, int threads, long count) {
+    std::vector<pool*> pools;
+    std::vector<worker> workers(threads);
+    std::vector<HANDLE> handles;
+    double start = check::seconds();
+    for (int i = 0; i < threads; i++) {
+        if (own) pools.push_back(new pool());
+        worker current = { own ? pools.back() : shared, count };
+        workers[i] = current;
+        handles.push_back(CreateThread(NULL, 0, worker::run, &workers[i], 0, NULL));
+    }
+    WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), TRUE, INFINITE);
+    double elapsed = check::seconds() - start;
+    for (size_t i = 0; i < handles.size(); i++) CloseHandle(handles[i]);
+    for (size_t i = 0; i < pools.size(); i++) delete pools[i];
+    return elapsed / (threads * count) * 1e9;
+}
+
+int main(int argc, char** argv) {
+    const long count = static_cast<long>(1000000 * check::scale(argc, argv));
+    SYSTEM_INFO system;
+    GetSystemInfo(&system);
+
+    std::printf("arena: %u cores\n", system.dwNumberOfProcessors);
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        pool shared;
+        double heap = measure(memory_resource::heap(), false, threads, count / threads);
+        double pooled = measure(&shared, false, threads, count / threads);
+        double owned = measure(NULL, true, threads, count / threads);
+        std::printf("arena: %d threads, heap %.0f ns, shared pool %.0f ns, pool each %.0f ns per message\n",
+            threads, heap, pooled, owned);
+    }
+    return 0;
+}
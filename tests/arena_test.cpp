@@ -0,0 +1,171 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Memory resource tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+// Tracks what is taken from the heap through it
+class counting : public memory_resource {
+public:
+    counting() : live(0), calls(0) {}
+    void* allocate(size_t bytes, size_t) { live += bytes; calls++; return ::operator new(bytes); }
+    void deallocate(void* pointer, size_t bytes, size_t) { live -= bytes; ::operator delete(pointer); }
+    std::atomic<size_t> live;
+    std::atomic<size_t> calls;
+};
+
+static void test_arena() {
+    counting upstream;
+    {
+        arena memory(&upstream, 4096);
+        char* first = static_cast<char*>(memory.allocate(3, 1));
+        void* aligned = memory.allocate(8, 64);
+        CHECK(reinterpret_cast<size_t>(aligned) % 64 == 0);
+        CHECK(static_cast<char*>(aligned) > first);
+
+        // Requests bigger than a chunk get one of their own
+        memory.allocate(10000);
+        CHECK(upstream.calls == 2);
+        CHECK(memory.used() == upstream.live);
+        memory.release();
+        CHECK(upstream.live == 0 && memory.used() == 0);
+        memory.allocate(16);
+    }
+    CHECK(upstream.live == 0);
+}
+
+static void test_pool() {
+    counting upstream;
+    {
+        pool memory(0, &upstream);
+        void* small = memory.allocate(24);
+        memory.deallocate(small, 24);
+        CHECK(memory.allocate(30) == small);
+        CHECK(upstream.calls == 1 && memory.used() == pool::POOL_Slab);
+
+        // Large requests go upstream, and back when freed
+        void* big = memory.allocate(100000);
+        CHECK(upstream.calls == 2);
+        memory.deallocate(big, 100000);
+        CHECK(memory.used() == pool::POOL_Slab);
+        memory.allocate(100000);
+    }
+    CHECK(upstream.live == 0);
+
+    // A limit is enforced across slabs and large blocks
+    {
+        pool limited(1 << 20, &upstream);
+        size_t count = 0;
+        bool refused = false;
+        try {
+            for (;; count++) limited.allocate(100);
+        } catch (const std::bad_alloc&) {
+            refused = true;
+        }
+        CHECK(refused && count > 0 && limited.used() <= (1u << 20));
+    }
+    CHECK(upstream.live == 0);
+}
+
+struct churn {
+    pool* memory;
+    unsigned seed;
+    bool intact;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        // Blocks are written while held and checked before they go back
+        churn& self = *static_cast<churn*>(parameter);
+        std::vector<std::pair<unsigned*, size_t> > held;
+        unsigned seed = self.seed;
+        for (int i = 0; i < 200000; i++) {
+            seed = seed * 1103515245 + 12345;
+            if (held.size() < 64 && (seed >> 16) % 3) {
+                size_t bytes = 16 + (seed >> 8) % 2000;
+                unsigned* block = static_cast<unsigned*>(self.memory->allocate(bytes));
+                for (size_t j = 0; j < bytes / sizeof(unsigned); j++) block[j] = static_cast<unsigned>(bytes);
+                held.push_back(std::make_pair(block, bytes));
+            } else if (!held.empty()) {
+                std::pair<unsigned*, size_t> block = held[(seed >> 16) % held.size()];
+                for (size_t j = 0; j < block.second / sizeof(unsigned); j++)
+                    if (block.first[j] != block.second) self.intact = false;
+                held.erase(std::find(held.begin(), held.end(), block));
+                self.memory->deallocate(block.first, block.second);
+            }
+        }
+        for (size_t i = 0; i < held.size(); i++) self.memory->deallocate(held[i].first, held[i].second);
+        return 0;
+    }
+};
+
+static void test_threads() {
+    // Threads share a pool without handing out a block twice
+    counting upstream;
+    {
+        pool memory(0, &upstream);
+        churn workers[4];
+        HANDLE threads[4];
+        for (int i = 0; i < 4; i++) {
+            workers[i].memory = &memory;
+            workers[i].seed = i + 1;
+            workers[i].intact = true;
+            threads[i] = CreateThread(NULL, 0, churn::run, &workers[i], 0, NULL);
+        }
+        WaitForMultipleObjects(4, threads, TRUE, INFINITE);
+        for (int i = 0; i < 4; i++) {
+            CloseHandle(threads[i]);
+            CHECK(workers[i].intact);
+        }
+    }
+    CHECK(upstream.live == 0);
+}
+
+static void test_owners() {
+    // Scrollback and mailbox storage comes from the resource they are given
+    counting upstream;
+    {
+        pool memory(0, &upstream);
+        scrollback lines(5000, &memory);
+        for (int i = 0; i < 20000; i++)
+            lines.append(L"a reasonably long line of console output " + std::to_wstring(static_cast<long long>(i)), 1, 0);
+        CHECK(upstream.live > 0);
+
+        // Copies of lines live on the heap
+        scrollback::line copy;
+        CHECK(lines.get(19999, copy) && copy.text.get_allocator().resource() == memory_resource::heap());
+        CHECK(copy.text == scrollback::string(L"a reasonably long line of console output 19999"));
+
+        mail output(8, &memory);
+        std::wstring received;
+        CHECK(output.send(L"through the pool", 0) && output.recv(received, 0) && received == L"through the pool");
+    }
+    CHECK(upstream.live == 0);
+}
+
+int main() {
+    test_arena();
+    test_pool();
+    test_threads();
+    test_owners();
+    return check::finish("arena");
+}
@@ -0,0 +1,88 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output backlog tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+// Ticks in the given number of seconds
+static timestamp::tick ticks(double seconds) {
+    return static_cast<timestamp::tick>(seconds * timestamp::calibrated().frequency);
+}
+
+// Handles messages with the queue at one depth, returns whether behind after each
+static bool feed(backlog& state, size_t count, size_t waiting, timestamp::tick& now, double spacing) {
+    bool behind = state.behind();
+    for (size_t i = 0; i < count; i++) {
+        now += ticks(spacing);
+        behind = state.handled(waiting, now);
+    }
+    return behind;
+}
+
+static void test_falling_behind() {
+    timestamp::tick now = timestamp::now();
+
+    // A deep queue that is cheap to draw is drained, not skipped
+    backlog cheap;
+    cheap.capacity(1024);
+    cheap.rendered(ticks(0.00001));
+    CHECK(!feed(cheap, 1000, 1000, now, 0.0001));
+
+    // An expensive one has to stay deep for a while first
+    backlog costly;
+    costly.capacity(1024);
+    costly.rendered(ticks(0.001));
+    CHECK(!feed(costly, 63, 600, now, 0.0001));
+    CHECK(!feed(costly, 1, 100, now, 0.0001));
+    CHECK(!feed(costly, 63, 600, now, 0.0001));
+    CHECK(feed(costly, 1, 600, now, 0.0001));
+    CHECK(costly.behind());
+}
+
+static void test_catching_up() {
+    timestamp::tick now = timestamp::now();
+    backlog state;
+    state.capacity(1024);
+    state.rendered(ticks(0.001));
+    CHECK(feed(state, 64, 600, now, 0.0001));
+
+    // Output still pouring in keeps the console behind, however short the queue
+    CHECK(feed(state, 3000, 50, now, 0.0001));
+    CHECK(state.check(50, now + ticks(0.3)));
+
+    // A shallow queue with a trickle of output is caught up on after a whole window
+    now += ticks(0.3);
+    CHECK(feed(state, 10, 50, now, 0.01));
+    CHECK(!state.check(50, now + ticks(0.3)));
+
+    // The timer alone can find it caught up as well
+    CHECK(feed(state, 64, 600, now, 0.0001));
+    CHECK(state.check(50, now + ticks(0.1)));
+    CHECK(!state.check(50, now + ticks(0.3)));
+}
+
+int main() {
+    test_falling_behind();
+    test_catching_up();
+    return check::finish("backlog");
+}
@@ -0,0 +1,79 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input broadcast benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+// Counts lines until the broadcast closes
+struct reader {
+    subscription source;
+    std::atomic<size_t> lines;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        reader* self = static_cast<reader*>(parameter);
+        std::wstring buffer;
+        while (self->source.read(buffer, INFINITE)) self->lines++;
+        return 0;
+    }
+};
+
+// Seconds per line handed to every one of the given readers
+static double fanout(size_t count, int readers) {
+    broadcast log(1024);
+    std::vector<reader> all(readers);
+    std::vector<HANDLE> threads;
+    for (int i = 0; i < readers; i++) {
+        all[i].source = log.subscribe();
+        all[i].lines = 0;
+        threads.push_back(CreateThread(NULL, 0, reader::run, &all[i], 0, NULL));
+    }
+
+    std::wstring line(60, L'x');
+    line += L"\r";
+    double start = check::seconds();
+    for (size_t i = 0; i < count; i++) log.publish(line, broadcast::ROUTE_Typed, INFINITE);
+    for (int i = 0; i < readers; i++)
+        while (all[i].lines < count) Sleep(0);
+    double elapsed = check::seconds() - start;
+
+    log.close();
+    for (int i = 0; i < readers; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    return elapsed / count;
+}
+
+//
+// Typed lines handed to one, two and eight subscribers, each reading on a
+// thread of its own. Frames are stored once however many subscribe.
+//
+int main(int argc, char** argv) {
+    const size_t count = static_cast<size_t>(200000 * check::scale(argc, argv));
+    double one = fanout(count, 1);
+    double two = fanout(count, 2);
+    double eight = fanout(count, 8);
+    std::printf("broadcast: %zu lines, 1 reader %.0f ns, 2 readers %.0f ns, 8 readers %.0f ns per line\n",
+        count, one * 1e9, two * 1e9, eight * 1e9);
+    return 0;
+}
@@ -0,0 +1,176 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input broadcast tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+// Reads a subscription until it is closed
+struct drain {
+    subscription source;
+    std::vector<std::wstring> lines;
+    std::atomic<size_t> received;   // Lines so far, for watching from outside
+    bool failed;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        drain* self = static_cast<drain*>(parameter);
+        std::wstring buffer;
+        for (;;) {
+            result outcome = self->source.read(buffer, INFINITE);
+            if (!outcome) {
+                self->failed = outcome.kind() != result::RESULT_Closed;
+                return 0;
+            }
+            self->lines.push_back(buffer);
+            self->received++;
+        }
+    }
+
+    HANDLE start(const subscription& from) {
+        source = from;
+        received = 0;
+        failed = false;
+        return CreateThread(NULL, 0, run, this, 0, NULL);
+    }
+};
+
+// A numbered frame, some of them carrying a second line
+static std::wstring frame(int number) {
+    std::wstring text = (number % 2 ? L"cmd " : L"log ") + std::to_wstring(static_cast<long long>(number)) + L"\r";
+    if (number % 5 == 0) text += L"cmd x" + std::to_wstring(static_cast<long long>(number)) + L"\r";
+    return text;
+}
+
+// Publishes numbered frames over both routes
+struct publisher {
+    broadcast* log;
+    int count;
+    bool failed;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        publisher* self = static_cast<publisher*>(parameter);
+        self->failed = false;
+        for (int i = 0; i < self->count; i++) {
+            unsigned route = (i % 3) ? broadcast::ROUTE_Typed : broadcast::ROUTE_Injected;
+            if (!self->log->publish(frame(i), route, INFINITE)) self->failed = true;
+        }
+        return 0;
+    }
+};
+
+static void test_fanout() {
+    const int count = 20000;
+    pool memory(0);
+    broadcast log(8, &memory);
+
+    // Everything, a prefix, one route, and one subscription read by two threads
+    drain all, commands, injected, shared[2];
+    HANDLE threads[5];
+    threads[0] = all.start(log.subscribe());
+    threads[1] = commands.start(log.subscribe(L"cmd"));
+    threads[2] = injected.start(log.subscribe(std::wstring(), broadcast::ROUTE_Injected));
+    subscription both = log.subscribe();
+    threads[3] = shared[0].start(both);
+    threads[4] = shared[1].start(both);
+
+    publisher source = { &log, count, false };
+    HANDLE writer = CreateThread(NULL, 0, publisher::run, &source, 0, NULL);
+    WaitForSingleObject(writer, INFINITE);
+    CloseHandle(writer);
+    CHECK(!source.failed);
+
+    // Publishing waits for the slowest reader, so only the last frames can still be in flight
+    for (int i = 0; i < 500 && (all.received < static_cast<size_t>(count) ||
+                                shared[0].received + shared[1].received < static_cast<size_t>(count)); i++)
+        Sleep(10);
+    Sleep(50);
+    log.close();
+    for (int i = 0; i < 5; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    CHECK(!all.failed && !commands.failed && !injected.failed && !shared[0].failed && !shared[1].failed);
+
+    // Whole frames in order without a prefix, only the matching lines with one
+    CHECK(all.lines.size() == static_cast<size_t>(count));
+    bool ordered = true;
+    for (int i = 0; i < count && i < static_cast<int>(all.lines.size()); i++)
+        if (all.lines[i] != frame(i)) ordered = false;
+    CHECK(ordered);
+
+    int expected = 0;
+    for (int i = 0; i < count; i++) if (i % 2 || i % 5 == 0) expected++;
+    CHECK(commands.lines.size() == static_cast<size_t>(expected));
+    bool matching = true;
+    for (size_t i = 0; i < commands.lines.size(); i++)
+        if (commands.lines[i].compare(0, 3, L"cmd") != 0 || commands.lines[i].find(L"log") != std::wstring::npos) matching = false;
+    CHECK(matching);
+    CHECK(injected.lines.size() == static_cast<size_t>((count + 2) / 3));
+
+    // Threads sharing a subscription take turns, each line going to one of them
+    std::set<std::wstring> unique;
+    size_t taken = shared[0].lines.size() + shared[1].lines.size();
+    for (int k = 0; k < 2; k++) unique.insert(shared[k].lines.begin(), shared[k].lines.end());
+    CHECK(taken == static_cast<size_t>(count) && unique.size() == taken);
+}
+
+static void test_limits() {
+    broadcast small(2);
+    subscription slow = small.subscribe();
+    std::wstring buffer;
+
+    // The slowest subscriber holds publishing up
+    CHECK(small.publish(L"a", broadcast::ROUTE_Typed, 0));
+    CHECK(small.publish(L"b", broadcast::ROUTE_Typed, 0));
+    CHECK(small.publish(L"c", broadcast::ROUTE_Typed, 0).kind() == result::RESULT_Full);
+    CHECK(small.publish(L"c", broadcast::ROUTE_Typed, 20).kind() == result::RESULT_Timeout);
+    CHECK(slow.read(buffer, 0) && buffer == L"a");
+    CHECK(small.publish(L"c", broadcast::ROUTE_Typed, 0));
+
+    // Until it goes away, and new subscribers only see what comes after them
+    slow.cancel();
+    CHECK(small.publish(L"d", broadcast::ROUTE_Typed, 0) && small.publish(L"e", broadcast::ROUTE_Typed, 0));
+    CHECK(slow.read(buffer, 0).kind() == result::RESULT_Closed);
+    subscription late = small.subscribe();
+    CHECK(late.read(buffer, 0).kind() == result::RESULT_Timeout);
+    CHECK(small.publish(L"f", broadcast::ROUTE_Typed, 0));
+    CHECK(late.read(buffer, 0) && buffer == L"f");
+
+    // A cancelled subscription stays closed after its slot is handed out again
+    late.cancel();
+    subscription again = small.subscribe();
+    CHECK(small.publish(L"g", broadcast::ROUTE_Typed, 0));
+    CHECK(late.read(buffer, 0).kind() == result::RESULT_Closed);
+    late.cancel();
+    CHECK(again.read(buffer, 0) && buffer == L"g");
+
+    // Closing wakes everyone up
+    small.close();
+    CHECK(again.read(buffer, 0).kind() == result::RESULT_Closed);
+    CHECK(small.publish(L"h", broadcast::ROUTE_Typed, 0).kind() == result::RESULT_Closed);
+}
+
+int main() {
+    test_fanout();
+    test_limits();
+    return check::finish("broadcast");
+}
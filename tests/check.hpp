@@ -0,0 +1,78 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Test and benchmark helpers
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#pragma once
+
+#include "core.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+//
+// Failed checks are reported with their location and counted, the test
+// keeps going so one run shows every failure. Benchmarks take an optional
+// scale on the command line to run longer than the defaults.
+//
+#define CHECK(condition) \
+    ((condition) ? static_cast<void>(0) : check::fail(__FILE__, __LINE__, #condition))
+
+namespace check
+{
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    inline void fail(const char* file, int line, const char* condition) {
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+        failures()++;
+    }
+
+    inline int finish(const char* name) {
+        std::printf("%s: %s\n", name, failures() ? "FAILED" : "ok");
+        return failures() ? 1 : 0;
+    }
+
+    inline double seconds() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    inline double scale(int argc, char** argv) {
+        double value = (argc > 1) ? std::atof(argv[1]) : 1.0;
+        return value > 0 ? value : 1.0;
+    }
+
+    // A file name unique to this process, removed by whoever created the file
+    inline std::wstring temporary(const char* name) {
+        std::string path = "/tmp/console-win-" + std::to_string(static_cast<long long>(getpid())) + "-" + name;
+        return std::wstring(path.begin(), path.end());
+    }
+
+    // Keeps the optimizer from dropping a result
+    template <typename T>
+    inline void keep(const T& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+}
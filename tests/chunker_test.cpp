@@ -0,0 +1,139 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input chunking tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+static chunker::source from(const std::wstring& input) {
+    return [&input](size_t begin, size_t end, std::wstring& text) { text.assign(input, begin, end - begin); };
+}
+
+// Frames the whole input, checking every frame on the way
+static std::vector<std::wstring> frames(const std::wstring& input, size_t chunk) {
+    chunker cutter(chunk);
+    cutter.start(input.size());
+    std::vector<std::wstring> result;
+    std::wstring frame;
+    while (!cutter.done() && result.size() <= input.size()) {
+        cutter.next(from(input), frame);
+        result.push_back(frame);
+    }
+    return result;
+}
+
+static void test_lines() {
+    // Frames end on line breaks and put the input back together
+    std::wstring input;
+    for (int i = 0; i < 1000; i++) input += L"line " + std::to_wstring(static_cast<long long>(i)) + ((i % 3) ? L"\r" : L"\r\n");
+    std::vector<std::wstring> cut = frames(input, 64);
+    std::wstring joined;
+    for (size_t i = 0; i < cut.size(); i++) {
+        CHECK(!cut[i].empty() && cut[i].size() <= 64);
+        if (i + 1 < cut.size()) CHECK(cut[i][cut[i].size() - 1] == L'\n' || cut[i][cut[i].size() - 1] == L'\r');
+        if (i > 0) CHECK(cut[i][0] != L'\n');
+        joined += cut[i];
+    }
+    CHECK(joined == input);
+}
+
+static void test_long_lines() {
+    // A line longer than a chunk is split where the chunk ends
+    std::wstring input(150, L'x');
+    input += L"\nlast";
+    std::vector<std::wstring> cut = frames(input, 64);
+    CHECK(cut.size() == 3);
+    if (cut.size() == 3) {
+        CHECK(cut[0].size() == 64 && cut[1].size() == 64);
+        CHECK(cut[2] == std::wstring(22, L'x') + L"\nlast");
+    }
+
+    // Small inputs are a single frame, line breaks or not
+    cut = frames(L"one\ntwo", 64);
+    CHECK(cut.size() == 1 && cut[0] == L"one\ntwo");
+}
+
+static void test_empty_source() {
+    // A source returning nothing ends the input rather than spinning
+    chunker cutter(16);
+    cutter.start(100);
+    std::wstring frame(L"stale");
+    cutter.next([](size_t, size_t, std::wstring&) {}, frame);
+    CHECK(frame.empty() && cutter.done());
+}
+
+//
+// Reads frames until the whole input has arrived
+//
+struct reader {
+    subscription input;
+    size_t expected;
+    std::wstring received;
+    bool whole;
+
+    static DWORD CALLBACK run(void* self) {
+        reader& state = *static_cast<reader*>(self);
+        std::wstring frame;
+        while (state.received.size() < state.expected && state.input.read(frame, INFINITE)) {
+            if (frame.empty() || frame[frame.size() - 1] != L'\n') state.whole = false;
+            state.received += frame;
+        }
+        return 0;
+    }
+};
+
+static void test_framing() {
+    // Frames published into a small ring reach a reader whole and in order,
+    // with the publisher retrying whenever the reader falls behind
+    std::wstring input;
+    for (int i = 0; i < 20000; i++) input += L"> " + std::to_wstring(static_cast<long long>(i)) + L"\n";
+
+    broadcast log(4);
+    reader state;
+    state.input = log.subscribe();
+    state.expected = input.size();
+    state.whole = true;
+    HANDLE thread = CreateThread(NULL, 0, reader::run, &state, 0, NULL);
+
+    chunker cutter(512);
+    cutter.start(input.size());
+    std::wstring frame;
+    while (!cutter.done()) {
+        cutter.next(from(input), frame);
+        while (!log.publish(frame, broadcast::ROUTE_Typed, 0)) Sleep(0);
+    }
+    CHECK(WaitForSingleObject(thread, 10000) == WAIT_OBJECT_0);
+    log.close();
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    CHECK(state.whole);
+    CHECK(state.received == input);
+}
+
+int main() {
+    test_lines();
+    test_long_lines();
+    test_empty_source();
+    test_framing();
+    return check::finish("chunker");
+}
@@ -0,0 +1,73 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Command dispatch benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Latency from dispatch to reply for a trivial command, alone and while
+// every worker is kept busy by long running commands submitted in bulk.
+//
+static void measure(commands& registry, int count, const char* label) {
+    std::vector<double> latencies;
+    latencies.reserve(count);
+    HANDLE replied = CreateEvent(NULL, FALSE, FALSE, NULL);
+    for (int i = 0; i < count; i++) {
+        double start = check::seconds();
+        registry.dispatch(L"ping", [replied](const std::wstring&) { SetEvent(replied); });
+        WaitForSingleObject(replied, INFINITE);
+        latencies.push_back(check::seconds() - start);
+    }
+    CloseHandle(replied);
+
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("commands: %s dispatch latency p50 %.1f us, p99 %.1f us, max %.1f us\n", label,
+        latencies[latencies.size() / 2] * 1e6, latencies[latencies.size() * 99 / 100] * 1e6, latencies.back() * 1e6);
+}
+
+int main(int argc, char** argv) {
+    const int count = static_cast<int>(2000 * check::scale(argc, argv));
+
+    commands registry;
+    std::atomic<bool> stop(false);
+    std::atomic<long> background(0);
+    registry.add(L"ping", [](const commands::arguments&) { return std::wstring(L"pong"); }, 0);
+    registry.add(L"spin", [&](const commands::arguments&) {
+        // Busy for about a millisecond at a time
+        for (double until = check::seconds() + 0.001; check::seconds() < until && !stop;) {}
+        background++;
+        return std::wstring();
+    }, 0);
+
+    measure(registry, count, "idle");
+
+    // Keep far more background work queued than there are workers
+    SYSTEM_INFO info; GetSystemInfo(&info);
+    for (DWORD i = 0; i < info.dwNumberOfProcessors * 64; i++) registry.dispatch(L"spin", commands::output());
+    measure(registry, count / 10, "loaded");
+    stop = true;
+    registry.stop();
+    std::printf("commands: %ld background commands ran\n", background.load());
+    return 0;
+}
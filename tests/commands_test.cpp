@@ -0,0 +1,154 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Command dispatch tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Collects replies from the workers, so the test can wait for a number of them
+//
+class replies {
+public:
+    replies() : _count(0) { _event = CreateEvent(NULL, FALSE, FALSE, NULL); }
+    ~replies() { CloseHandle(_event); }
+
+    commands::output sink() {
+        return [this](const std::wstring& text) {
+            _lock.acquire();
+            _texts.push_back(text);
+            _count++;
+            _lock.release();
+            SetEvent(_event);
+        };
+    }
+
+    bool wait(size_t count) {
+        for (DWORD start = GetTickCount(); GetTickCount() - start < 10000;) {
+            _lock.acquire();
+            bool done = _count >= count;
+            _lock.release();
+            if (done) return true;
+            WaitForSingleObject(_event, 100);
+        }
+        return false;
+    }
+
+    std::vector<std::wstring> texts() {
+        _lock.acquire();
+        std::vector<std::wstring> result(_texts);
+        _lock.release();
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+private:
+    std::vector<std::wstring> _texts;
+    size_t _count;
+    HANDLE _event;
+    lock _lock;
+};
+
+static void test_tokenize() {
+    commands::arguments tokens;
+    commands::tokenize(L"  copy \"a file\" b\\c \"say \\\"hi\\\"\" \"\"", tokens);
+    CHECK(tokens.size() == 5);
+    if (tokens.size() == 5) {
+        CHECK(tokens[0] == L"copy");
+        CHECK(tokens[1] == L"a file");
+        CHECK(tokens[2] == L"b\\c");
+        CHECK(tokens[3] == L"say \"hi\"");
+        CHECK(tokens[4].empty());
+    }
+}
+
+static void test_dispatch() {
+    // Replies outlive the registry, whose workers may still be writing them
+    replies out;
+    commands registry;
+    registry.add(L"echo", [](const commands::arguments& args) {
+        std::wstring text;
+        for (size_t i = 1; i < args.size(); i++) text += args[i];
+        return text;
+    }, 0);
+    registry.add(L"quiet", [](const commands::arguments&) { return std::wstring(); }, 0);
+
+    CHECK(registry.exists(L"echo") && !registry.exists(L"missing"));
+    CHECK(!registry.dispatch(L"missing arguments", out.sink()));
+    CHECK(!registry.dispatch(L"   ", out.sink()));
+    CHECK(registry.dispatch(L"quiet", out.sink()));
+    CHECK(registry.dispatch(L"echo a b", out.sink()));
+    CHECK(out.wait(1));
+    Sleep(20);
+    std::vector<std::wstring> texts = out.texts();
+    CHECK(texts.size() == 1 && texts[0] == L"ab");
+}
+
+static void test_failures() {
+    // Anything a handler throws is reported as its reply
+    replies out;
+    commands registry;
+    registry.add(L"bad", [](const commands::arguments&) -> std::wstring { throw win_exception(ERROR_BAD_FORMAT); }, 0);
+    registry.add(L"odd", [](const commands::arguments&) -> std::wstring { throw 42; }, 0);
+    CHECK(registry.dispatch(L"bad", out.sink()));
+    CHECK(registry.dispatch(L"odd", out.sink()));
+    CHECK(out.wait(2));
+    std::vector<std::wstring> texts = out.texts();
+    CHECK(texts.size() == 2);
+    if (texts.size() == 2) {
+        CHECK(texts[0].compare(0, 5, L"bad: ") == 0);
+        CHECK(texts[1] == L"odd: failed\n");
+    }
+
+    // The workers survived
+    registry.add(L"fine", [](const commands::arguments&) { return std::wstring(L"fine"); }, 0);
+    CHECK(registry.dispatch(L"fine", out.sink()));
+    CHECK(out.wait(3));
+}
+
+static void test_concurrency() {
+    // A command limited to two never runs more than two at a time, however many are queued
+    replies out;
+    commands registry;
+    std::atomic<int> running(0), highest(0);
+    registry.add(L"slow", [&](const commands::arguments&) {
+        int now = ++running;
+        for (int seen = highest; now > seen && !highest.compare_exchange_weak(seen, now);) {}
+        Sleep(2);
+        running--;
+        return std::wstring(L"done");
+    }, 2);
+
+    const size_t count = 40;
+    for (size_t i = 0; i < count; i++) CHECK(registry.dispatch(L"slow", out.sink()));
+    CHECK(out.wait(count));
+    CHECK(highest <= 2 && highest >= 1);
+}
+
+int main() {
+    test_tokenize();
+    test_dispatch();
+    test_failures();
+    test_concurrency();
+    return check::finish("commands");
+}
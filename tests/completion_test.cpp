@@ -0,0 +1,133 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Tab completion tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Offers the prefix with a fixed set of endings. A blocking provider holds
+// every request until released or cancelled, to catch stale results.
+//
+class suffixes : public completion::provider {
+public:
+    suffixes(bool blocking) : _blocking(blocking), _calls(0) { _release = CreateEvent(NULL, TRUE, FALSE, NULL); }
+    ~suffixes() { CloseHandle(_release); }
+
+    virtual void complete(const completion::query& request, std::vector<std::wstring>& candidates) {
+        _calls++;
+        while (_blocking && !request.cancelled() && WaitForSingleObject(_release, 1) == WAIT_TIMEOUT) {}
+        if (request.cancelled()) return;
+        candidates.push_back(request.prefix + L"-one");
+        candidates.push_back(request.prefix + L"-two");
+    }
+
+    void release() { SetEvent(_release); }
+    int calls() const { return _calls.load(); }
+
+private:
+    bool _blocking;
+    std::atomic<int> _calls;
+    HANDLE _release;
+};
+
+// Results are only handed to windows, so without one they are polled for
+static bool wait_results(completion& engine, LONG id, std::vector<std::wstring>& candidates) {
+    for (int i = 0; i < 5000; i++) {
+        if (engine.results(id, candidates)) return true;
+        Sleep(1);
+    }
+    return false;
+}
+
+static void test_lookup() {
+    completion engine;
+    engine.add(L"show");
+    engine.add(L"shutdown");
+    engine.add(L"status");
+    engine.add(L"stop");
+
+    std::vector<std::wstring> candidates;
+    engine.lookup(L"sh", candidates);
+    std::sort(candidates.begin(), candidates.end());
+    CHECK(candidates.size() == 2 && candidates[0] == L"show" && candidates[1] == L"shutdown");
+
+    engine.remove(L"show");
+    candidates.clear();
+    engine.lookup(L"sh", candidates);
+    CHECK(candidates.size() == 1 && candidates[0] == L"shutdown");
+
+    candidates.clear();
+    engine.lookup(L"x", candidates);
+    CHECK(candidates.empty());
+
+    // Without providers there is nothing to ask for
+    CHECK(engine.request(L"s", NULL, 0) == 0);
+}
+
+static void test_providers() {
+    completion engine;
+    suffixes source(false);
+    engine.attach(&source);
+
+    LONG id = engine.request(L"go", NULL, 0);
+    CHECK(id != 0);
+    std::vector<std::wstring> candidates;
+    CHECK(wait_results(engine, id, candidates));
+    CHECK(candidates.size() == 2 && candidates[0] == L"go-one" && candidates[1] == L"go-two");
+
+    // Results are handed out once
+    candidates.clear();
+    CHECK(!engine.results(id, candidates) && candidates.empty());
+}
+
+static void test_stale() {
+    completion engine;
+    suffixes source(true);
+    engine.attach(&source);
+
+    // A newer request supersedes one still running, whose results never show up
+    LONG first = engine.request(L"old", NULL, 0);
+    while (source.calls() == 0) Sleep(1);
+    LONG second = engine.request(L"new", NULL, 0);
+    CHECK(second != first);
+    source.release();
+
+    std::vector<std::wstring> candidates;
+    CHECK(wait_results(engine, second, candidates));
+    CHECK(candidates.size() == 2 && candidates[0] == L"new-one");
+    CHECK(!engine.results(first, candidates));
+
+    // Cancelled requests leave nothing behind either
+    LONG third = engine.request(L"gone", NULL, 0);
+    engine.cancel();
+    Sleep(50);
+    candidates.clear();
+    CHECK(!engine.results(third, candidates) && candidates.empty());
+}
+
+int main() {
+    test_lookup();
+    test_providers();
+    test_stale();
+    return check::finish("completion");
+}
@@ -0,0 +1,114 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Duplicate suppression tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+static void test_window() {
+    dedupe lines;
+    bool repeated = true;
+    CHECK(!lines.enabled());
+    CHECK(lines.track(L"a", 1, 0, repeated) == NULL && !repeated);
+
+    lines.window(2);
+    CHECK(lines.enabled());
+    dedupe::entry* seen = lines.track(L"a", 1, 0, repeated);
+    CHECK(seen && !repeated && seen->count == 1 && seen->marker == -1);
+    seen = lines.track(L"a", 1, 0, repeated);
+    CHECK(seen && repeated && seen->count == 2);
+
+    // Repeats need not be consecutive within the window
+    lines.track(L"b", 1, 0, repeated);
+    seen = lines.track(L"a", 1, 0, repeated);
+    CHECK(repeated && seen->count == 3);
+
+    // The oldest message leaves the window first
+    lines.track(L"c", 1, 0, repeated);
+    CHECK(!repeated);
+    seen = lines.track(L"a", 1, 0, repeated);
+    CHECK(!repeated && seen->count == 1);
+
+    // The same text at another level or category is a different message
+    lines.track(L"a", 2, 0, repeated);
+    CHECK(!repeated);
+    lines.track(L"a", 2, 1, repeated);
+    CHECK(!repeated);
+
+    lines.clear();
+    lines.track(L"a", 2, 1, repeated);
+    CHECK(!repeated);
+}
+
+static void test_model() {
+    // Every message is compared against a plain list of the window
+    const size_t size = 8;
+    dedupe lines;
+    lines.window(size);
+    std::deque<std::pair<std::wstring, size_t> > model;
+    std::srand(9);
+    for (int i = 0; i < 100000; i++) {
+        std::wstring text(1, static_cast<wchar_t>(L'a' + std::rand() % 12));
+        bool repeated = false;
+        dedupe::entry* seen = lines.track(text, 1, 0, repeated);
+
+        bool expected = false;
+        size_t count = 1;
+        for (size_t j = 0; j < model.size() && !expected; j++) {
+            if (model[j].first != text) continue;
+            expected = true;
+            count = ++model[j].second;
+        }
+        if (!expected) {
+            if (model.size() == size) model.pop_front();
+            model.push_back(std::make_pair(text, size_t(1)));
+        }
+        CHECK(repeated == expected && seen->count == count);
+    }
+}
+
+static void test_counters() {
+    dedupe lines;
+    lines.window(4);
+    bool repeated = false;
+    dedupe::entry* first = lines.track(L"first", 1, 0, repeated);
+    dedupe::entry* second = lines.track(L"second", 1, 0, repeated);
+    first->marker = 10;
+    second->marker = 30;
+
+    // Counters after one that changed length move with it
+    lines.shift(10, 2);
+    CHECK(first->marker == 10 && second->marker == 32);
+    lines.shift(0, -1);
+    CHECK(first->marker == 9 && second->marker == 31);
+
+    CHECK(dedupe::label(3) == L" (repeated 3\u00D7)");
+    CHECK(dedupe::label(12345) == L" (repeated 12345\u00D7)");
+}
+
+int main() {
+    test_window();
+    test_model();
+    test_counters();
+    return check::finish("dedupe");
+}
@@ -0,0 +1,71 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Export benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Exports a full scrollback of typical log lines in every format and
+// reports the bytes written per second, formatting on every core.
+//
+int main(int argc, char** argv) {
+    const size_t total = static_cast<size_t>(2000000 * check::scale(argc, argv));
+
+    scrollback lines(total);
+    std::srand(17);
+    for (size_t i = 0; i < total; i++) {
+        std::wstring text = L"2026-10-19 12:00:00 [worker " + std::to_wstring(static_cast<long long>(std::rand() % 16));
+        text += L"] request " + std::to_wstring(static_cast<long long>(i)) + L" completed <ok> after 12 ms\r\n";
+        lines.append(text, std::rand() % scrollback::LEVEL_Count, 0, timestamp::now());
+    }
+
+    const struct { exporter::format kind; const char* name; } formats[] = {
+        { exporter::FORMAT_Plain, "plain" },
+        { exporter::FORMAT_Html, "html" },
+        { exporter::FORMAT_Rtf, "rtf" },
+    };
+
+    std::wstring path = check::temporary("export-bench");
+    exporter target;
+    scrollback::snapshot contents = lines.take();
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        double start = check::seconds();
+        target.write(contents, path.c_str(), formats[i].kind, false);
+        double elapsed = check::seconds() - start;
+
+        HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        CloseHandle(file);
+        std::printf("export: %-5s %zu lines, %.0f MB in %.0f ms, %.2f GB/s\n", formats[i].name, total,
+            size.QuadPart / 1048576.0, elapsed * 1e3, size.QuadPart / elapsed / 1e9);
+    }
+
+    // Stamps are formatted per line and cost the most
+    double start = check::seconds();
+    target.write(contents, path.c_str(), exporter::FORMAT_Plain, true);
+    std::printf("export: plain with stamps in %.0f ms\n", (check::seconds() - start) * 1e3);
+    DeleteFile(path.c_str());
+    return 0;
+}
@@ -0,0 +1,127 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Export tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+static std::string rendered(const scrollback::line& entry, exporter::format kind, bool stamps = false) {
+    std::string out;
+    exporter::render(entry, kind, stamps, out);
+    return out;
+}
+
+static void test_render() {
+    scrollback::line entry;
+    entry.level = scrollback::LEVEL_Error;
+    entry.repeats = 1;
+    entry.text = L"a<b> & \"c\" \u00E9\r\n";
+
+    CHECK(rendered(entry, exporter::FORMAT_Plain) == "a<b> & \"c\" \xC3\xA9\r\n");
+    CHECK(rendered(entry, exporter::FORMAT_Html) == "<span class=\"error\">a&lt;b&gt; &amp; &quot;c&quot; \xC3\xA9\n</span>");
+    CHECK(rendered(entry, exporter::FORMAT_Rtf) == "\\cf4 a<b> & \"c\" \\u233?\\par\n");
+
+    // Repeat counters go before the line break
+    entry.repeats = 3;
+    entry.level = scrollback::LEVEL_Info;
+    entry.text = L"again\n";
+    CHECK(rendered(entry, exporter::FORMAT_Plain) == "again (repeated 3\xC3\x97)\n");
+    CHECK(rendered(entry, exporter::FORMAT_Html) == "again (repeated 3\xC3\x97)\n");
+
+    // Rich text is reduced to what it shows
+    entry.repeats = 1;
+    entry.text = L"{\\rtf1\\ansi{\\fonttbl{\\f0 Arial;}}{\\colortbl;\\red255\\green0\\blue0;}"
+                 L"\\cf1 Hello \\b bold\\b0  caf\\'e9 \\{x\\}\\par}";
+    CHECK(rendered(entry, exporter::FORMAT_Plain) == "Hello bold caf\xC3\xA9 {x}\n");
+}
+
+static void test_stamps() {
+    // Stamps only appear when the console shows them
+    scrollback::line entry;
+    entry.repeats = 1;
+    entry.text = L"stamped\n";
+    entry.stamp = timestamp::now();
+    std::string plain = rendered(entry, exporter::FORMAT_Plain, false);
+    std::string stamped = rendered(entry, exporter::FORMAT_Plain, true);
+    CHECK(plain == "stamped\n");
+    CHECK(std::regex_match(stamped, std::regex("\\[[0-9:.]{12}\\] stamped\n")));
+
+    // Lines written before any stamp was taken never get one
+    entry.stamp = 0;
+    CHECK(rendered(entry, exporter::FORMAT_Plain, true) == "stamped\n");
+}
+
+static std::string contents(const std::wstring& path) {
+    std::string result;
+    HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return result;
+    char buffer[65536];
+    DWORD read = 0;
+    while (ReadFile(file, buffer, sizeof(buffer), &read, NULL) && read) result.append(buffer, read);
+    CloseHandle(file);
+    return result;
+}
+
+static void test_write() {
+    // Ranges formatted in parallel come out in order
+    scrollback lines(100000);
+    std::string expected;
+    for (int i = 0; i < 50000; i++) {
+        std::wstring text = L"line " + std::to_wstring(static_cast<long long>(i)) + L"\n";
+        lines.append(text, scrollback::LEVEL_Info, 0, timestamp::now());
+        expected.append(text.begin(), text.end());
+    }
+
+    std::wstring path = check::temporary("export");
+    exporter target;
+    target.write(lines.take(), path.c_str(), exporter::FORMAT_Plain, false);
+    CHECK(contents(path) == expected);
+
+    target.write(lines.take(), path.c_str(), exporter::FORMAT_Html, false);
+    std::string html = contents(path);
+    CHECK(html.compare(0, 15, "<!DOCTYPE html>") == 0);
+    CHECK(html.find("line 49999\n</pre></body></html>\n") != std::string::npos);
+
+    // An empty scrollback is still a whole document
+    scrollback empty(10);
+    target.write(empty.take(), path.c_str(), exporter::FORMAT_Rtf, true);
+    std::string rtf = contents(path);
+    CHECK(rtf.compare(0, 6, "{\\rtf1") == 0 && rtf.compare(rtf.size() - 2, 2, "}\n") == 0);
+    DeleteFile(path.c_str());
+
+    // Files that cannot be created are reported
+    bool refused = false;
+    try {
+        target.write(lines.take(), L"/nonexistent/directory/export.txt", exporter::FORMAT_Plain, false);
+    } catch (const win_exception&) {
+        refused = true;
+    }
+    CHECK(refused);
+}
+
+int main() {
+    test_render();
+    test_stamps();
+    test_write();
+    return check::finish("exporter");
+}
@@ -0,0 +1,59 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output highlighting benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// One pass over typical log lines with 100 keyword rules plus a line and a
+// token rule. Throughput counts the text as UTF-16, as written on Windows.
+//
+int main(int argc, char** argv) {
+    const size_t characters = static_cast<size_t>(16 * 1024 * 1024 * check::scale(argc, argv));
+
+    highlighter rules;
+    for (int i = 0; i < 100; i++) {
+        wchar_t keyword[32];
+        swprintf(keyword, 32, L"KEY%03dX", i * 7);
+        rules.add(keyword, style(RGB(i, 0, 0)));
+    }
+    rules.add(L"ERROR", style(RGB(255, 0, 0), true), highlighter::SCOPE_Line);
+    rules.add(L"req-", style(RGB(0, 0, 255)), highlighter::SCOPE_Token);
+
+    std::wstring text;
+    while (text.size() < characters) {
+        text += L"2026-10-19 12:00:00 INFO something happened req-1234 id KEY014X ok\r\n";
+        text += L"2026-10-19 12:00:01 ERROR nothing to see in this line at all\r\n";
+    }
+
+    std::vector<highlighter::run> runs;
+    rules.apply(text.substr(0, 64), runs);
+    double start = check::seconds();
+    rules.apply(text, runs);
+    double elapsed = check::seconds() - start;
+
+    std::printf("highlight: %zu runs over %.0f MB, %.2f GB/s\n",
+        runs.size(), text.size() * 2 / 1048576.0, text.size() * 2 / elapsed / 1e9);
+    return 0;
+}
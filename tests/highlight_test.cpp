@@ -0,0 +1,110 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Output highlighting tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+static void test_matches() {
+    // Every result is compared against trying each rule at every position
+    std::srand(7);
+    for (int round = 0; round < 300; round++) {
+        highlighter rules;
+        std::vector<std::wstring> patterns;
+        for (int i = 1 + std::rand() % 6; i > 0; i--) {
+            std::wstring pattern;
+            for (int j = 1 + std::rand() % 4; j > 0; j--) pattern += L"ab c"[std::rand() % 4];
+            rules.add(pattern, style(patterns.size()));
+            patterns.push_back(pattern);
+        }
+        std::wstring text;
+        for (int i = 0; i < 200; i++) text += L"ab cd"[std::rand() % 5];
+
+        // The longest rule ending at each position wins, the earliest of equals
+        std::vector<highlighter::run> expected;
+        for (size_t end = 1; end <= text.size(); end++) {
+            size_t best = patterns.size(), length = 0;
+            for (size_t i = 0; i < patterns.size(); i++) {
+                size_t size = patterns[i].size();
+                if (size <= end && size > length && text.compare(end - size, size, patterns[i]) == 0) {
+                    best = i;
+                    length = size;
+                }
+            }
+            if (best == patterns.size()) continue;
+
+            size_t start = end - length;
+            if (!expected.empty() && start < expected.back().start + expected.back().length) {
+                if (start > expected.back().start || end <= expected.back().start + expected.back().length) continue;
+                expected.pop_back();
+            }
+            style_table::id format = style_table::intern(style(best));
+            if (!expected.empty() && start == expected.back().start + expected.back().length && format == expected.back().format) {
+                expected.back().length = end - expected.back().start;
+                continue;
+            }
+            highlighter::run found = { start, length, format };
+            expected.push_back(found);
+        }
+
+        std::vector<highlighter::run> runs;
+        rules.apply(text, runs);
+        bool same = runs.size() == expected.size();
+        for (size_t i = 0; same && i < runs.size(); i++)
+            same = runs[i].start == expected[i].start && runs[i].length == expected[i].length && runs[i].format == expected[i].format;
+        CHECK(same);
+    }
+}
+
+static void test_scopes() {
+    highlighter rules;
+    CHECK(rules.empty());
+    rules.add(L"", style(1));
+    CHECK(rules.empty());
+    rules.add(L"ERROR", style(RGB(255, 0, 0), true), highlighter::SCOPE_Line);
+    rules.add(L"req-", style(RGB(0, 0, 255)), highlighter::SCOPE_Token);
+    rules.add(L"ok", style(RGB(0, 255, 0)));
+    CHECK(!rules.empty());
+
+    std::wstring text = L"fine ok\r\nan ERROR here\nid req-1234 done";
+    std::vector<highlighter::run> runs;
+    rules.apply(text, runs);
+    CHECK(runs.size() == 3);
+    if (runs.size() != 3) return;
+
+    // A match colours itself, its whole line, or the token around it
+    CHECK(runs[0].start == 5 && runs[0].length == 2);
+    CHECK(runs[1].start == 9 && runs[1].length == 13);
+    CHECK(runs[2].start == 26 && runs[2].length == 8);
+    CHECK(style_table::lookup(runs[1].format) == style(RGB(255, 0, 0), true));
+
+    // Characters no rule uses share one class and never start a match
+    rules.apply(std::wstring(1, static_cast<wchar_t>(0xFFFF)) + L"ok", runs);
+    CHECK(runs.size() == 1 && runs[0].start == 1);
+}
+
+int main() {
+    test_matches();
+    test_scopes();
+    return check::finish("highlight");
+}
@@ -0,0 +1,95 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input history benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Recall from a full history against scanning the lines newest first,
+// which is what recall cost before the index.
+//
+int main(int argc, char** argv) {
+    const size_t entries = static_cast<size_t>(100000 * check::scale(argc, argv));
+    const int queries = 2000;
+
+    std::vector<std::wstring> lines;
+    std::srand(7);
+    for (size_t i = 0; i < entries; i++) {
+        std::wstring line = L"command" + std::to_wstring(static_cast<long long>(std::rand() % 50));
+        line += L" --option " + std::to_wstring(static_cast<long long>(i));
+        lines.push_back(line);
+    }
+
+    history recall(entries);
+    double start = check::seconds();
+    for (size_t i = 0; i < entries; i++) recall.add(lines[i]);
+    double added = check::seconds() - start;
+
+    // The newest line with a prefix that only old lines have
+    std::wstring prefix = L"command1 --option 1";
+    std::wstring line;
+    start = check::seconds();
+    for (int i = 0; i < queries; i++) {
+        recall.reset();
+        recall.previous(prefix, line);
+    }
+    double indexed = check::seconds() - start;
+
+    start = check::seconds();
+    for (int i = 0; i < queries; i++) {
+        for (size_t j = lines.size(); j-- > 0;)
+            if (lines[j].compare(0, prefix.size(), prefix) == 0) { line = lines[j]; break; }
+    }
+    double scanned = check::seconds() - start;
+
+    // Substring recall of something that is not there at all, of something
+    // only old entries hold, and scanning for the latter
+    start = check::seconds();
+    for (int i = 0; i < queries; i++) {
+        recall.reset();
+        recall.search(L"xyz", line);
+    }
+    double missing = (check::seconds() - start) / queries;
+
+    std::wstring old = L"--option " + std::to_wstring(static_cast<long long>(entries / 8 - 1));
+    start = check::seconds();
+    for (int i = 0; i < queries; i++) {
+        recall.reset();
+        recall.search(old, line);
+    }
+    double found = (check::seconds() - start) / queries;
+
+    start = check::seconds();
+    for (size_t j = lines.size(); j-- > 0;)
+        if (lines[j].find(old) != std::wstring::npos) { line = lines[j]; break; }
+    double walked = check::seconds() - start;
+    check::keep(line);
+
+    // Recall is meant to stay under a millisecond however long the history
+    double slowest = (std::max)(missing, found);
+    std::printf("history: %zu entries, add %.0f ns, prefix recall %.0f ns (scan %.0f ns), "
+                "missing substring %.1f us, old substring %.1f us (scan %.0f us), %s 1 ms\n",
+        entries, added / entries * 1e9, indexed / queries * 1e9, scanned / queries * 1e9,
+        missing * 1e6, found * 1e6, walked * 1e6, slowest < 1e-3 ? "under" : "OVER");
+    return slowest < 1e-3 ? 0 : 1;
+}
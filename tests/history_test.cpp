@@ -0,0 +1,199 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input history tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+static void test_radix() {
+    // Every query is compared against a plain map of the same keys
+    radix index;
+    std::map<std::wstring, radix::rank> model;
+    std::srand(1);
+    const wchar_t letters[] = L"abc";
+    for (radix::rank step = 1; step <= 100000; step++) {
+        std::wstring word;
+        for (int i = std::rand() % 6; i > 0; i--) word += letters[std::rand() % 3];
+        if (std::rand() % 3) {
+            index.insert(word, step);
+            model[word] = step;
+        } else {
+            CHECK(index.erase(word) == (model.erase(word) > 0));
+        }
+        CHECK(index.size() == model.size());
+        if (step % 100) continue;
+
+        std::wstring prefix;
+        for (int i = std::rand() % 3; i > 0; i--) prefix += letters[std::rand() % 3];
+        radix::rank below = static_cast<radix::rank>(std::rand()) % (step + 1) + 1;
+
+        std::wstring best;
+        radix::rank highest = 0;
+        std::vector<std::wstring> expected;
+        for (std::map<std::wstring, radix::rank>::const_iterator it = model.begin(); it != model.end(); ++it) {
+            if (it->first.compare(0, prefix.size(), prefix) != 0 || it->first.size() < prefix.size()) continue;
+            expected.push_back(it->first);
+            if (it->second < below && it->second > highest) {
+                highest = it->second;
+                best = it->first;
+            }
+        }
+
+        std::wstring key;
+        radix::rank value = 0;
+        bool found = index.previous(prefix, below, key, value);
+        CHECK(found == (highest != 0));
+        if (found) CHECK(value == highest && key == best);
+
+        std::vector<std::wstring> keys;
+        index.complete(prefix, keys, expected.size() + 1);
+        CHECK(keys == expected);
+    }
+}
+
+static void test_recall() {
+    history lines(16);
+    lines.add(L"make");
+    lines.add(L"git status");
+    lines.add(L"git commit");
+    lines.add(L"ls");
+
+    // Prefix recall walks from the newest matching entry to older ones and back
+    std::wstring line;
+    CHECK(lines.previous(L"git", line) && line == L"git commit");
+    CHECK(lines.previous(L"git", line) && line == L"git status");
+    CHECK(!lines.previous(L"git", line));
+    CHECK(lines.next(L"git", line) && line == L"git commit");
+    lines.reset();
+    CHECK(lines.previous(L"", line) && line == L"ls");
+
+    // Repeated lines are kept once and move to the front
+    lines.add(L"make");
+    CHECK(lines.size() == 4);
+    lines.reset();
+    CHECK(lines.previous(L"", line) && line == L"make");
+    CHECK(lines.previous(L"", line) && line == L"ls");
+
+    // Substring recall
+    lines.reset();
+    CHECK(lines.search(L"stat", line) && line == L"git status");
+    lines.reset();
+    CHECK(!lines.search(L"push", line));
+}
+
+static void test_capacity() {
+    history lines(3);
+    for (int i = 0; i < 10; i++) lines.add(std::to_wstring(static_cast<long long>(i)));
+    CHECK(lines.size() == 3);
+    std::wstring line;
+    CHECK(lines.previous(L"", line) && line == L"9");
+    CHECK(lines.previous(L"", line) && line == L"8");
+    CHECK(lines.previous(L"", line) && line == L"7");
+    CHECK(!lines.previous(L"", line));
+}
+
+static void test_substrings() {
+    // Substring recall through the trigram index agrees with scanning newest first,
+    // across repeats moving to the front, evictions and the index being rebuilt
+    history lines(500);
+    std::vector<std::wstring> model;
+    std::srand(5);
+    const wchar_t letters[] = L"abcd";
+    for (int step = 0; step < 20000; step++) {
+        std::wstring line;
+        for (int i = 1 + std::rand() % 8; i > 0; i--) line += letters[std::rand() % 4];
+        lines.add(line);
+        std::vector<std::wstring>::iterator old = std::find(model.begin(), model.end(), line);
+        if (old != model.end()) model.erase(old);
+        model.push_back(line);
+        if (model.size() > 500) model.erase(model.begin());
+        if (step % 50) continue;
+
+        std::wstring text;
+        for (int i = 1 + std::rand() % 4; i > 0; i--) text += letters[std::rand() % 4];
+        std::vector<std::wstring> expected;
+        for (size_t i = model.size(); i-- > 0;)
+            if (model[i].find(text) != std::wstring::npos) expected.push_back(model[i]);
+
+        lines.reset();
+        std::vector<std::wstring> found;
+        std::wstring match;
+        while (lines.search(text, match)) found.push_back(match);
+        CHECK(found == expected);
+    }
+}
+
+static void test_persistence() {
+    std::wstring path = check::temporary("history");
+    DeleteFile(path.c_str());
+    {
+        history lines(4);
+        lines.open(path.c_str());
+        for (int i = 0; i < 20; i++) lines.add(L"line " + std::to_wstring(static_cast<long long>(i % 6)));
+    }
+
+    // Compaction kept the file loadable, and a torn record at the end is ignored
+    HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    CHECK(file != INVALID_HANDLE_VALUE);
+    SetFilePointer(file, 0, NULL, FILE_END);
+    DWORD torn = 100, written = 0;
+    WriteFile(file, &torn, sizeof(torn), &written, NULL);
+    CloseHandle(file);
+
+    history lines(4);
+    lines.open(path.c_str());
+    CHECK(lines.size() == 4);
+    std::wstring line;
+    CHECK(lines.previous(L"", line) && line == L"line 1");
+    CHECK(lines.previous(L"", line) && line == L"line 0");
+    CHECK(lines.previous(L"", line) && line == L"line 5");
+    CHECK(lines.previous(L"", line) && line == L"line 4");
+    lines.add(L"after");
+    lines.reset();
+    CHECK(lines.previous(L"", line) && line == L"after");
+
+    // Anything but a history file is refused
+    std::wstring other = check::temporary("history-other");
+    file = CreateFile(other.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    WriteFile(file, "text", 4, &written, NULL);
+    CloseHandle(file);
+    bool refused = false;
+    try {
+        history wrong(4);
+        wrong.open(other.c_str());
+    } catch (const win_exception& error) {
+        refused = (error.code() == ERROR_BAD_FORMAT);
+    }
+    CHECK(refused);
+
+    DeleteFile(path.c_str());
+    DeleteFile(other.c_str());
+}
+
+int main() {
+    test_radix();
+    test_recall();
+    test_capacity();
+    test_substrings();
+    test_persistence();
+    return check::finish("history");
+}
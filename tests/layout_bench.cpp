@@ -0,0 +1,62 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Line layout benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// What a resize costs on the UI thread, laying out a screenful and one
+// step of the rest, against laying out every stored line again.
+//
+int main(int argc, char** argv) {
+    const size_t count = static_cast<size_t>(100000 * check::scale(argc, argv));
+    const size_t screen = 60, budget = 2000;
+
+    scrollback lines(count);
+    std::srand(3);
+    for (size_t i = 0; i < count; i++) {
+        std::wstring text = L"worker " + std::to_wstring(static_cast<long long>(i % 16)) + L":";
+        for (int words = std::rand() % 40; words > 0; words--) text += L" payload";
+        lines.append(text, scrollback::LEVEL_Info, 0);
+    }
+
+    layout cells(lines);
+    const int resizes = 20;
+    double start = check::seconds();
+    for (int i = 0; i < resizes; i++) {
+        cells.width(80 + i % 2);
+        check::keep(cells.tail(screen));
+        cells.step(budget);
+    }
+    double resized = (check::seconds() - start) / resizes;
+
+    start = check::seconds();
+    cells.width(120);
+    size_t rows = 0;
+    for (size_t i = 0; i < count; i++) rows += cells.rows(i);
+    double full = check::seconds() - start;
+    check::keep(rows);
+
+    std::printf("layout: %zu lines, resize %.2f ms, full relayout %.1f ms\n", count, resized * 1e3, full * 1e3);
+    return 0;
+}
@@ -0,0 +1,122 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Line layout tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+static void test_glyphs() {
+    scrollback lines(100);
+    layout cells(lines);
+    CHECK(cells.glyph(L'a') == 1);
+    CHECK(cells.glyph(0x07) == 0);
+    CHECK(cells.glyph(0x0301) == 0);
+    CHECK(cells.glyph(0x4E00) == 2);
+    CHECK(cells.glyph(0xFF21) == 2);
+    CHECK(cells.glyph(0x1F600) == 2);
+    CHECK(cells.glyph(0x00E9) == 1);
+
+    // Cached answers stay the same
+    CHECK(cells.glyph(0x4E00) == 2);
+}
+
+static void test_wrap() {
+    scrollback lines(100);
+    layout cells(lines);
+    std::vector<size_t> breaks;
+    CHECK(cells.wrap(L"", 10) == 1);
+    CHECK(cells.wrap(L"abcdefghij", 4, &breaks) == 3);
+    CHECK(breaks.size() == 2 && breaks[0] == 4 && breaks[1] == 8);
+
+    // Rows break after the last space
+    breaks.clear();
+    CHECK(cells.wrap(L"one two three", 8, &breaks) == 2);
+    CHECK(breaks.size() == 1 && breaks[0] == 8);
+
+    // A trailing line break does not start a row, others do
+    CHECK(cells.wrap(L"a\nb\r\n", 10) == 2);
+    CHECK(cells.wrap(L"a\n\nb", 10) == 3);
+
+    // Wide characters take two cells, tabs go to the next stop
+    CHECK(cells.wrap(L"\u4E00\u4E00\u4E00", 5) == 2);
+    CHECK(cells.wrap(L"\u4E00\u4E00", 4) == 1);
+    CHECK(cells.wrap(L"a\tb", 9) == 1);
+    CHECK(cells.wrap(L"a\tb", 8) == 2);
+}
+
+static void test_tail() {
+    scrollback lines(1000);
+    layout cells(lines);
+    for (int i = 0; i < 10; i++) lines.append(std::wstring(10, L'a'), scrollback::LEVEL_Info, 0);
+    lines.append(std::wstring(200, L'b'), scrollback::LEVEL_Info, 0);
+    lines.append(std::wstring(10, L'c'), scrollback::LEVEL_Info, 0);
+
+    // The long line takes three rows at the default width
+    CHECK(cells.width() == 80);
+    CHECK(cells.rows(10) == 3 && cells.rows(11) == 1);
+    CHECK(cells.tail(3) == 11);
+    CHECK(cells.tail(4) == 10);
+    CHECK(cells.tail(5) == 9);
+
+    // Filtered lines are fitted the same way, and the newest always shows
+    std::vector<size_t> shown;
+    shown.push_back(0);
+    shown.push_back(10);
+    shown.push_back(11);
+    CHECK(cells.fit(shown, 4) == 2);
+    CHECK(cells.fit(shown, 5) == 3);
+    CHECK(cells.fit(shown, 100) == 3);
+    shown.pop_back();
+    CHECK(cells.fit(shown, 1) == 1);
+    shown.clear();
+    CHECK(cells.fit(shown, 10) == 0);
+
+    // A new width is picked up by the next question
+    cells.width(20);
+    CHECK(cells.rows(10) == 10);
+    CHECK(cells.tail(10) == 11);
+}
+
+static void test_step() {
+    scrollback lines(1000);
+    layout cells(lines);
+    for (int i = 0; i < 500; i++) lines.append(std::wstring(i % 170, L'x'), scrollback::LEVEL_Info, 0);
+
+    // The budget bounds each step, the last one reports nothing is left
+    cells.width(40);
+    int steps = 0;
+    while (cells.step(100)) steps++;
+    CHECK(steps == 4);
+
+    // Lines added later are laid out on demand
+    lines.append(std::wstring(100, L'y'), scrollback::LEVEL_Info, 0);
+    CHECK(cells.rows(500) == 3);
+    CHECK(cells.rows(169) == 5);
+}
+
+int main() {
+    test_glyphs();
+    test_wrap();
+    test_tail();
+    test_step();
+    return check::finish("layout");
+}
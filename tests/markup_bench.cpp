@@ -0,0 +1,50 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Markup template benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Formatting with a template parsed once against parsing it again for
+// every write, which is what a template made on the spot costs.
+//
+int main(int argc, char** argv) {
+    const int writes = static_cast<int>(1000000 * check::scale(argc, argv));
+    const wchar_t* layout = L"[<red>ERR</red>] <b>{}</b>: {} after {} ms\n";
+
+    markup compiled(layout);
+    std::wstring line;
+    double start = check::seconds();
+    for (int i = 0; i < writes; i++) line = compiled(L"disk", L"read failed", i);
+    double kept = check::seconds() - start;
+    check::keep(line);
+
+    start = check::seconds();
+    for (int i = 0; i < writes; i++) line = markup(layout)(L"disk", L"read failed", i);
+    double parsed = check::seconds() - start;
+    check::keep(line);
+
+    std::printf("markup: %d writes, compiled %.0f ns, parsed per write %.0f ns\n",
+        writes, kept / writes * 1e9, parsed / writes * 1e9);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Markup template tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+// Made during static initialization, the way callers keep their templates
+static const markup MARKUP_Error(L"[<red>ERR</red>] {}: {}\n");
+
+// Whether making a template throws
+static bool refused(const wchar_t* layout) {
+    try {
+        markup bad(layout);
+    } catch (const win_exception& error) {
+        return error.code() == ERROR_INVALID_PARAMETER;
+    }
+    return false;
+}
+
+static void test_plain() {
+    // Without tags the pieces are joined as they are
+    markup line(L"plain {} <<x>> {{y}} {}");
+    CHECK(line.arguments() == 2);
+    CHECK(line.styles().empty());
+    CHECK(line(L"a{b}", 7) == L"plain a{b} <x>> {y} 7");
+
+    markup none(L"nothing to fill");
+    CHECK(none.arguments() == 0 && none() == L"nothing to fill");
+}
+
+static void test_rich() {
+    // The static template was parsed before main and formats like any other
+    CHECK(MARKUP_Error.arguments() == 2);
+    CHECK(MARKUP_Error.styles().size() == 1);
+    CHECK(MARKUP_Error(L"disk", 42) ==
+          L"{\\rtf1\\ansi\\deff0{\\colortbl;\\red255\\green0\\blue0;}[{\\cf1 ERR}] disk: 42\\par\n}");
+
+    // Arguments are escaped, colours are numbered once each and tags nest
+    markup nested(L"<b><#102030>x</#102030> {}</b> <#102030>{}</#102030>");
+    CHECK(nested.styles().size() == 3);
+    CHECK(nested(L"a\\{}\t\u00E9", 1) ==
+          L"{\\rtf1\\ansi\\deff0{\\colortbl;\\red16\\green32\\blue48;}"
+          L"{\\b {\\cf1 x} a\\\\\\{\\}\\tab \\u233?} {\\cf1 1}}");
+
+    // The same look shares one interned style
+    markup again(L"<red>{}</red>");
+    CHECK(again.styles() == MARKUP_Error.styles());
+}
+
+static void test_malformed() {
+    CHECK(refused(L"<red>x"));
+    CHECK(refused(L"<red>x</b>"));
+    CHECK(refused(L"<nope>x</nope>"));
+    CHECK(refused(L"<#12345>x</#12345>"));
+    CHECK(refused(L"{x}"));
+    CHECK(refused(L"a}b"));
+    CHECK(refused(L"<red"));
+    CHECK(!refused(L"<green>ok</green> {{}}"));
+}
+
+static void test_arguments() {
+    // Too few or too many arguments throw instead of formatting half a line
+    bool few = false, many = false;
+    try { MARKUP_Error(L"disk"); } catch (const win_exception& error) { few = (error.code() == ERROR_INVALID_PARAMETER); }
+    try { MARKUP_Error(L"disk", 1, 2); } catch (const win_exception& error) { many = (error.code() == ERROR_INVALID_PARAMETER); }
+    CHECK(few && many);
+}
+
+int main() {
+    test_plain();
+    test_rich();
+    test_malformed();
+    test_arguments();
+    return check::finish("markup");
+}
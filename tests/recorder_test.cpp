@@ -0,0 +1,156 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Session recording tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+static std::wstring line(int i) {
+    return L"line caf\u00E9 \u4E2D " + std::to_wstring(static_cast<long long>(i)) + L"\n";
+}
+
+static DWORD WINAPI record_input(LPVOID parameter) {
+    static_cast<recorder*>(parameter)->input(L"from elsewhere\r\n");
+    return 0;
+}
+
+static void test_round_trip() {
+    std::wstring path = check::temporary("recording");
+    {
+        recorder session;
+        session.write(L"before opening", 0, 0, 0);
+        session.open(path.c_str());
+        for (int i = 0; i < 100000; i++)
+            session.write(line(i), 5, i % scrollback::LEVEL_Count, i % 7);
+        session.control(recorder::OPTION_Title, 0, 0, L"Title");
+        session.control(recorder::OPTION_Filter, 5, ~0ull);
+        HANDLE thread = CreateThread(NULL, 0, record_input, &session, 0, NULL);
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+        session.close();
+        session.write(L"after closing", 0, 0, 0);
+    }
+
+    // Everything between opening and closing comes back as it was recorded
+    replayer playback(path.c_str());
+    size_t writes = 0, controls = 0, inputs = 0, wrong = 0;
+    timestamp::tick last = 0;
+    unsigned long writer = 0;
+    size_t played = playback.play([&](const recorder::event& current) {
+        if (current.offset < last) wrong++;
+        last = current.offset;
+        switch (current.type) {
+        case recorder::EVENT_Write:
+            if (current.text != line(static_cast<int>(writes)) || current.timeout != 5 ||
+                current.level != writes % scrollback::LEVEL_Count || current.category != writes % 7)
+                wrong++;
+            if (writes++ == 0) writer = current.producer;
+            else if (current.producer != writer) wrong++;
+            break;
+        case recorder::EVENT_Control:
+            if (controls == 0 && (current.setting != recorder::OPTION_Title || current.text != L"Title")) wrong++;
+            if (controls == 1 && (current.setting != recorder::OPTION_Filter || current.first != 5 || current.second != ~0ull)) wrong++;
+            controls++;
+            break;
+        case recorder::EVENT_Input:
+            if (current.text != L"from elsewhere\r\n" || current.producer == writer) wrong++;
+            inputs++;
+            break;
+        }
+    }, 0);
+    CHECK(played == 100003);
+    CHECK(writes == 100000 && controls == 2 && inputs == 1);
+    CHECK(wrong == 0);
+    DeleteFile(path.c_str());
+}
+
+static void test_pacing() {
+    std::wstring path = check::temporary("recording-paced");
+    {
+        recorder session;
+        session.open(path.c_str());
+        session.input(L"first");
+        Sleep(200);
+        session.input(L"second");
+    }
+
+    // Recorded gaps are kept, scaled by the rate, or skipped altogether
+    replayer playback(path.c_str());
+    double start = check::seconds();
+    CHECK(playback.play([](const recorder::event&) {}, 1.0) == 2);
+    double normal = check::seconds() - start;
+    start = check::seconds();
+    playback.play([](const recorder::event&) {}, 4.0);
+    double faster = check::seconds() - start;
+    start = check::seconds();
+    playback.play([](const recorder::event&) {}, 0);
+    double fastest = check::seconds() - start;
+    CHECK(normal >= 0.19 && normal < 1.0);
+    CHECK(faster >= 0.045 && faster < 0.15);
+    CHECK(fastest < 0.02);
+    DeleteFile(path.c_str());
+}
+
+static void test_damaged() {
+    std::wstring path = check::temporary("recording-torn");
+    {
+        recorder session;
+        session.open(path.c_str());
+        session.write(L"whole", 0, 0, 0);
+        session.write(L"torn", 0, 0, 0);
+    }
+
+    // A record cut short ends playback
+    HANDLE file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    size.QuadPart -= 2;
+    SetFilePointerEx(file, size, NULL, FILE_BEGIN);
+    SetEndOfFile(file);
+    CloseHandle(file);
+    std::vector<std::wstring> texts;
+    replayer torn(path.c_str());
+    CHECK(torn.play([&texts](const recorder::event& current) { texts.push_back(current.text); }, 0) == 1);
+    CHECK(texts.size() == 1 && texts[0] == L"whole");
+
+    // Anything but a recording is refused
+    file = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    DWORD written = 0;
+    WriteFile(file, "not a recording", 15, &written, NULL);
+    CloseHandle(file);
+    bool refused = false;
+    try {
+        replayer wrong(path.c_str());
+    } catch (const win_exception& error) {
+        refused = (error.code() == ERROR_BAD_FORMAT);
+    }
+    CHECK(refused);
+    DeleteFile(path.c_str());
+}
+
+int main() {
+    test_round_trip();
+    test_pacing();
+    test_damaged();
+    return check::finish("recorder");
+}
@@ -0,0 +1,68 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Operation result benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+// Read on every attempt so the compiler cannot decide the outcome
+static volatile int RESULT_Capacity = 0;
+
+// A full queue reported both ways
+static result full_result(int attempt) {
+    return (attempt >= RESULT_Capacity) ? result(result::RESULT_Full) : result();
+}
+
+static void full_throw(int attempt) {
+    if (attempt >= RESULT_Capacity) throw win_exception(ERROR_BUSY);
+}
+
+//
+// A producer finding the console full, told so by a returned result
+// against a caught exception, which is what a busy writer paid before.
+//
+int main(int argc, char** argv) {
+    const int attempts = static_cast<int>(1000000 * check::scale(argc, argv));
+
+    int failures = 0;
+    double start = check::seconds();
+    for (int i = 0; i < attempts; i++)
+        if (!full_result(i)) failures++;
+    double returned = check::seconds() - start;
+    check::keep(failures);
+
+    failures = 0;
+    start = check::seconds();
+    for (int i = 0; i < attempts; i++) {
+        try {
+            full_throw(i);
+        } catch (const win_exception&) {
+            failures++;
+        }
+    }
+    double thrown = check::seconds() - start;
+    check::keep(failures);
+
+    std::printf("result: %d failed writes, returned %.1f ns, thrown %.0f ns\n",
+        attempts, returned / attempts * 1e9, thrown / attempts * 1e9);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Operation result tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+// Fails the way a configuration call does
+static void refuse(DWORD code) {
+    throw win_exception(code);
+}
+
+// Whether checking a result throws the given code
+static bool throws(const result& outcome, DWORD code) {
+    try {
+        outcome.check();
+    } catch (const win_exception& error) {
+        return error.code() == code;
+    }
+    return false;
+}
+
+static void test_kinds() {
+    result ok;
+    CHECK(ok && ok.kind() == result::RESULT_Ok && ok.error() == ERROR_SUCCESS);
+    CHECK(std::string(ok.name()) == "ok" && ok.message() == "ok");
+    CHECK(!throws(ok, ERROR_SUCCESS));
+
+    // Each failure maps back to the error the throwing calls use
+    CHECK(!result(result::RESULT_Timeout) && throws(result(result::RESULT_Timeout), WAIT_TIMEOUT));
+    CHECK(throws(result(result::RESULT_Full), ERROR_BUSY));
+    CHECK(throws(result(result::RESULT_Closed), ERROR_INVALID_HANDLE));
+    CHECK(throws(result(result::RESULT_Backend, ERROR_ACCESS_DENIED), ERROR_ACCESS_DENIED));
+    CHECK(std::string(result(result::RESULT_Closed).name()) == "closed");
+    CHECK(result(result::RESULT_Full).message() == "full");
+}
+
+static void test_capture() {
+    // Calls that throw come back as backend failures with their code
+    int calls = 0;
+    result done = result::capture([&]() { calls++; });
+    CHECK(done && calls == 1);
+
+    result failed = result::capture([]() { refuse(ERROR_FILE_NOT_FOUND); });
+    CHECK(!failed && failed.kind() == result::RESULT_Backend && failed.error() == ERROR_FILE_NOT_FOUND);
+    CHECK(throws(failed, ERROR_FILE_NOT_FOUND));
+
+    result memory = result::capture([]() { throw std::bad_alloc(); });
+    CHECK(memory.kind() == result::RESULT_Backend && memory.error() == ERROR_NOT_ENOUGH_MEMORY);
+}
+
+int main() {
+    test_kinds();
+    test_capture();
+    return check::finish("result");
+}
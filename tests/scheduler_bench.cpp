@@ -0,0 +1,76 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Round robin scheduler benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Cost of a turn with many consoles ready, and how evenly turns are spread
+// while one console floods and the rest write at a steady trickle.
+//
+struct source {
+    long pending;
+    long served;
+};
+
+int main(int argc, char** argv) {
+    const long turns = static_cast<long>(2000000 * check::scale(argc, argv));
+    const size_t count = 256;
+    std::vector<source> sources(count, source());
+
+    scheduler<source> queue;
+    for (size_t i = 0; i < count; i++) queue.ready(&sources[i]);
+    double start = check::seconds();
+    source* target = NULL;
+    for (long i = 0; i < turns && queue.next(target); i++) {
+        target->served++;
+        queue.ready(target);
+    }
+    double elapsed = check::seconds() - start;
+
+    // Fewest and most turns any console got, a fair queue keeps them within one
+    long fewest = sources[0].served, most = sources[0].served;
+    for (size_t i = 1; i < count; i++) {
+        fewest = (std::min)(fewest, sources[i].served);
+        most = (std::max)(most, sources[i].served);
+    }
+    std::printf("scheduler: %ld turns over %zu consoles, %.0f ns per turn, %ld to %ld turns each\n",
+        turns, count, elapsed / turns * 1e9, fewest, most);
+
+    // A flood next to quiet consoles, counting rounds until the quiet ones are done
+    for (size_t i = 0; i < count; i++) sources[i].pending = (i == 0) ? 100000000 : 64;
+    while (queue.next(target)) {}
+    for (size_t i = 0; i < count; i++) queue.ready(&sources[i]);
+    long rounds = 0, quiet = static_cast<long>(count - 1);
+    while (quiet > 0) {
+        rounds++;
+        for (size_t n = queue.size(); n > 0 && queue.next(target); n--) {
+            target->pending -= (std::min)(target->pending, 32L);
+            if (target->pending) queue.ready(target);
+            else quiet--;
+        }
+    }
+    std::printf("scheduler: quiet consoles done after %ld rounds next to a flood\n", rounds);
+    return 0;
+}
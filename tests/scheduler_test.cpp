@@ -0,0 +1,168 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Round robin scheduler tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// A console as far as the scheduler is concerned: output waiting to be
+// drained a quantum at a time, the way the reactor drains it.
+//
+struct source {
+    long pending;
+    long drained;
+    int finished;   // Round in which the last of the output was drained
+};
+
+static const int QUANTUM = 32;
+
+static bool drain(source& target, int round) {
+    long taken = (std::min)(target.pending, static_cast<long>(QUANTUM));
+    target.pending -= taken;
+    target.drained += taken;
+    if (!target.pending) target.finished = round;
+    return target.pending != 0;
+}
+
+static void test_queue() {
+    scheduler<source> queue;
+    source a = source(), b = source(), c = source();
+    CHECK(queue.ready(&a));
+    CHECK(queue.ready(&b));
+    CHECK(!queue.ready(&a));
+    CHECK(queue.ready(&c));
+    CHECK(queue.size() == 3);
+
+    queue.remove(&b);
+    CHECK(queue.size() == 2);
+    source* next = NULL;
+    CHECK(queue.next(next) && next == &a);
+    CHECK(queue.next(next) && next == &c);
+    CHECK(!queue.next(next));
+
+    // Once taken a task can be queued again
+    CHECK(queue.ready(&a));
+    CHECK(queue.next(next) && next == &a);
+}
+
+static void test_fairness() {
+    // One source floods while the others write a little, each round serves
+    // every ready source once, so the quiet ones finish as if alone
+    std::vector<source> sources(16);
+    for (size_t i = 0; i < sources.size(); i++) {
+        sources[i].pending = (i == 0) ? 1000000 : static_cast<long>(QUANTUM * (1 + i % 3));
+        sources[i].drained = 0;
+        sources[i].finished = 0;
+    }
+
+    scheduler<source> queue;
+    for (size_t i = 0; i < sources.size(); i++) queue.ready(&sources[i]);
+    int round = 0;
+    while (queue.size()) {
+        round++;
+        size_t turns = queue.size();
+        source* target = NULL;
+        while (turns-- > 0 && queue.next(target))
+            if (drain(*target, round)) queue.ready(target);
+    }
+
+    for (size_t i = 1; i < sources.size(); i++)
+        CHECK(sources[i].finished == static_cast<int>(1 + i % 3));
+    CHECK(sources[0].drained == 1000000);
+    CHECK(round == sources[0].finished);
+}
+
+//
+// Producers mark sources ready while a consumer drains them, every unit of
+// output has to be drained exactly once and no source may be left behind
+//
+struct shared {
+    scheduler<source>* queue;
+    source* sources;
+    size_t count;
+    lock* guard;
+    long per_producer;
+    unsigned seed;
+};
+
+static DWORD CALLBACK produce(void* parameter) {
+    shared& state = *static_cast<shared*>(parameter);
+    for (long i = 0; i < state.per_producer; i++) {
+        state.seed = state.seed * 1103515245 + 12345;
+        source& target = state.sources[(state.seed >> 16) % state.count];
+        state.guard->acquire();
+        target.pending++;
+        state.guard->release();
+        state.queue->ready(&target);
+        if (i % 64 == 0) Sleep(0);
+    }
+    return 0;
+}
+
+static void test_concurrent() {
+    scheduler<source> queue;
+    std::vector<source> sources(8, source());
+    lock guard;
+    const int producers = 4;
+    const long per_producer = 50000;
+
+    std::vector<shared> states(producers);
+    std::vector<HANDLE> threads;
+    for (int i = 0; i < producers; i++) {
+        shared state = { &queue, &sources[0], sources.size(), &guard, per_producer, static_cast<unsigned>(i + 1) };
+        states[i] = state;
+        threads.push_back(CreateThread(NULL, 0, produce, &states[i], 0, NULL));
+    }
+
+    // Every unit counted before its source is marked ready, so a source is
+    // always queued again while it still has output
+    const long total = producers * per_producer;
+    long drained = 0;
+    for (DWORD begun = GetTickCount(); drained < total && GetTickCount() - begun < 10000;) {
+        source* target = NULL;
+        if (!queue.next(target)) {
+            Sleep(0);
+            continue;
+        }
+        guard.acquire();
+        long taken = (std::min)(target->pending, static_cast<long>(QUANTUM));
+        target->pending -= taken;
+        bool more = target->pending != 0;
+        guard.release();
+        drained += taken;
+        if (more) queue.ready(target);
+    }
+
+    WaitForMultipleObjects(static_cast<DWORD>(threads.size()), &threads[0], TRUE, INFINITE);
+    for (size_t i = 0; i < threads.size(); i++) CloseHandle(threads[i]);
+    CHECK(drained == total);
+    for (size_t i = 0; i < sources.size(); i++) CHECK(sources[i].pending == 0);
+}
+
+int main() {
+    test_queue();
+    test_fairness();
+    test_concurrent();
+    return check::finish("scheduler");
+}
@@ -0,0 +1,90 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Scrollback benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Switching filters over a full scrollback, where errors are rare and one
+// category is common, against testing the tags of every line. Catching up
+// after following the tail selects bounded slices walking back from the
+// end, the slowest of which bounds a turn of the UI thread.
+//
+int main(int argc, char** argv) {
+    const size_t total = static_cast<size_t>(1000000 * check::scale(argc, argv));
+    const int rounds = 20;
+
+    scrollback lines(total);
+    std::srand(11);
+    for (size_t i = 0; i < total; i++) {
+        int level = (std::rand() % 1000 == 0) ? scrollback::LEVEL_Error : scrollback::LEVEL_Info;
+        lines.append(L"request handled", level, std::rand() % 16);
+    }
+
+    const scrollback::filter errors(1u << scrollback::LEVEL_Error);
+    const scrollback::filter subsystem(~0u, 1ull << 3);
+    std::vector<size_t> selected;
+
+    double start = check::seconds();
+    for (int i = 0; i < rounds; i++) {
+        selected.clear();
+        lines.select(errors, 0, selected);
+    }
+    double rare = (check::seconds() - start) / rounds;
+    size_t rare_count = selected.size();
+
+    start = check::seconds();
+    for (int i = 0; i < rounds; i++) {
+        selected.clear();
+        lines.select(subsystem, 0, selected);
+    }
+    double common = (check::seconds() - start) / rounds;
+    size_t common_count = selected.size();
+
+    scrollback::snapshot current = lines.take();
+    start = check::seconds();
+    for (int i = 0; i < rounds; i++) {
+        selected.clear();
+        for (size_t j = current.first(); j < current.end(); j++)
+            if (errors.matches(current.at(j).level, current.at(j).category)) selected.push_back(j);
+    }
+    double scanned = (check::seconds() - start) / rounds;
+    check::keep(selected);
+
+    const size_t slice = 2048;
+    double slowest = 0;
+    for (size_t until = current.end(); until > current.first();) {
+        size_t from = until - (std::min)(until - current.first(), slice);
+        selected.clear();
+        start = check::seconds();
+        current.select(subsystem, from, selected, until);
+        slowest = (std::max)(slowest, check::seconds() - start);
+        until = from;
+    }
+    check::keep(selected);
+
+    std::printf("scrollback: %zu lines, errors %zu in %.2f ms (scan %.2f ms), category %zu in %.2f ms, slice of %zu at most %.1f us\n",
+        total, rare_count, rare * 1e3, scanned * 1e3, common_count, common * 1e3, slice, slowest * 1e6);
+    return 0;
+}
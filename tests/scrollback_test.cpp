@@ -0,0 +1,256 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Scrollback tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+static void test_select() {
+    // Every selection is compared against filtering a plain list of the lines
+    scrollback lines(5000);
+    std::vector<std::pair<int, int> > model;
+    std::srand(3);
+    for (int i = 0; i < 20000; i++) {
+        int level = std::rand() % scrollback::LEVEL_Count, category = std::rand() % 70;
+        if (std::rand() % 5) category %= 3;
+        lines.append(L"x", level, category);
+        model.push_back(std::make_pair(level, category >= scrollback::CATEGORY_Count ? 0 : category));
+    }
+    CHECK(lines.end() == model.size());
+    CHECK(lines.first() > 0 && lines.first() % scrollback::BLOCK_Lines == 0);
+
+    for (int round = 0; round < 200; round++) {
+        scrollback::mask categories = (static_cast<scrollback::mask>(std::rand()) << 32) ^ std::rand();
+        if (std::rand() % 2) categories = ~categories;
+        scrollback::filter which(std::rand() % 16, categories);
+        size_t from = std::rand() % 21000;
+
+        std::vector<size_t> selected, expected;
+        CHECK(lines.select(which, from, selected) == model.size());
+        for (size_t i = (std::max)(from, lines.first()); i < model.size(); i++)
+            if (which.matches(model[i].first, model[i].second)) expected.push_back(i);
+        CHECK(selected == expected);
+
+        // A bounded selection is the same lines cut off at the bound
+        size_t until = from + std::rand() % 3000;
+        std::vector<size_t> bounded;
+        lines.select(which, from, bounded, until);
+        expected.erase(std::lower_bound(expected.begin(), expected.end(), until), expected.end());
+        CHECK(bounded == expected);
+    }
+}
+
+static void test_categories() {
+    scrollback lines(100);
+    CHECK(lines.category(L"network") == 0);
+    CHECK(lines.category(L"disk") == 1);
+    CHECK(lines.category(L"network") == 0);
+
+    // Past the limit everything shares the last category
+    for (int i = 2; i < scrollback::CATEGORY_Count; i++)
+        lines.category(L"c" + std::to_wstring(static_cast<long long>(i)));
+    CHECK(lines.category(L"one too many") == scrollback::CATEGORY_Count - 1);
+
+    // Out of range tags fall back to defaults
+    size_t index = lines.append(L"odd", 99, 200, 42);
+    scrollback::line entry;
+    CHECK(lines.get(index, entry));
+    CHECK(entry.text == L"odd" && entry.level == scrollback::LEVEL_Info && entry.category == 0 && entry.stamp == 42);
+    CHECK(!lines.get(index + 1, entry));
+}
+
+static void test_views() {
+    // Views over the same store follow it independently
+    scrollback lines(2 * scrollback::BLOCK_Lines);
+    view errors(lines, scrollback::filter(1u << scrollback::LEVEL_Error));
+    view disk(lines, scrollback::filter(~0u, 1ull << 1));
+    for (int i = 0; i < 1000; i++)
+        lines.append(L"line", i % 4 ? scrollback::LEVEL_Info : scrollback::LEVEL_Error, i % 2);
+    errors.refresh();
+    disk.refresh();
+    CHECK(errors.size() == 250 && errors.index(1) == 4);
+    CHECK(disk.size() == 500 && disk.index(0) == 1);
+
+    // Only what is new is picked up, and evicted lines are forgotten
+    for (int i = 0; i < 4 * scrollback::BLOCK_Lines; i++)
+        lines.append(L"line", scrollback::LEVEL_Error, 0);
+    errors.refresh();
+    disk.refresh();
+    CHECK(errors.index(0) == lines.first());
+    CHECK(errors.size() == lines.end() - lines.first());
+    CHECK(disk.size() == 0);
+    CHECK(lines.end() - lines.first() >= 2 * scrollback::BLOCK_Lines);
+}
+
+static void test_search() {
+    // Every search is compared against scanning a plain list of the lines
+    scrollback lines(20000);
+    std::vector<std::wstring> model;
+    std::srand(5);
+    const wchar_t* words[] = { L"error", L"warn", L"foo.bar", L"request-42", L"abc", L"xyz", L"a+b", L"timeout" };
+    for (int i = 0; i < 60000; i++) {
+        std::wstring text;
+        for (int j = std::rand() % 6; j > 0; j--) text.append(words[std::rand() % 8]).append(L" ");
+        lines.append(text, scrollback::LEVEL_Info, 0);
+        model.push_back(text);
+    }
+
+    const wchar_t* patterns[] = { L"error warn", L"foo.bar", L"request-42 abc", L"imeo", L"zz", L"ab" };
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        std::vector<size_t> found, expected;
+        lines.search(patterns[i], false, [&](size_t index) { found.push_back(index); return true; });
+        for (size_t j = lines.first(); j < model.size(); j++)
+            if (model[j].find(patterns[i]) != std::wstring::npos) expected.push_back(j);
+        CHECK(found == expected);
+    }
+
+    const wchar_t* expressions[] = { L"err(or)? warn", L"foo\\.bar", L"req.*42", L"t+imeout x", L"a\\+b abc",
+                                     L"(error|warn) xyz", L"[a-c]bc error", L"abcd?e" };
+    for (size_t i = 0; i < sizeof(expressions) / sizeof(expressions[0]); i++) {
+        std::wregex compiled(expressions[i]);
+        std::vector<size_t> found, expected;
+        lines.search(expressions[i], true, [&](size_t index) { found.push_back(index); return true; });
+        for (size_t j = lines.first(); j < model.size(); j++)
+            if (std::regex_search(model[j], compiled)) expected.push_back(j);
+        CHECK(found == expected);
+    }
+
+    // Results stop as soon as the receiver has enough
+    size_t seen = 0;
+    CHECK(lines.search(L"error", false, [&](size_t) { return ++seen < 3; }) == 3 && seen == 3);
+    CHECK(lines.search(L"", false, [](size_t) { return true; }) == 0);
+}
+
+//
+// Producers hand lines to a single appender through a mailbox, as consoles
+// do, while readers check snapshots taken as the store fills and evicts.
+//
+struct stress {
+    enum { PRODUCERS = 4, READERS = 3, LINES = 40000 };
+
+    struct producer {
+        stress* owner;
+        int number;
+    };
+
+    stress() : output(64), lines(8 * scrollback::BLOCK_Lines), finished(false), checked(0), bad(0) {}
+
+    static std::wstring text(int number, int sequence) {
+        return L"<" + std::to_wstring(static_cast<long long>(number)) + L":" + std::to_wstring(static_cast<long long>(sequence)) + L">";
+    }
+
+    static DWORD WINAPI produce(LPVOID parameter) {
+        producer& self = *static_cast<producer*>(parameter);
+        for (int i = 0; i < LINES; i++) {
+            mail::header info;
+            info.level = static_cast<unsigned char>(i % scrollback::LEVEL_Count);
+            info.category = static_cast<unsigned char>(self.number);
+            if (!self.owner->output.put(text(self.number, i), info, INFINITE)) self.owner->bad++;
+        }
+        return 0;
+    }
+
+    static DWORD WINAPI append(LPVOID parameter) {
+        stress& self = *static_cast<stress*>(parameter);
+        mail::string line;
+        mail::header info;
+        for (int i = 0; i < PRODUCERS * LINES && self.output.take(line, info, INFINITE); i++) {
+            size_t index = self.lines.append(std::wstring(line.data(), line.size()), info.level, info.category);
+            if (i % 3 == 0) self.lines.repeat(index);
+        }
+        self.finished = true;
+        return 0;
+    }
+
+    static DWORD WINAPI read(LPVOID parameter) {
+        stress& self = *static_cast<stress*>(parameter);
+        while (!self.finished) {
+            scrollback::snapshot current = self.lines.take();
+            if (current.end() == current.first()) continue;
+
+            // Tags agree with the text and each producer's lines stay in order
+            int last[PRODUCERS];
+            for (int i = 0; i < PRODUCERS; i++) last[i] = -1;
+            std::vector<size_t> expected;
+            for (size_t i = current.first(); i < current.end(); i++) {
+                const scrollback::line& entry = current.at(i);
+                int number = -1, sequence = -1;
+                std::swscanf(std::wstring(entry.text.data(), entry.text.size()).c_str(), L"<%d:%d>", &number, &sequence);
+                if (number < 0 || number >= PRODUCERS || sequence <= last[number] ||
+                    entry.category != number || entry.level != sequence % scrollback::LEVEL_Count ||
+                    entry.repeats < 1 || entry.repeats > 2)
+                    self.bad++;
+                else last[number] = sequence;
+                if (entry.category == 1) expected.push_back(i);
+            }
+
+            // Indexes agree with the lines they describe
+            std::vector<size_t> selected;
+            current.select(scrollback::filter(~0u, 1ull << 1), 0, selected);
+            if (selected != expected) self.bad++;
+
+            size_t middle = current.first() + (current.end() - current.first()) / 2;
+            std::wstring wanted(current.at(middle).text.data(), current.at(middle).text.size());
+            size_t found = scrollback::string::npos;
+            current.search(wanted, false, [&found](size_t index) { found = index; return false; });
+            if (found != middle) self.bad++;
+            self.checked++;
+        }
+        return 0;
+    }
+
+    mail output;
+    scrollback lines;
+    std::atomic<bool> finished;
+    std::atomic<int> checked;
+    std::atomic<int> bad;
+};
+
+static void test_concurrent() {
+    stress state;
+    std::vector<HANDLE> threads;
+    stress::producer producers[stress::PRODUCERS];
+    for (int i = 0; i < stress::PRODUCERS; i++) {
+        stress::producer self = { &state, i };
+        producers[i] = self;
+        threads.push_back(CreateThread(NULL, 0, stress::produce, &producers[i], 0, NULL));
+    }
+    threads.push_back(CreateThread(NULL, 0, stress::append, &state, 0, NULL));
+    for (int i = 0; i < stress::READERS; i++)
+        threads.push_back(CreateThread(NULL, 0, stress::read, &state, 0, NULL));
+
+    CHECK(WaitForMultipleObjects(static_cast<DWORD>(threads.size()), threads.data(), TRUE, 60000) == WAIT_OBJECT_0);
+    for (size_t i = 0; i < threads.size(); i++) CloseHandle(threads[i]);
+    CHECK(state.bad == 0);
+    CHECK(state.checked > 0);
+    CHECK(state.lines.end() == stress::PRODUCERS * stress::LINES);
+}
+
+int main() {
+    test_select();
+    test_categories();
+    test_views();
+    test_search();
+    test_concurrent();
+    return check::finish("scrollback");
+}
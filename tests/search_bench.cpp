@@ -0,0 +1,87 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Scrollback search benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Searches over generated log text, 64 MB of characters by default and a
+// gigabyte at a scale of 16, against scanning every line for the same text.
+// A rare request identifier and a missing one show what the trigram filters
+// skip, a regular expression shows the cost when its literal is common.
+//
+int main(int argc, char** argv) {
+    const size_t characters = static_cast<size_t>(64.0 * 1024 * 1024 * check::scale(argc, argv));
+
+    scrollback lines(characters);
+    std::srand(13);
+    const wchar_t* subsystems[] = { L"http", L"db", L"cache", L"queue", L"auth" };
+    const wchar_t* verbs[] = { L"accepted", L"completed", L"retrying", L"evicted", L"timed out" };
+    size_t written = 0, count = 0;
+    std::wstring text;
+    while (written < characters) {
+        text.assign(L"2026-10-19 12:00:00 [");
+        text.append(subsystems[std::rand() % 5]).append(L"] request ");
+        text.append(std::to_wstring(static_cast<long long>(std::rand() % 100000000))).append(L" ");
+        text.append(verbs[std::rand() % 5]).append(L" after ");
+        text.append(std::to_wstring(static_cast<long long>(std::rand() % 1000))).append(L" ms");
+        if (count == characters / 200) text.append(L" id=feedface");
+        lines.append(text, scrollback::LEVEL_Info, 0);
+        written += text.size();
+        count++;
+    }
+
+    const struct { const wchar_t* pattern; bool expression; const char* name; } queries[] = {
+        { L"id=feedface", false, "rare" },
+        { L"id=deadbeef", false, "missing" },
+        { L"\\[db\\] request [0-9]+ timed out", true, "expression" },
+    };
+
+    std::printf("search: %zu lines, %.0f MB of text\n", count, written / 1048576.0);
+    scrollback::snapshot current = lines.take();
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        size_t found = 0;
+        double start = check::seconds();
+        current.search(queries[i].pattern, queries[i].expression, [&](size_t) { found++; return true; });
+        double indexed = check::seconds() - start;
+
+        // The same query testing every line
+        size_t scanned_found = 0;
+        std::wregex compiled;
+        if (queries[i].expression) compiled.assign(queries[i].pattern);
+        start = check::seconds();
+        for (size_t j = current.first(); j < current.end(); j++) {
+            const scrollback::string& line = current.at(j).text;
+            if (queries[i].expression ? std::regex_search(line.begin(), line.end(), compiled)
+                                      : line.find(queries[i].pattern) != scrollback::string::npos)
+                scanned_found++;
+        }
+        double scanned = check::seconds() - start;
+
+        std::printf("search: %-10s %zu found in %.1f ms (scan %zu in %.1f ms)\n",
+            queries[i].name, found, indexed * 1e3, scanned_found, scanned * 1e3);
+        if (found != scanned_found) return 1;
+    }
+    return 0;
+}
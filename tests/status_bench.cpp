@@ -0,0 +1,77 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Status line benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+// Draws a frame whenever one was asked for, at most every 16 ms
+struct frames {
+    status_board* board;
+    std::atomic<bool> requested;
+    std::atomic<bool> done;
+    int drawn;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        frames* self = static_cast<frames*>(parameter);
+        std::vector<std::wstring> lines;
+        while (!self->done) {
+            if (self->requested.exchange(false) && self->board->collect(lines)) self->drawn++;
+            Sleep(16);
+        }
+        return 0;
+    }
+};
+
+//
+// Progress updates from a busy loop, against the one redraw per update a
+// line written to the output would cost.
+//
+int main(int argc, char** argv) {
+    const int updates = static_cast<int>(2000000 * check::scale(argc, argv));
+
+    status_board board;
+    size_t slot = board.open();
+    frames painter;
+    painter.board = &board;
+    painter.requested = false;
+    painter.done = false;
+    painter.drawn = 0;
+    HANDLE thread = CreateThread(NULL, 0, frames::run, &painter, 0, NULL);
+
+    int requests = 0;
+    double start = check::seconds();
+    for (int i = 0; i < updates; i++) {
+        if (board.update(slot, L"copied " + std::to_wstring(static_cast<long long>(i)) + L" files")) {
+            requests++;
+            painter.requested = true;
+        }
+    }
+    double elapsed = check::seconds() - start;
+    painter.done = true;
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+
+    std::printf("status: %d updates in %.0f ms, %.0f ns each, %d redraws asked for, %d drawn\n",
+        updates, elapsed * 1e3, elapsed / updates * 1e9, requests, painter.drawn);
+    return 0;
+}
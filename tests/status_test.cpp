@@ -0,0 +1,150 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Status line tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+static void test_coalescing() {
+    status_board board;
+    std::vector<std::wstring> lines;
+    unsigned one, two;
+    size_t first = board.open(one), second = board.open(two);
+    CHECK(first != second);
+
+    // Any number of updates before a frame ask for one redraw
+    int requests = 0;
+    for (int i = 0; i < 100000; i++) requests += board.update(first, one, std::to_wstring(static_cast<long long>(i)));
+    requests += board.update(second, two, L"second");
+    CHECK(requests == 1);
+    CHECK(board.collect(lines));
+    CHECK(lines.size() == 2 && lines[0] == L"99999" && lines[1] == L"second");
+
+    // Nothing changed since, nothing to draw
+    CHECK(!board.collect(lines));
+    CHECK(board.update(second, two, L"again"));
+    CHECK(!board.update(second, two, L"and again"));
+    CHECK(board.collect(lines) && lines[1] == L"and again");
+}
+
+static void test_slots() {
+    status_board board;
+    std::vector<std::wstring> lines;
+    unsigned one, two;
+    size_t first = board.open(one), second = board.open(two);
+    board.update(second, two, L"kept");
+    board.collect(lines);
+
+    // Closed lines go away and their slot is reused
+    CHECK(board.close(first, one));
+    CHECK(!board.close(first, one));
+    CHECK(board.collect(lines) && lines.size() == 1 && lines[0] == L"kept");
+    CHECK(!board.update(first, one, L"closed"));
+    CHECK(!board.collect(lines));
+    unsigned three;
+    CHECK(board.open(three) == first && three != one);
+    CHECK(board.collect(lines) && lines.size() == 2 && lines[0].empty());
+
+    // Slots that never existed are ignored
+    CHECK(!board.update(100, 0, L"nowhere") && !board.close(100, 0));
+}
+
+static void test_stale() {
+    status_board board;
+    std::vector<std::wstring> lines;
+    unsigned old;
+    size_t slot = board.open(old);
+    board.update(slot, old, L"old");
+    board.close(slot, old);
+
+    // A copy of the closed line's handle cannot reach the line reusing its slot
+    unsigned current;
+    CHECK(board.open(current) == slot);
+    board.update(slot, current, L"current");
+    board.collect(lines);
+    CHECK(!board.update(slot, old, L"stale"));
+    CHECK(!board.close(slot, old));
+    CHECK(!board.collect(lines));
+
+    // The new owner still has its line
+    CHECK(board.update(slot, current, L"newer"));
+    CHECK(board.collect(lines) && lines.size() == 1 && lines[0] == L"newer");
+    CHECK(board.close(slot, current));
+    CHECK(board.collect(lines) && lines.empty());
+}
+
+//
+// A writer updating as fast as it can while the UI thread draws frames.
+// Every redraw asked for is one the UI thread has yet to collect, and the
+// last frame shows the last update.
+//
+struct writer {
+    status_board* board;
+    size_t slot;
+    unsigned generation;
+    int updates;
+    std::atomic<int> requests;
+    std::atomic<bool> done;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        writer* self = static_cast<writer*>(parameter);
+        for (int i = 1; i <= self->updates; i++)
+            if (self->board->update(self->slot, self->generation, std::to_wstring(static_cast<long long>(i)))) self->requests++;
+        self->done = true;
+        return 0;
+    }
+};
+
+static void test_concurrent() {
+    status_board board;
+    writer source;
+    source.board = &board;
+    source.slot = board.open(source.generation);
+    source.updates = 200000;
+    source.requests = 0;
+    source.done = false;
+    std::vector<std::wstring> lines;
+    board.collect(lines);
+
+    HANDLE thread = CreateThread(NULL, 0, writer::run, &source, 0, NULL);
+    int frames = 0;
+    while (!source.done) {
+        board.collect(lines);
+        frames++;
+        CHECK(source.requests <= frames + 1);
+        Sleep(1);
+    }
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+
+    board.collect(lines);
+    CHECK(lines.size() == 1 && lines[0] == L"200000");
+    CHECK(source.requests <= frames + 1);
+}
+
+int main() {
+    test_coalescing();
+    test_slots();
+    test_stale();
+    test_concurrent();
+    return check::finish("status");
+}
@@ -0,0 +1,92 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Style table benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Memory and coalescing cost of highlighted lines kept three ways: a style
+// per character, runs carrying the whole style, and runs carrying interned
+// identifiers. The highlighter produces the identifier runs.
+//
+struct styled_run {
+    size_t start;
+    size_t length;
+    style format;
+};
+
+int main(int argc, char** argv) {
+    const size_t total = static_cast<size_t>(100000 * check::scale(argc, argv));
+
+    highlighter rules;
+    rules.add(L"ERROR", style(RGB(255, 0, 0), true));
+    rules.add(L"WARN", style(RGB(192, 128, 0)));
+    rules.add(L"req-", style(RGB(0, 0, 255)), highlighter::SCOPE_Token);
+    rules.add(L"ms", style(RGB(128, 128, 128)));
+    const std::wstring text = L"12:00:00 ERROR req-1234 failed WARN req-5678 retried after 12 ms, 40 ms total";
+
+    std::vector<highlighter::run> runs;
+    rules.apply(text, runs);
+
+    // A style per character
+    std::vector<std::vector<style> > characters(total);
+    double start = check::seconds();
+    for (size_t i = 0; i < total; i++) {
+        characters[i].assign(text.size(), style());
+        for (size_t j = 0; j < runs.size(); j++)
+            std::fill(characters[i].begin() + runs[j].start, characters[i].begin() + runs[j].start + runs[j].length,
+                      style_table::lookup(runs[j].format));
+    }
+    double per_character = check::seconds() - start;
+
+    // Runs with the whole style, and with identifiers
+    std::vector<std::vector<styled_run> > whole(total);
+    std::vector<std::vector<highlighter::run> > interned(total);
+    for (size_t i = 0; i < total; i++) {
+        for (size_t j = 0; j < runs.size(); j++) {
+            styled_run copy = { runs[j].start, runs[j].length, style_table::lookup(runs[j].format) };
+            whole[i].push_back(copy);
+        }
+        interned[i] = runs;
+    }
+
+    // Coalescing touching runs compares styles
+    size_t merged = 0;
+    start = check::seconds();
+    for (size_t i = 0; i + 1 < total; i++)
+        for (size_t j = 0; j < runs.size(); j++) merged += whole[i][j].format == whole[i + 1][j].format;
+    double compared_whole = check::seconds() - start;
+    start = check::seconds();
+    for (size_t i = 0; i + 1 < total; i++)
+        for (size_t j = 0; j < runs.size(); j++) merged += interned[i][j].format == interned[i + 1][j].format;
+    double compared_interned = check::seconds() - start;
+    check::keep(merged);
+
+    std::printf("styles: %zu lines of %zu characters with %zu runs\n", total, text.size(), runs.size());
+    std::printf("styles: per character %zu bytes a line (%.0f ns to fill), whole style runs %zu bytes, interned runs %zu bytes\n",
+        text.size() * sizeof(style), per_character / total * 1e9, runs.size() * sizeof(styled_run), runs.size() * sizeof(highlighter::run));
+    std::printf("styles: comparing runs %.2f ns with whole styles, %.2f ns with identifiers\n",
+        compared_whole / (total * runs.size()) * 1e9, compared_interned / (total * runs.size()) * 1e9);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Style table tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+// Interned while static initializers run, before or after the table's own file
+static const style_table::id early = style_table::intern(style(RGB(1, 2, 3), true));
+
+static void test_intern() {
+    CHECK(style_table::lookup(early) == style(RGB(1, 2, 3), true));
+    CHECK(style_table::intern(style(RGB(1, 2, 3), true)) == early);
+
+    // The plain style is always there, unknown identifiers read as plain
+    CHECK(style_table::intern(style()) == style_table::STYLE_Plain);
+    CHECK(style_table::lookup(style_table::STYLE_Plain) == style());
+    CHECK(style_table::lookup(static_cast<style_table::id>(style_table::STYLE_Count - 1)) == style());
+
+    // Equal styles share an identifier, different ones do not
+    style_table::id red = style_table::intern(style(RGB(255, 0, 0)));
+    style_table::id bold = style_table::intern(style(RGB(255, 0, 0), true));
+    CHECK(red != bold && red != style_table::STYLE_Plain);
+    CHECK(style_table::intern(style(RGB(255, 0, 0))) == red);
+    CHECK(style_table::lookup(bold).bold && style_table::lookup(bold).colour == RGB(255, 0, 0));
+}
+
+struct interner {
+    int number;
+    std::vector<style_table::id> ids;
+    bool consistent;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        // Every thread interns the same styles in a different order and reads them back at once
+        interner& self = *static_cast<interner*>(parameter);
+        self.consistent = true;
+        self.ids.assign(2000, 0);
+        for (int i = 0; i < 2000; i++) {
+            int colour = (i * 7 + self.number * 13) % 2000;
+            self.ids[colour] = style_table::intern(style(static_cast<COLORREF>(colour + 1000)));
+            if (style_table::lookup(self.ids[colour]).colour != static_cast<COLORREF>(colour + 1000)) self.consistent = false;
+        }
+        return 0;
+    }
+};
+
+static void test_concurrent() {
+    interner threads[4];
+    HANDLE handles[4];
+    for (int i = 0; i < 4; i++) {
+        threads[i].number = i;
+        handles[i] = CreateThread(NULL, 0, interner::run, &threads[i], 0, NULL);
+    }
+    WaitForMultipleObjects(4, handles, TRUE, INFINITE);
+    for (int i = 0; i < 4; i++) {
+        CloseHandle(handles[i]);
+        CHECK(threads[i].consistent);
+        CHECK(threads[i].ids == threads[0].ids);
+    }
+}
+
+static void test_full() {
+    // Once every identifier is taken new styles fall back to plain
+    for (COLORREF colour = 0x100000; style_table::size() < style_table::STYLE_Count; colour++)
+        style_table::intern(style(colour));
+    CHECK(style_table::intern(style(RGB(9, 9, 9), true)) == style_table::STYLE_Plain);
+    CHECK(style_table::intern(style(RGB(255, 0, 0))) != style_table::STYLE_Plain);
+}
+
+int main() {
+    test_intern();
+    test_concurrent();
+    test_full();
+    return check::finish("styles");
+}
@@ -0,0 +1,112 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Timestamp tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+
+#include "check.hpp"
+
+using namespace db;
+
+static unsigned long long system_now() {
+    FILETIME system;
+    GetSystemTimeAsFileTime(&system);
+    return (static_cast<unsigned long long>(system.dwHighDateTime) << 32) | system.dwLowDateTime;
+}
+
+static void test_conversion() {
+    timestamp::calibration base;
+    base.origin = 1000000;
+    base.wall = 130000000000000000ull;
+    base.frequency = 3000000000ull;
+
+    CHECK(timestamp::wall(base.origin, base) == base.wall);
+    CHECK(timestamp::wall(base.origin + base.frequency / 2, base) == base.wall + 5000000);
+
+    // A year of a fast counter scales without overflowing, earlier ticks go back
+    const unsigned long long year = 3600ull * 24 * 365;
+    CHECK(timestamp::wall(base.origin + base.frequency * year, base) == base.wall + year * 10000000);
+    CHECK(timestamp::wall(base.origin - base.frequency / 2, base) == base.wall - 5000000);
+}
+
+static DWORD WINAPI calibrate(LPVOID parameter) {
+    *static_cast<timestamp::calibration*>(parameter) = timestamp::calibrated();
+    return 0;
+}
+
+static void test_calibration() {
+    // The first caller calibrates, everyone sees the same pairing
+    timestamp::calibration seen[8];
+    HANDLE threads[8];
+    for (int i = 0; i < 8; i++) threads[i] = CreateThread(NULL, 0, calibrate, &seen[i], 0, NULL);
+    WaitForMultipleObjects(8, threads, TRUE, INFINITE);
+    const timestamp::calibration& base = timestamp::calibrated();
+    for (int i = 0; i < 8; i++) {
+        CloseHandle(threads[i]);
+        CHECK(seen[i].origin == base.origin && seen[i].wall == base.wall && seen[i].frequency == base.frequency);
+    }
+    CHECK(base.frequency > 0);
+
+    // Converted ticks agree with the system clock, well within a frame
+    for (int i = 0; i < 10; i++) {
+        unsigned long long before = system_now();
+        unsigned long long converted = timestamp::wall(timestamp::now(), base);
+        unsigned long long after = system_now();
+        CHECK(converted + 50000 >= before && converted <= after + 50000);
+        Sleep(5);
+    }
+
+    // Ticks count in seconds, give or take the sleep's slack
+    timestamp::tick start = timestamp::now();
+    Sleep(50);
+    double elapsed = timestamp::seconds(timestamp::now() - start);
+    CHECK(elapsed >= 0.045 && elapsed < 1.0);
+}
+
+static void test_text() {
+    std::wstring shown = timestamp::text(timestamp::now());
+    CHECK(std::regex_match(shown, std::wregex(L"[0-2][0-9]:[0-5][0-9]:[0-6][0-9]\\.[0-9]{3}")));
+}
+
+static void test_latency() {
+    latency delays;
+    latency::summary empty = delays.snapshot();
+    CHECK(empty.count == 0 && empty.mean == 0.0 && empty.p50 == 0.0);
+
+    // Mostly a few microseconds with one slow outlier
+    const timestamp::tick micro = timestamp::calibrated().frequency / 1000000;
+    for (int i = 0; i < 99; i++) delays.record(3 * micro);
+    delays.record(100000 * micro);
+
+    latency::summary result = delays.snapshot();
+    CHECK(result.count == 100);
+    CHECK(result.p50 >= 3e-6 && result.p50 <= 8e-6);
+    CHECK(result.p99 == result.p50);
+    CHECK(result.max >= 0.099 && result.max <= 0.101);
+    CHECK(result.mean > 0.001 && result.mean < 0.0011);
+}
+
+int main() {
+    test_conversion();
+    test_calibration();
+    test_text();
+    test_latency();
+    return check::finish("timestamp");
+}
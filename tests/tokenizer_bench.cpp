@@ -0,0 +1,74 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input tokenizer benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// Typing and erasing along long command lines, relexing after every
+// keystroke, against lexing the whole line again, which is what each
+// keystroke cost before lexing became incremental.
+//
+int main(int argc, char** argv) {
+    const int keystrokes = static_cast<int>(20000 * check::scale(argc, argv));
+    const int sizes[] = { 100, 1000, 5000 };
+    command_tokenizer rules;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        std::wstring line;
+        for (int i = 0; i < sizes[s]; i++) line += L"--opt" + std::to_wstring(static_cast<long long>(i)) + L" \"s\" 42 ";
+
+        lexer live;
+        live.rules(&rules);
+        size_t from, to, lexed = 0;
+        live.update(line, static_cast<size_t>(-1), from, to);
+        double start = check::seconds();
+        for (int k = 0; k < keystrokes; k++) {
+            size_t position = (k / 2 * 7) % line.size();
+            if (k % 2 == 0) {
+                line.insert(position, 1, L'x');
+                live.edit(position, 0, 1);
+            } else {
+                line.erase(position, 1);
+                live.edit(position, 1, 0);
+            }
+            while (!live.update(line, 4096, from, to)) {}
+            lexed += to - from;
+        }
+        double incremental = (check::seconds() - start) / keystrokes;
+
+        const int rounds = 100;
+        start = check::seconds();
+        for (int k = 0; k < rounds; k++) {
+            lexer whole;
+            whole.rules(&rules);
+            whole.update(line, static_cast<size_t>(-1), from, to);
+            check::keep(whole.tokens().size());
+        }
+        double full = (check::seconds() - start) / rounds;
+
+        std::printf("tokenizer: %zu characters, keystroke %.2f us (%.1f characters restyled), full relex %.1f us\n",
+            line.size(), incremental * 1e6, static_cast<double>(lexed) / keystrokes, full * 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   Input tokenizer tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+// Lexes the whole text in one go
+static std::vector<lexer::token> lex(tokenizer& rules, const std::wstring& text) {
+    lexer whole;
+    whole.rules(&rules);
+    size_t from, to;
+    whole.update(text, static_cast<size_t>(-1), from, to);
+    return whole.tokens();
+}
+
+// Format of the token holding a character
+static style_table::id format(const std::vector<lexer::token>& tokens, size_t position) {
+    for (size_t i = 0; i < tokens.size(); i++)
+        if (position >= tokens[i].start && position < tokens[i].start + tokens[i].length) return tokens[i].format;
+    return style_table::STYLE_Plain;
+}
+
+// Format of every character
+static std::vector<style_table::id> formats(const std::vector<lexer::token>& tokens, size_t length) {
+    std::vector<style_table::id> result(length, style_table::STYLE_Plain);
+    for (size_t i = 0; i < tokens.size(); i++)
+        for (size_t c = tokens[i].start; c < tokens[i].start + tokens[i].length && c < length; c++) result[c] = tokens[i].format;
+    return result;
+}
+
+static bool same(const std::vector<lexer::token>& a, const std::vector<lexer::token>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i].start != b[i].start || a[i].length != b[i].length || a[i].entry != b[i].entry || a[i].format != b[i].format)
+            return false;
+    return true;
+}
+
+static void test_tokens() {
+    command_tokenizer rules;
+    std::wstring text = L"run --fast 12 -3.5 0x1F \"a \\\" b\" word -x\rnext";
+    std::vector<lexer::token> tokens = lex(rules, text);
+
+    // Tokens cover the text without gaps
+    size_t covered = 0;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        CHECK(tokens[i].start == covered);
+        covered += tokens[i].length;
+    }
+    CHECK(covered == text.size());
+
+    // Each kind of word has a look of its own, plain words have none
+    style_table::id command = format(tokens, 0), option = format(tokens, 4), number = format(tokens, 11);
+    style_table::id string = format(tokens, text.find(L"a \\"));
+    CHECK(command != style_table::STYLE_Plain && option != style_table::STYLE_Plain);
+    CHECK(number != style_table::STYLE_Plain && string != style_table::STYLE_Plain);
+    CHECK(command != option && option != number && number != string && string != command);
+    CHECK(format(tokens, text.find(L"-3.5")) == number && format(tokens, text.find(L"0x1F")) == number);
+    CHECK(format(tokens, text.find(L"b\"")) == string && format(tokens, text.find(L"b\"") + 1) == string);
+    CHECK(format(tokens, text.find(L"word")) == style_table::STYLE_Plain);
+    CHECK(format(tokens, text.find(L"-x")) == option);
+    CHECK(format(tokens, text.find(L"next")) == command);
+
+    // Once commands are known, anything else stands out
+    commands known;
+    known.add(L"run", [](const commands::arguments&) { return std::wstring(); }, 0);
+    command_tokenizer checked(&known);
+    std::vector<lexer::token> good = lex(checked, L"run x"), bad = lex(checked, L"rum x");
+    CHECK(format(good, 0) == command && format(bad, 0) != command && format(bad, 0) != style_table::STYLE_Plain);
+}
+
+static void test_incremental() {
+    // Random edits lexed a budget at a time match lexing the result from scratch
+    command_tokenizer rules;
+    const wchar_t* pieces[] = { L"run", L" ", L"--fast", L"-x", L"\"", L"\\\"", L"12", L"-3.5", L"0x1F", L"word",
+                                L"\r", L"  ", L"\"quoted text\"", L"a\"b" };
+    const size_t kinds = sizeof(pieces) / sizeof(pieces[0]);
+    lexer live;
+    live.rules(&rules);
+    std::wstring text;
+    std::srand(7);
+    for (int step = 0; step < 20000; step++) {
+        size_t position = text.empty() ? 0 : std::rand() % (text.size() + 1);
+        size_t removed = (std::rand() % 4 == 0 && position < text.size()) ? std::rand() % ((std::min)(text.size() - position, static_cast<size_t>(8)) + 1) : 0;
+        std::wstring inserted;
+        for (int i = std::rand() % 3; i > 0; i--) inserted += pieces[std::rand() % kinds];
+        if (text.size() > 3000) {
+            removed = text.size() - position;
+            inserted.clear();
+        }
+
+        std::vector<style_table::id> before = formats(live.tokens(), text.size());
+        text.replace(position, removed, inserted);
+        live.edit(position, removed, inserted.size());
+        size_t from, to, low = static_cast<size_t>(-1), high = 0;
+        bool done = false;
+        while (!done) {
+            done = live.update(text, 1 + std::rand() % 64, from, to);
+            low = (std::min)(low, from);
+            high = (std::max)(high, to);
+        }
+
+        std::vector<lexer::token> expected = lex(rules, text);
+        CHECK(same(live.tokens(), expected));
+        if (!same(live.tokens(), expected)) return;
+
+        // Only characters inside the restyled range may look different than before
+        std::vector<style_table::id> after = formats(expected, text.size());
+        bool stale = false;
+        for (size_t c = 0; c < text.size(); c++) {
+            if (c >= low && c < high) continue;
+            if (c >= position && c < position + inserted.size()) { stale = true; break; }
+            size_t old = (c < position) ? c : c - inserted.size() + removed;
+            if (before[old] != after[c]) { stale = true; break; }
+        }
+        CHECK(!stale);
+        if (stale) return;
+    }
+}
+
+int main() {
+    test_tokens();
+    test_incremental();
+    return check::finish("tokenizer");
+}
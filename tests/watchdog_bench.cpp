@@ -0,0 +1,49 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   UI thread watchdog benchmark
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+//
+// What timing every turn adds to the UI thread, for turns that do nothing
+// at all, so the whole cost is the watchdog's.
+//
+int main(int argc, char** argv) {
+    const int turns = static_cast<int>(2000000 * check::scale(argc, argv));
+
+    watchdog timer;
+    double start = check::seconds();
+    for (int i = 0; i < turns; i++) {
+        timer.enter();
+        timer.leave(watchdog::SOURCE_Mail, 0, i);
+    }
+    double elapsed = check::seconds() - start;
+
+    start = check::seconds();
+    for (int i = 0; i < turns / 100; i++) check::keep(timer.snapshot().count);
+    double snapshots = check::seconds() - start;
+
+    std::printf("watchdog: %d turns, %.0f ns each, snapshot %.0f ns\n",
+        turns, elapsed / turns * 1e9, snapshots / (turns / 100) * 1e9);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/***
+ *   Project: console-win
+ *   Copyright (C) Daniel Bloemendal. All rights reserved.
+ *
+ *   UI thread watchdog tests
+ *
+ *   This file is part of console-win.
+ *
+ *   console-win is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   console-win is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with console-win.  If not, see <http://www.gnu.org/licenses/>.
+ ***/
+
+#include "check.hpp"
+
+using namespace db;
+
+static void test_slowest() {
+    watchdog turns;
+    turns.threshold(0.02);
+
+    // Four slow turns among quick ones, each slower than the one before
+    for (int i = 0; i < 40; i++) {
+        turns.enter();
+        if (i % 10 == 3) Sleep(5 * (i / 10 + 1) + 20);
+        turns.leave(watchdog::SOURCE_Windows, 0x100 + i, i);
+    }
+    watchdog::summary result = turns.snapshot();
+    CHECK(result.count == 40 && result.stalls == 4);
+    CHECK(result.current == 0.0);
+    CHECK(result.slowest.size() == watchdog::SLOWEST_Count);
+    CHECK(result.slowest[0].message == 0x100 + 33 && result.slowest[0].payload == 33);
+    CHECK(result.slowest[3].message == 0x100 + 3);
+    CHECK(result.slowest[0].seconds >= 0.04 && result.busy >= 0.1);
+    for (size_t i = 1; i < result.slowest.size(); i++)
+        CHECK(result.slowest[i - 1].seconds >= result.slowest[i].seconds);
+}
+
+static void test_running() {
+    // A turn that has not returned yet is seen from outside
+    watchdog turns;
+    turns.enter();
+    Sleep(30);
+    watchdog::summary result = turns.snapshot();
+    CHECK(result.current >= 0.02 && result.count == 0);
+    turns.leave(watchdog::SOURCE_Mail, 0, 1);
+    result = turns.snapshot();
+    CHECK(result.current == 0.0 && result.count == 1 && result.slowest[0].kind == watchdog::SOURCE_Mail);
+}
+
+//
+// Turns on one thread while another takes snapshots, the way a frozen
+// console is looked at. A torn start of turn would show up as a turn
+// running for a nonsensical time.
+//
+struct ui {
+    watchdog* turns;
+    int count;
+
+    static DWORD WINAPI run(LPVOID parameter) {
+        ui* self = static_cast<ui*>(parameter);
+        for (int i = 0; i < self->count; i++) {
+            self->turns->enter();
+            self->turns->leave(watchdog::SOURCE_Windows, i, 0);
+        }
+        return 0;
+    }
+};
+
+static void test_concurrent() {
+    watchdog turns;
+    ui thread_state = { &turns, 200000 };
+    HANDLE thread = CreateThread(NULL, 0, ui::run, &thread_state, 0, NULL);
+    bool sane = true;
+    while (WaitForSingleObject(thread, 0) == WAIT_TIMEOUT) {
+        watchdog::summary result = turns.snapshot();
+        if (result.current < 0.0 || result.current > 60.0) sane = false;
+    }
+    CloseHandle(thread);
+    CHECK(sane);
+    CHECK(turns.snapshot().count == 200000);
+}
+
+int main() {
+    test_slowest();
+    test_running();
+    test_concurrent();
+    return check::finish("watchdog");
+}